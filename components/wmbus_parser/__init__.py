@@ -2,14 +2,26 @@ import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome import automation
 from esphome.components import sensor
-from esphome.const import CONF_ID, CONF_TRIGGER_ID, DEVICE_CLASS_WATER, STATE_CLASS_TOTAL_INCREASING
+from esphome.const import (
+    CONF_ID,
+    CONF_KEY,
+    CONF_TRIGGER_ID,
+    DEVICE_CLASS_DURATION,
+    DEVICE_CLASS_WATER,
+    ENTITY_CATEGORY_DIAGNOSTIC,
+    STATE_CLASS_MEASUREMENT,
+    STATE_CLASS_TOTAL_INCREASING,
+    UNIT_MICROSECOND,
+    UNIT_SECOND,
+)
+from esphome.core import CORE
 
 DEPENDENCIES = []
 
 # Namespace and C++ classes
 wmbus_parser_ns = cg.esphome_ns.namespace('wmbus_parser')
 WMBusParser = wmbus_parser_ns.class_('WMBusParser', cg.Component)
-WMBusMeter = wmbus_parser_ns.class_('WMBusMeter', cg.Component)
+WMBusMeter = wmbus_parser_ns.class_('WMBusMeter')
 RawLogLevel = wmbus_parser_ns.enum('RawLogLevel')
 
 # YAML keys
@@ -19,6 +31,44 @@ CONF_DRIVER = 'driver'
 CONF_TOTAL_M3 = 'total_m3'
 CONF_RAW_LOG_LEVEL = 'raw_log_level'
 CONF_ON_DECODE = 'on_decode'
+CONF_ON_DECODE_JSON = 'on_decode_json'
+CONF_ON_CHANGE = 'on_change'
+CONF_ARENA_SIZE = 'arena_size'
+CONF_COUNT_ALLOCATIONS = 'count_allocations'
+CONF_DUPLICATE_WINDOW = 'duplicate_window'
+CONF_DECODE_WORKER = 'decode_worker'
+CONF_QUEUE_SIZE = 'queue_size'
+CONF_RAW_CAPTURE_LEVEL = 'raw_capture_level'
+CONF_CHECK_CRC = 'check_crc'
+CONF_T1_MODE = 't1_mode'
+CONF_RAW_CAPTURE_SIZE = 'raw_capture_size'
+CONF_PUBLISH_INTERVAL = 'publish_interval'
+CONF_PUBLISH_BATCH_SIZE = 'publish_batch_size'
+CONF_ON_BATCH = 'on_batch'
+CONF_HISTORY_SIZE = 'history_size'
+CONF_HISTORY_INTERVAL = 'history_interval'
+CONF_HISTORY_SAVE_INTERVAL = 'history_save_interval'
+CONF_ON_BACKFILL = 'on_backfill'
+CONF_MIN_PUBLISH_INTERVAL = 'min_publish_interval'
+CONF_TOTAL_M3_THRESHOLD = 'total_m3_threshold'
+CONF_LAST_SEEN = 'last_seen'
+CONF_FOREIGN_METERS = 'foreign_meters'
+CONF_FOREIGN_REPORT_INTERVAL = 'foreign_report_interval'
+CONF_METRICS = 'metrics'
+CONF_METRICS_INTERVAL = 'interval'
+CONF_RECEIVED = 'received'
+CONF_DECODED = 'decoded'
+CONF_FAILED = 'failed'
+CONF_DUPLICATES = 'duplicates'
+CONF_UNKNOWN_ID = 'unknown_id'
+CONF_DECODE_TIME = 'decode_time'
+CONF_LATENCY = 'latency'
+CONF_STAGE_TIMING = 'stage_timing'
+CONF_TRACE_SIZE = 'trace_size'
+CONF_AUTO_DETECT = 'auto_detect'
+CONF_MANUFACTURERS = 'manufacturers'
+CONF_DRIVERS = 'drivers'
+CONF_MAX_METERS = 'max_meters'
 
 RAW_LOG_LEVELS = {
     'NONE': RawLogLevel.RAW_LOG_LEVEL_NONE,
@@ -27,9 +77,42 @@ RAW_LOG_LEVELS = {
     'METER_ID': RawLogLevel.RAW_LOG_LEVEL_MATCHING_METER_ID,
 }
 
-attribute_list = cg.std_vector.template(cg.std_string)
+# Driver name -> define that compiles the driver into the driver table.
+DRIVERS = {
+    'evo868': 'USE_WMBUS_DRIVER_EVO868',
+    'oms_heat': 'USE_WMBUS_DRIVER_OMS_HEAT',
+    'oms_water': 'USE_WMBUS_DRIVER_OMS_WATER',
+}
+# Meter driver picked from the link header of the meter's first telegram.
+DRIVER_AUTO = 'auto'
+
+attribute_list = wmbus_parser_ns.class_('AttributeList')
+meter_batch = wmbus_parser_ns.class_('MeterBatch')
+history_readings = wmbus_parser_ns.class_('HistoryReadings')
 
 WMBusParserDecodeTrigger = wmbus_parser_ns.class_('WMBusParserDecodeTrigger', automation.Trigger.template(cg.float_, attribute_list, cg.std_string))
+WMBusParserJsonTrigger = wmbus_parser_ns.class_('WMBusParserJsonTrigger', automation.Trigger.template(cg.const_char_ptr, cg.size_t, cg.std_string))
+WMBusParserChangeTrigger = wmbus_parser_ns.class_('WMBusParserChangeTrigger', automation.Trigger.template(cg.float_, attribute_list, cg.std_string))
+WMBusParserBatchTrigger = wmbus_parser_ns.class_('WMBusParserBatchTrigger', automation.Trigger.template(meter_batch))
+WMBusParserBackfillTrigger = wmbus_parser_ns.class_('WMBusParserBackfillTrigger', automation.Trigger.template(cg.std_string, history_readings))
+
+def validate_meter_id(value):
+    value = cv.string_strict(value).upper()
+    if len(value) != 8 or any(c not in '0123456789ABCDEF' for c in value):
+        raise cv.Invalid("meter_id must be 8 hexadecimal digits, e.g. '23123046'")
+    return value
+
+def validate_manufacturer(value):
+    value = cv.string_strict(value).upper()
+    if len(value) != 3 or any(not 'A' <= c <= 'Z' for c in value):
+        raise cv.Invalid("manufacturer must be a three-letter code, e.g. 'MAD'")
+    return value
+
+def validate_key(value):
+    value = cv.string_strict(value).replace(' ', '').upper()
+    if len(value) != 32 or any(c not in '0123456789ABCDEF' for c in value):
+        raise cv.Invalid("key must be 32 hexadecimal digits (AES-128)")
+    return value
 
 TOTAL_M3_SCHEMA = sensor.sensor_schema(
     unit_of_measurement='m³',
@@ -39,37 +122,182 @@ TOTAL_M3_SCHEMA = sensor.sensor_schema(
     device_class=DEVICE_CLASS_WATER,
 )
 
+LAST_SEEN_SCHEMA = sensor.sensor_schema(
+    unit_of_measurement=UNIT_SECOND,
+    accuracy_decimals=0,
+    icon='mdi:clock-outline',
+    device_class=DEVICE_CLASS_DURATION,
+    state_class=STATE_CLASS_MEASUREMENT,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+COUNTER_SCHEMA = sensor.sensor_schema(
+    accuracy_decimals=0,
+    icon='mdi:counter',
+    state_class=STATE_CLASS_TOTAL_INCREASING,
+    entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+)
+
+# Counter sensors of the metrics block -> WMBusParser setter
+METRIC_COUNTERS = {
+    CONF_RECEIVED: 'set_received_sensor',
+    CONF_DECODED: 'set_decoded_sensor',
+    CONF_FAILED: 'set_failed_sensor',
+    CONF_DUPLICATES: 'set_duplicates_sensor',
+    CONF_UNKNOWN_ID: 'set_unknown_id_sensor',
+}
+
+METRICS_SCHEMA = cv.Schema({
+    cv.Optional(CONF_METRICS_INTERVAL, default='60s'): cv.positive_time_period_milliseconds,
+    **{cv.Optional(key): COUNTER_SCHEMA for key in METRIC_COUNTERS},
+    cv.Optional(CONF_DECODE_TIME): sensor.sensor_schema(
+        unit_of_measurement=UNIT_MICROSECOND,
+        accuracy_decimals=0,
+        icon='mdi:timer-outline',
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ),
+    cv.Optional(CONF_LATENCY): sensor.sensor_schema(
+        unit_of_measurement=UNIT_MICROSECOND,
+        accuracy_decimals=0,
+        icon='mdi:timer-sand',
+        state_class=STATE_CLASS_MEASUREMENT,
+        entity_category=ENTITY_CATEGORY_DIAGNOSTIC,
+    ),
+    cv.Optional(CONF_STAGE_TIMING, default=False): cv.boolean,
+    cv.Optional(CONF_TRACE_SIZE, default=8): cv.int_range(min=0, max=64),
+})
+
+# Drivers to build in for detection, and the manufacturers whose meters are
+# all decoded without listing them.
+AUTO_DETECT_SCHEMA = cv.Schema({
+    cv.Optional(CONF_MANUFACTURERS, default=[]): cv.ensure_list(validate_manufacturer),
+    cv.Optional(CONF_DRIVERS, default=list(DRIVERS)): cv.ensure_list(cv.one_of(*DRIVERS, lower=True)),
+    cv.Optional(CONF_MAX_METERS, default=32): cv.int_range(min=1, max=1024),
+})
+
 METER_SCHEMA = cv.Schema({
-    cv.Required(CONF_ID): cv.declare_id(WMBusMeter),   # declares child instance id
-    cv.Required(CONF_METER_ID): cv.string,
-    cv.Required(CONF_DRIVER): cv.string,
+    cv.Required(CONF_ID): cv.declare_id(WMBusMeter),   # handle of the meter's slot in the parser
+    cv.Required(CONF_METER_ID): validate_meter_id,
+    cv.Required(CONF_DRIVER): cv.one_of(*DRIVERS, DRIVER_AUTO, lower=True),
+    cv.Optional(CONF_KEY): validate_key,
     cv.Optional(CONF_TOTAL_M3): TOTAL_M3_SCHEMA,
+    cv.Optional(CONF_MIN_PUBLISH_INTERVAL, default='0s'): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_TOTAL_M3_THRESHOLD, default=0.0): cv.positive_float,
+    cv.Optional(CONF_LAST_SEEN): LAST_SEEN_SCHEMA,
 })
 
 CONFIG_SCHEMA = cv.Schema({
     cv.GenerateID(): cv.declare_id(WMBusParser),
-    cv.Required(CONF_METERS): cv.ensure_list(METER_SCHEMA),
+    cv.Optional(CONF_METERS, default=[]): cv.ensure_list(METER_SCHEMA),
+    cv.Optional(CONF_AUTO_DETECT): AUTO_DETECT_SCHEMA,
     cv.Optional(CONF_RAW_LOG_LEVEL, default='NONE'): cv.enum(RAW_LOG_LEVELS, upper=True),
+    cv.Optional(CONF_CHECK_CRC, default=True): cv.boolean,
+    cv.Optional(CONF_T1_MODE, default=False): cv.boolean,
+    cv.Optional(CONF_RAW_CAPTURE_LEVEL, default='NONE'): cv.enum(RAW_LOG_LEVELS, upper=True),
+    cv.Optional(CONF_RAW_CAPTURE_SIZE, default=4096): cv.int_range(min=512, max=65535),
+    cv.Optional(CONF_DUPLICATE_WINDOW, default='10s'): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_DECODE_WORKER, default=True): cv.boolean,
+    cv.Optional(CONF_QUEUE_SIZE, default=8): cv.int_range(min=2, max=64),
+    cv.Optional(CONF_FOREIGN_METERS, default=32): cv.int_range(min=0, max=255),
+    cv.Optional(CONF_FOREIGN_REPORT_INTERVAL, default='5min'): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_PUBLISH_INTERVAL, default='0s'): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_PUBLISH_BATCH_SIZE, default=8): cv.int_range(min=1, max=255),
+    cv.Optional(CONF_HISTORY_SIZE, default=0): cv.int_range(min=0, max=4096),
+    cv.Optional(CONF_HISTORY_INTERVAL, default='15min'): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_HISTORY_SAVE_INTERVAL, default='5min'): cv.positive_time_period_milliseconds,
+    cv.Optional(CONF_ARENA_SIZE, default=2048): cv.int_range(min=0, max=65535),
+    cv.Optional(CONF_COUNT_ALLOCATIONS, default=False): cv.boolean,
+    cv.Optional(CONF_METRICS): METRICS_SCHEMA,
     cv.Optional(CONF_ON_DECODE): automation.validate_automation({
         cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(WMBusParserDecodeTrigger),
     }),
+    cv.Optional(CONF_ON_DECODE_JSON): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(WMBusParserJsonTrigger),
+    }),
+    cv.Optional(CONF_ON_CHANGE): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(WMBusParserChangeTrigger),
+    }),
+    cv.Optional(CONF_ON_BATCH): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(WMBusParserBatchTrigger),
+    }),
+    cv.Optional(CONF_ON_BACKFILL): automation.validate_automation({
+        cv.GenerateID(CONF_TRIGGER_ID): cv.declare_id(WMBusParserBackfillTrigger),
+    }),
 }).extend(cv.COMPONENT_SCHEMA)
 
 async def to_code(config):
     parser = cg.new_Pvariable(config[CONF_ID])
     await cg.register_component(parser, config)
 
+    # Only drivers referenced by a meter are compiled in, plus the ones
+    # detection can pick when a meter or manufacturer uses it.
+    drivers = {meter[CONF_DRIVER] for meter in config[CONF_METERS]}
+    auto_detect = config.get(CONF_AUTO_DETECT, AUTO_DETECT_SCHEMA({}))
+    if DRIVER_AUTO in drivers or auto_detect[CONF_MANUFACTURERS]:
+        drivers |= set(auto_detect[CONF_DRIVERS])
+    drivers.discard(DRIVER_AUTO)
+    for driver in sorted(drivers):
+        cg.add_define(DRIVERS[driver])
+    for manufacturer in auto_detect[CONF_MANUFACTURERS]:
+        cg.add(parser.add_auto_manufacturer(manufacturer))
+    cg.add(parser.set_auto_meter_limit(auto_detect[CONF_MAX_METERS]))
+
+    # Meters live in a table inside the parser; the YAML id names a handle to
+    # the meter's slot, so lambdas can still use id(water_23123046).
+    cg.add(parser.reserve_meters(len(config[CONF_METERS])))
     for meter in config[CONF_METERS]:
-        # předáváme meter_id a driver konstruktoru, ID handle je meter[CONF_ID]
-        m = cg.new_Pvariable(meter[CONF_ID], meter[CONF_METER_ID], meter[CONF_DRIVER])
-        await cg.register_component(m, meter)  # teď funguje, pokud WMBusMeter dědí z Component
-        cg.add(parser.add_meter(m))
+        m = cg.Pvariable(meter[CONF_ID], parser.add_meter(meter[CONF_METER_ID], meter[CONF_DRIVER]))
+        if CONF_KEY in meter:
+            cg.add(m.set_key(meter[CONF_KEY]))
 
         if CONF_TOTAL_M3 in meter:
             sens = await sensor.new_sensor(meter[CONF_TOTAL_M3])
             cg.add(m.set_total_m3(sens))
+        cg.add(m.set_min_publish_interval(meter[CONF_MIN_PUBLISH_INTERVAL].total_milliseconds))
+        cg.add(m.set_total_m3_threshold(meter[CONF_TOTAL_M3_THRESHOLD]))
+        if CONF_LAST_SEEN in meter:
+            sens = await sensor.new_sensor(meter[CONF_LAST_SEEN])
+            cg.add(m.set_last_seen(sens))
 
     cg.add(parser.set_raw_log_level(config[CONF_RAW_LOG_LEVEL]))
+    cg.add(parser.set_check_crc(config[CONF_CHECK_CRC]))
+    cg.add(parser.set_t1_mode(config[CONF_T1_MODE]))
+    cg.add(parser.set_raw_capture_level(config[CONF_RAW_CAPTURE_LEVEL]))
+    cg.add(parser.set_raw_capture_size(config[CONF_RAW_CAPTURE_SIZE]))
+    cg.add(parser.set_duplicate_window(config[CONF_DUPLICATE_WINDOW].total_milliseconds))
+    cg.add(parser.set_decode_worker(config[CONF_DECODE_WORKER]))
+    cg.add(parser.set_queue_size(config[CONF_QUEUE_SIZE]))
+    cg.add(parser.set_foreign_table_size(config[CONF_FOREIGN_METERS]))
+    cg.add(parser.set_foreign_report_interval(config[CONF_FOREIGN_REPORT_INTERVAL].total_milliseconds))
+    cg.add(parser.set_publish_interval(config[CONF_PUBLISH_INTERVAL].total_milliseconds))
+    cg.add(parser.set_publish_batch_size(config[CONF_PUBLISH_BATCH_SIZE]))
+    cg.add(parser.set_history_size(config[CONF_HISTORY_SIZE]))
+    cg.add(parser.set_history_interval(config[CONF_HISTORY_INTERVAL].total_milliseconds))
+    cg.add(parser.set_history_save_interval(config[CONF_HISTORY_SAVE_INTERVAL].total_milliseconds))
+    cg.add(parser.set_arena_size(config[CONF_ARENA_SIZE]))
+    if config[CONF_COUNT_ALLOCATIONS]:
+        cg.add_build_flag('-DWMBUS_PARSER_COUNT_ALLOCATIONS')
+        if CORE.using_esp_idf:
+            # Heap hooks count malloc and C library allocations, not only operator new
+            from esphome.components.esp32 import add_idf_sdkconfig_option
+            add_idf_sdkconfig_option('CONFIG_HEAP_USE_HOOKS', True)
+
+    if CONF_METRICS in config:
+        metrics = config[CONF_METRICS]
+        cg.add(parser.set_metrics_interval(metrics[CONF_METRICS_INTERVAL].total_milliseconds))
+        for key, setter in METRIC_COUNTERS.items():
+            if key in metrics:
+                sens = await sensor.new_sensor(metrics[key])
+                cg.add(getattr(parser, setter)(sens))
+        if CONF_DECODE_TIME in metrics:
+            sens = await sensor.new_sensor(metrics[CONF_DECODE_TIME])
+            cg.add(parser.set_decode_time_sensor(sens))
+        if CONF_LATENCY in metrics:
+            sens = await sensor.new_sensor(metrics[CONF_LATENCY])
+            cg.add(parser.set_latency_sensor(sens))
+        cg.add(parser.set_stage_timing(metrics[CONF_STAGE_TIMING]))
+        cg.add(parser.set_trace_size(metrics[CONF_TRACE_SIZE]))
 
     if CONF_ON_DECODE in config:
         for conf in config[CONF_ON_DECODE]:
@@ -80,3 +308,35 @@ async def to_code(config):
                 (cg.std_string, 'meter_id'),
             ], conf)
 
+    if CONF_ON_DECODE_JSON in config:
+        for conf in config[CONF_ON_DECODE_JSON]:
+            trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], parser)
+            await automation.build_automation(trigger, [
+                (cg.const_char_ptr, 'json'),
+                (cg.size_t, 'length'),
+                (cg.std_string, 'meter_id'),
+            ], conf)
+
+    if CONF_ON_CHANGE in config:
+        for conf in config[CONF_ON_CHANGE]:
+            trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], parser)
+            await automation.build_automation(trigger, [
+                (cg.float_, 'value'),
+                (attribute_list, 'attributes'),
+                (cg.std_string, 'meter_id'),
+            ], conf)
+
+    if CONF_ON_BATCH in config:
+        for conf in config[CONF_ON_BATCH]:
+            trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], parser)
+            await automation.build_automation(trigger, [
+                (meter_batch, 'batch'),
+            ], conf)
+
+    if CONF_ON_BACKFILL in config:
+        for conf in config[CONF_ON_BACKFILL]:
+            trigger = cg.new_Pvariable(conf[CONF_TRIGGER_ID], parser)
+            await automation.build_automation(trigger, [
+                (cg.std_string, 'meter_id'),
+                (history_readings, 'readings'),
+            ], conf)
@@ -0,0 +1,196 @@
+#include "aes128.h"
+
+#include <array>
+#include <cstring>
+
+namespace esphome {
+namespace wmbus_parser {
+
+#ifdef USE_ESP32
+
+Aes128::Aes128() { mbedtls_aes_init(&this->ctx_); }
+Aes128::~Aes128() { mbedtls_aes_free(&this->ctx_); }
+
+void Aes128::set_key(const uint8_t *key) {
+  this->has_key_ = mbedtls_aes_setkey_dec(&this->ctx_, key, KEY_SIZE * 8) == 0;
+}
+
+void Aes128::decrypt_block(const uint8_t *in, uint8_t *out) const {
+  mbedtls_aes_crypt_ecb(&this->ctx_, MBEDTLS_AES_DECRYPT, in, out);
+}
+
+void Aes128::decrypt_cbc(const uint8_t *iv, uint8_t *data, size_t len) const {
+  uint8_t chain[BLOCK_SIZE];
+  memcpy(chain, iv, BLOCK_SIZE);
+  mbedtls_aes_crypt_cbc(&this->ctx_, MBEDTLS_AES_DECRYPT, len, chain, data, data);
+}
+
+#else  // software AES
+
+namespace {
+
+constexpr uint8_t rotl8(uint8_t x, int shift) { return static_cast<uint8_t>((x << shift) | (x >> (8 - shift))); }
+
+constexpr uint8_t gf_mul(uint8_t a, uint8_t b) {
+  uint8_t result = 0;
+  while (b != 0) {
+    if (b & 1)
+      result ^= a;
+    a = static_cast<uint8_t>((a << 1) ^ ((a & 0x80) ? 0x1B : 0));
+    b >>= 1;
+  }
+  return result;
+}
+
+constexpr std::array<uint8_t, 256> make_sbox() {
+  std::array<uint8_t, 256> sbox{};
+  // Walk the multiplicative group with generator 3 and its inverse.
+  uint8_t p = 1, q = 1;
+  do {
+    p = static_cast<uint8_t>(p ^ (p << 1) ^ ((p & 0x80) ? 0x1B : 0));
+    q ^= static_cast<uint8_t>(q << 1);
+    q ^= static_cast<uint8_t>(q << 2);
+    q ^= static_cast<uint8_t>(q << 4);
+    if (q & 0x80)
+      q ^= 0x09;
+    sbox[p] = static_cast<uint8_t>(q ^ rotl8(q, 1) ^ rotl8(q, 2) ^ rotl8(q, 3) ^ rotl8(q, 4) ^ 0x63);
+  } while (p != 1);
+  sbox[0] = 0x63;
+  return sbox;
+}
+
+constexpr std::array<uint8_t, 256> SBOX = make_sbox();
+
+constexpr std::array<uint8_t, 256> make_inv_sbox() {
+  std::array<uint8_t, 256> inv{};
+  for (size_t i = 0; i < 256; i++)
+    inv[SBOX[i]] = static_cast<uint8_t>(i);
+  return inv;
+}
+
+constexpr std::array<uint8_t, 256> INV_SBOX = make_inv_sbox();
+
+constexpr uint32_t ror32(uint32_t x, int shift) { return (x >> shift) | (x << (32 - shift)); }
+
+// Td[0] combines InvSubBytes and InvMixColumns for one byte; Td[1..3] are
+// the same table rotated for the other rows.
+constexpr std::array<std::array<uint32_t, 256>, 4> make_td() {
+  std::array<std::array<uint32_t, 256>, 4> td{};
+  for (size_t i = 0; i < 256; i++) {
+    uint8_t s = INV_SBOX[i];
+    uint32_t word = (static_cast<uint32_t>(gf_mul(s, 0x0E)) << 24) | (static_cast<uint32_t>(gf_mul(s, 0x09)) << 16) |
+                    (static_cast<uint32_t>(gf_mul(s, 0x0D)) << 8) | gf_mul(s, 0x0B);
+    td[0][i] = word;
+    td[1][i] = ror32(word, 8);
+    td[2][i] = ror32(word, 16);
+    td[3][i] = ror32(word, 24);
+  }
+  return td;
+}
+
+constexpr std::array<std::array<uint32_t, 256>, 4> TD = make_td();
+
+inline uint32_t load_be32(const uint8_t *p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+inline void store_be32(uint8_t *p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v >> 24);
+  p[1] = static_cast<uint8_t>(v >> 16);
+  p[2] = static_cast<uint8_t>(v >> 8);
+  p[3] = static_cast<uint8_t>(v);
+}
+
+inline uint32_t sub_word(uint32_t w) {
+  return (static_cast<uint32_t>(SBOX[w >> 24]) << 24) | (static_cast<uint32_t>(SBOX[(w >> 16) & 0xFF]) << 16) |
+         (static_cast<uint32_t>(SBOX[(w >> 8) & 0xFF]) << 8) | SBOX[w & 0xFF];
+}
+
+inline uint32_t inv_mix_column(uint32_t w) {
+  // TD includes InvSubBytes, so undo it with the forward S-box first.
+  return TD[0][SBOX[w >> 24]] ^ TD[1][SBOX[(w >> 16) & 0xFF]] ^ TD[2][SBOX[(w >> 8) & 0xFF]] ^ TD[3][SBOX[w & 0xFF]];
+}
+
+}  // namespace
+
+Aes128::Aes128() = default;
+
+Aes128::~Aes128() {
+  volatile uint32_t *keys = this->round_keys_;
+  for (size_t i = 0; i < 44; i++)
+    keys[i] = 0;
+}
+
+void Aes128::set_key(const uint8_t *key) {
+  uint32_t w[44];
+  for (size_t i = 0; i < 4; i++)
+    w[i] = load_be32(key + 4 * i);
+  uint32_t rcon = 0x01;
+  for (size_t i = 4; i < 44; i++) {
+    uint32_t temp = w[i - 1];
+    if (i % 4 == 0) {
+      temp = sub_word((temp << 8) | (temp >> 24)) ^ (rcon << 24);
+      rcon = gf_mul(static_cast<uint8_t>(rcon), 2);
+    }
+    w[i] = w[i - 4] ^ temp;
+  }
+  // Equivalent inverse cipher: round keys in reverse order, with
+  // InvMixColumns applied to all but the first and last.
+  for (size_t round = 0; round <= 10; round++) {
+    for (size_t col = 0; col < 4; col++) {
+      uint32_t word = w[4 * (10 - round) + col];
+      this->round_keys_[4 * round + col] = (round == 0 || round == 10) ? word : inv_mix_column(word);
+    }
+  }
+  this->has_key_ = true;
+}
+
+void Aes128::decrypt_block(const uint8_t *in, uint8_t *out) const {
+  const uint32_t *rk = this->round_keys_;
+  uint32_t s0 = load_be32(in) ^ rk[0];
+  uint32_t s1 = load_be32(in + 4) ^ rk[1];
+  uint32_t s2 = load_be32(in + 8) ^ rk[2];
+  uint32_t s3 = load_be32(in + 12) ^ rk[3];
+  const auto &t0 = TD[0], &t1 = TD[1], &t2 = TD[2], &t3 = TD[3];
+  for (size_t round = 1; round < 10; round++) {
+    rk += 4;
+    uint32_t n0 = t0[s0 >> 24] ^ t1[(s3 >> 16) & 0xFF] ^ t2[(s2 >> 8) & 0xFF] ^ t3[s1 & 0xFF] ^ rk[0];
+    uint32_t n1 = t0[s1 >> 24] ^ t1[(s0 >> 16) & 0xFF] ^ t2[(s3 >> 8) & 0xFF] ^ t3[s2 & 0xFF] ^ rk[1];
+    uint32_t n2 = t0[s2 >> 24] ^ t1[(s1 >> 16) & 0xFF] ^ t2[(s0 >> 8) & 0xFF] ^ t3[s3 & 0xFF] ^ rk[2];
+    uint32_t n3 = t0[s3 >> 24] ^ t1[(s2 >> 16) & 0xFF] ^ t2[(s1 >> 8) & 0xFF] ^ t3[s0 & 0xFF] ^ rk[3];
+    s0 = n0;
+    s1 = n1;
+    s2 = n2;
+    s3 = n3;
+  }
+  rk += 4;
+  auto last = [](uint32_t a, uint32_t b, uint32_t c, uint32_t d, uint32_t key) {
+    return ((static_cast<uint32_t>(INV_SBOX[a >> 24]) << 24) | (static_cast<uint32_t>(INV_SBOX[(b >> 16) & 0xFF]) << 16) |
+            (static_cast<uint32_t>(INV_SBOX[(c >> 8) & 0xFF]) << 8) | INV_SBOX[d & 0xFF]) ^
+           key;
+  };
+  store_be32(out, last(s0, s3, s2, s1, rk[0]));
+  store_be32(out + 4, last(s1, s0, s3, s2, rk[1]));
+  store_be32(out + 8, last(s2, s1, s0, s3, rk[2]));
+  store_be32(out + 12, last(s3, s2, s1, s0, rk[3]));
+}
+
+void Aes128::decrypt_cbc(const uint8_t *iv, uint8_t *data, size_t len) const {
+  uint8_t chain[BLOCK_SIZE];
+  uint8_t cipher[BLOCK_SIZE];
+  memcpy(chain, iv, BLOCK_SIZE);
+  for (size_t offset = 0; offset + BLOCK_SIZE <= len; offset += BLOCK_SIZE) {
+    uint8_t *block = data + offset;
+    memcpy(cipher, block, BLOCK_SIZE);
+    this->decrypt_block(cipher, block);
+    for (size_t i = 0; i < BLOCK_SIZE; i++)
+      block[i] ^= chain[i];
+    memcpy(chain, cipher, BLOCK_SIZE);
+  }
+}
+
+#endif  // USE_ESP32
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,50 @@
+/**
+ * AES-128 decryption with a key schedule prepared once per key.
+ *
+ * On the ESP32 the mbedtls AES context is used, which ESP-IDF backs with the
+ * hardware AES peripheral. Other builds (including the host build) use a
+ * table-driven software implementation of the equivalent inverse cipher.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_ESP32
+#include "mbedtls/aes.h"
+#endif
+
+namespace esphome {
+namespace wmbus_parser {
+
+class Aes128 {
+ public:
+  static constexpr size_t KEY_SIZE = 16;
+  static constexpr size_t BLOCK_SIZE = 16;
+
+  Aes128();
+  ~Aes128();
+  Aes128(const Aes128 &) = delete;
+  Aes128 &operator=(const Aes128 &) = delete;
+
+  /// Expand ``key`` (KEY_SIZE bytes) into the decryption key schedule.
+  void set_key(const uint8_t *key);
+  bool has_key() const { return this->has_key_; }
+
+  void decrypt_block(const uint8_t *in, uint8_t *out) const;
+  /// Decrypt ``len`` bytes (a multiple of BLOCK_SIZE) in place.
+  void decrypt_cbc(const uint8_t *iv, uint8_t *data, size_t len) const;
+
+ protected:
+#ifdef USE_ESP32
+  mutable mbedtls_aes_context ctx_;
+#else
+  uint32_t round_keys_[44];
+#endif
+  bool has_key_{false};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,137 @@
+#include "alloc_counter.h"
+
+#ifdef WMBUS_PARSER_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef CONFIG_HEAP_USE_HOOKS
+#include <esp_heap_caps.h>
+#endif
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_deallocations{0};
+std::atomic<uint64_t> g_bytes{0};
+// Plain thread-locals: no constructor runs, so they are usable from the first
+// allocation of a thread on.
+thread_local esphome::wmbus_parser::AllocCounters t_counters;
+
+void count_alloc(std::size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_bytes.fetch_add(size, std::memory_order_relaxed);
+  t_counters.allocations++;
+  t_counters.bytes += size;
+}
+
+void count_free() {
+  g_deallocations.fetch_add(1, std::memory_order_relaxed);
+  t_counters.deallocations++;
+}
+
+#ifndef WMBUS_PARSER_COUNT_MALLOC
+void *counted_alloc(std::size_t size) {
+  count_alloc(size);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+void counted_free(void *ptr) {
+  if (ptr == nullptr)
+    return;
+  count_free();
+  std::free(ptr);
+}
+
+void *counted_alloc_or_throw(std::size_t size) {
+  void *ptr = counted_alloc(size);
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+  if (ptr == nullptr)
+    throw std::bad_alloc();
+#endif
+  return ptr;
+}
+#endif  // WMBUS_PARSER_COUNT_MALLOC
+
+}  // namespace
+
+namespace esphome {
+namespace wmbus_parser {
+
+AllocCounters alloc_counters() {
+  AllocCounters counters;
+  counters.allocations = g_allocations.load(std::memory_order_relaxed);
+  counters.deallocations = g_deallocations.load(std::memory_order_relaxed);
+  counters.bytes = g_bytes.load(std::memory_order_relaxed);
+  return counters;
+}
+
+AllocCounters thread_alloc_counters() { return t_counters; }
+
+}  // namespace wmbus_parser
+}  // namespace esphome
+
+#if defined(CONFIG_HEAP_USE_HOOKS)
+
+// Called by ESP-IDF for every heap_caps allocation, malloc and operator new
+// included.
+extern "C" void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t /*caps*/) {
+  if (ptr != nullptr)
+    count_alloc(size);
+}
+
+extern "C" void esp_heap_trace_free_hook(void *ptr) {
+  if (ptr != nullptr)
+    count_free();
+}
+
+#elif defined(WMBUS_PARSER_COUNT_MALLOC)
+
+// glibc's own entry points; these replace the public names for the whole
+// program, so C library code is counted too. operator new calls malloc.
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) noexcept {
+  count_alloc(size);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept {
+  count_alloc(count * size);
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) noexcept {
+  if (ptr != nullptr)
+    count_free();
+  if (ptr == nullptr || size > 0)
+    count_alloc(size);
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) noexcept {
+  if (ptr != nullptr)
+    count_free();
+  __libc_free(ptr);
+}
+}
+
+#else
+
+void *operator new(std::size_t size) { return counted_alloc_or_throw(size); }
+void *operator new[](std::size_t size) { return counted_alloc_or_throw(size); }
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept { return counted_alloc(size); }
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept { return counted_alloc(size); }
+void operator delete(void *ptr) noexcept { counted_free(ptr); }
+void operator delete[](void *ptr) noexcept { counted_free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { counted_free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { counted_free(ptr); }
+
+#endif
+
+#endif  // WMBUS_PARSER_COUNT_ALLOCATIONS
@@ -0,0 +1,56 @@
+/**
+ * Heap allocation counter, enabled with the WMBUS_PARSER_COUNT_ALLOCATIONS
+ * build flag.
+ *
+ * When the flag is set, alloc_counter.cpp counts every heap allocation so
+ * the parser can report how many each telegram caused: on glibc hosts by
+ * replacing malloc, calloc, realloc and free, on ESP-IDF with
+ * CONFIG_HEAP_USE_HOOKS through the heap trace hooks. Both see C library
+ * and mbedtls allocations as well as operator new, which is built on malloc.
+ * Elsewhere (or under a sanitizer, which owns malloc) only the global
+ * operator new/delete are replaced, and direct malloc calls go uncounted;
+ * ALLOC_COUNTING_SEES_MALLOC tells which. Without the flag the counters
+ * always read zero and nothing is replaced.
+ *
+ * A telegram decoded on the worker thread and published from loop() is
+ * measured on each thread with thread_alloc_counters(), so allocations of
+ * other threads in between are not charged to it.
+ */
+#pragma once
+
+#include <cstdint>
+
+#ifdef USE_ESP32
+#include <sdkconfig.h>
+#endif
+
+namespace esphome {
+namespace wmbus_parser {
+
+struct AllocCounters {
+  uint64_t allocations{0};
+  uint64_t deallocations{0};
+  uint64_t bytes{0};
+};
+
+#ifdef WMBUS_PARSER_COUNT_ALLOCATIONS
+#if (defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)) || \
+    defined(CONFIG_HEAP_USE_HOOKS)
+#define WMBUS_PARSER_COUNT_MALLOC
+static constexpr bool ALLOC_COUNTING_SEES_MALLOC = true;
+#else
+static constexpr bool ALLOC_COUNTING_SEES_MALLOC = false;
+#endif
+static constexpr bool ALLOC_COUNTING_ENABLED = true;
+AllocCounters alloc_counters();
+/// The same, for the calling thread only.
+AllocCounters thread_alloc_counters();
+#else
+static constexpr bool ALLOC_COUNTING_SEES_MALLOC = false;
+static constexpr bool ALLOC_COUNTING_ENABLED = false;
+inline AllocCounters alloc_counters() { return {}; }
+inline AllocCounters thread_alloc_counters() { return {}; }
+#endif
+
+}  // namespace wmbus_parser
+}  // namespace esphome
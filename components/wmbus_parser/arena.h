@@ -0,0 +1,69 @@
+/**
+ * Fixed-size bump allocator reset after every telegram.
+ *
+ * The buffer is allocated once (WMBusParser::setup or first use) and then
+ * reused, so per-telegram scratch data such as on_decode attribute strings
+ * never reaches the heap in steady state. Allocations that do not fit return
+ * nullptr and are counted as overflows; callers fall back to the heap.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace esphome {
+namespace wmbus_parser {
+
+class TelegramArena {
+ public:
+  static constexpr size_t DEFAULT_CAPACITY = 2048;
+
+  /// (Re)allocate the backing buffer. Only call this outside of decoding.
+  void init(size_t capacity) {
+    this->buffer_.reset(capacity > 0 ? new uint8_t[capacity] : nullptr);
+    this->capacity_ = capacity;
+    this->used_ = 0;
+    this->generation_++;
+  }
+
+  void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+    size_t start = (this->used_ + align - 1) & ~(align - 1);
+    if (this->buffer_ == nullptr || start + size > this->capacity_) {
+      this->overflows_++;
+      return nullptr;
+    }
+    this->used_ = start + size;
+    if (this->used_ > this->high_water_)
+      this->high_water_ = this->used_;
+    return this->buffer_.get() + start;
+  }
+
+  template<typename T> T *allocate_array(size_t count) {
+    return static_cast<T *>(this->allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  /// Release everything handed out since the last reset. Pointers obtained
+  /// before the reset become invalid; generation() lets holders detect that.
+  void reset() {
+    this->used_ = 0;
+    this->generation_++;
+  }
+
+  size_t capacity() const { return this->capacity_; }
+  size_t used() const { return this->used_; }
+  size_t high_water() const { return this->high_water_; }
+  uint32_t generation() const { return this->generation_; }
+  uint32_t overflows() const { return this->overflows_; }
+
+ protected:
+  std::unique_ptr<uint8_t[]> buffer_;
+  size_t capacity_{0};
+  size_t used_{0};
+  size_t high_water_{0};
+  uint32_t generation_{0};
+  uint32_t overflows_{0};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
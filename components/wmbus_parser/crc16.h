@@ -0,0 +1,53 @@
+/**
+ * EN 13757-4 CRC16 (polynomial 0x3D65, initial value 0, result inverted)
+ * used for the link-layer blocks of wM-Bus frames.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace wmbus_parser {
+
+static constexpr uint16_t CRC16_EN13757_POLY = 0x3D65;
+
+namespace crc_detail {
+
+constexpr std::array<uint16_t, 256> make_crc16_table() {
+  std::array<uint16_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++) {
+    uint16_t crc = static_cast<uint16_t>(i << 8);
+    for (int bit = 0; bit < 8; bit++)
+      crc = static_cast<uint16_t>((crc & 0x8000) ? (crc << 1) ^ CRC16_EN13757_POLY : crc << 1);
+    table[i] = crc;
+  }
+  return table;
+}
+
+}  // namespace crc_detail
+
+static constexpr std::array<uint16_t, 256> CRC16_EN13757_TABLE = crc_detail::make_crc16_table();
+
+/// One byte of a running CRC. Start from 0 and invert the result, as
+/// crc16_en13757() does.
+inline uint16_t crc16_en13757_update(uint16_t crc, uint8_t byte) {
+  return static_cast<uint16_t>((crc << 8) ^ CRC16_EN13757_TABLE[(crc >> 8) ^ byte]);
+}
+
+inline uint16_t crc16_en13757(const uint8_t *data, size_t len) {
+  uint16_t crc = 0;
+  for (size_t i = 0; i < len; i++)
+    crc = crc16_en13757_update(crc, data[i]);
+  return static_cast<uint16_t>(~crc);
+}
+
+/// True if the two bytes after ``data[0..len)`` hold its CRC, MSB first.
+inline bool crc16_en13757_matches(const uint8_t *data, size_t len) {
+  uint16_t crc = crc16_en13757(data, len);
+  return data[len] == static_cast<uint8_t>(crc >> 8) && data[len + 1] == static_cast<uint8_t>(crc);
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,132 @@
+#include "decode_worker.h"
+
+#include "esphome/core/log.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+static const char *const TAG = "wmbus_parser.worker";
+
+#ifdef USE_ESP32
+
+static constexpr uint32_t WORKER_STACK_SIZE = 4096;
+static constexpr UBaseType_t WORKER_PRIORITY = 5;
+
+bool DecodeWorker::start(DrainFn drain, void *arg) {
+  if (this->running_)
+    return true;
+  this->drain_ = drain;
+  this->arg_ = arg;
+#if portNUM_PROCESSORS > 1
+  const BaseType_t core = 1;
+#else
+  const BaseType_t core = tskNO_AFFINITY;
+#endif
+  if (xTaskCreatePinnedToCore(&DecodeWorker::task_entry_, "wmbus_decode", WORKER_STACK_SIZE, this, WORKER_PRIORITY,
+                              &this->task_, core) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to create decode task");
+    return false;
+  }
+  this->running_ = true;
+  return true;
+}
+
+void DecodeWorker::task_entry_(void *param) {
+  auto *worker = static_cast<DecodeWorker *>(param);
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    worker->drain_(worker->arg_);
+  }
+}
+
+void DecodeWorker::notify() {
+  if (this->task_ != nullptr)
+    xTaskNotifyGive(this->task_);
+}
+
+void DecodeWorker::stop() {
+  if (this->task_ != nullptr) {
+    vTaskDelete(this->task_);
+    this->task_ = nullptr;
+  }
+  this->running_ = false;
+}
+
+uint32_t DecodeWorker::stack_size() const { return WORKER_STACK_SIZE; }
+
+uint32_t DecodeWorker::stack_free_min() const {
+  // ESP-IDF counts the stack in bytes, not words as vanilla FreeRTOS.
+  return this->task_ != nullptr ? static_cast<uint32_t>(uxTaskGetStackHighWaterMark(this->task_)) : 0;
+}
+
+#elif defined(USE_HOST)
+
+bool DecodeWorker::start(DrainFn drain, void *arg) {
+  if (this->running_)
+    return true;
+  this->drain_ = drain;
+  this->arg_ = arg;
+  this->stop_requested_ = false;
+  this->thread_ = std::thread(&DecodeWorker::thread_main_, this);
+  this->running_ = true;
+  return true;
+}
+
+void DecodeWorker::thread_main_() {
+  std::unique_lock<std::mutex> lock(this->mutex_);
+  for (;;) {
+    this->cv_.wait(lock, [this] { return this->pending_ || this->stop_requested_; });
+    if (this->stop_requested_)
+      return;
+    this->pending_ = false;
+    lock.unlock();
+    this->drain_(this->arg_);
+    lock.lock();
+  }
+}
+
+void DecodeWorker::notify() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->pending_ = true;
+  }
+  this->cv_.notify_one();
+}
+
+void DecodeWorker::stop() {
+  if (!this->running_)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    this->stop_requested_ = true;
+  }
+  this->cv_.notify_one();
+  this->thread_.join();
+  this->running_ = false;
+}
+
+uint32_t DecodeWorker::stack_size() const { return 0; }
+
+uint32_t DecodeWorker::stack_free_min() const { return 0; }
+
+#else
+
+bool DecodeWorker::start(DrainFn drain, void *arg) {
+  (void) drain;
+  (void) arg;
+  ESP_LOGW(TAG, "No decode task on this platform, decoding in loop()");
+  return false;
+}
+
+void DecodeWorker::notify() {}
+
+void DecodeWorker::stop() {}
+
+uint32_t DecodeWorker::stack_size() const { return 0; }
+
+uint32_t DecodeWorker::stack_free_min() const { return 0; }
+
+#endif
+
+}  // namespace wmbus_parser
+}  // namespace esphome
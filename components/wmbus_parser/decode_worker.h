@@ -0,0 +1,62 @@
+/**
+ * Background task that drains the receive queue.
+ *
+ * On ESP32 this is a FreeRTOS task pinned to the second core (or unpinned on
+ * single-core chips) that sleeps on a task notification. The host build
+ * uses a std::thread. On other platforms start() fails and the parser
+ * drains the queue from loop() instead.
+ */
+#pragma once
+
+#include <cstdint>
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#elif defined(USE_HOST)
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace esphome {
+namespace wmbus_parser {
+
+class DecodeWorker {
+ public:
+  using DrainFn = void (*)(void *arg);
+
+  ~DecodeWorker() { this->stop(); }
+
+  /// Start the worker; ``drain`` is called with ``arg`` after every notify().
+  bool start(DrainFn drain, void *arg);
+  /// Wake the worker. Safe to call from the producer at any rate.
+  void notify();
+  void stop();
+  bool is_running() const { return this->running_; }
+  /// Stack the task was created with, and the least of it that was ever
+  /// free, in bytes; 0 where the platform does not tell.
+  uint32_t stack_size() const;
+  uint32_t stack_free_min() const;
+
+ protected:
+  DrainFn drain_{nullptr};
+  void *arg_{nullptr};
+  bool running_{false};
+#ifdef USE_ESP32
+  static void task_entry_(void *param);
+  TaskHandle_t task_{nullptr};
+#elif defined(USE_HOST)
+  void thread_main_();
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool pending_{false};
+  bool stop_requested_{false};
+#endif
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
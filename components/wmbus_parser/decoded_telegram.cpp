@@ -0,0 +1,260 @@
+#include "decoded_telegram.h"
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+constexpr double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6};
+constexpr int MAX_FAST_DECIMALS = sizeof(POW10) / sizeof(POW10[0]) - 1;
+// Scaled values below this are integers a double holds exactly.
+constexpr double MAX_FAST_SCALED = 9007199254740992.0;  // 2^53
+
+// ``width`` decimal digits of ``value``, zero padded; returns the end.
+char *put_digits(char *out, uint32_t value, int width) {
+  for (int i = width - 1; i >= 0; i--) {
+    out[i] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  }
+  return out + width;
+}
+
+char *put_uint(char *out, uint64_t value) {
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = static_cast<char>('0' + value % 10);
+    value /= 10;
+  } while (value != 0);
+  while (count > 0)
+    *out++ = digits[--count];
+  return out;
+}
+
+// Copy ``len`` bytes of ``text`` to a buffer of ``size`` bytes with the same
+// truncation as snprintf.
+size_t copy_out(char *buf, size_t size, const char *text, size_t len) {
+  if (size == 0)
+    return len;
+  const size_t n = len < size ? len : size - 1;
+  std::memcpy(buf, text, n);
+  buf[n] = '\0';
+  return len;
+}
+
+}  // namespace
+
+size_t format_decimal(char *buf, size_t size, float value, int decimals) {
+  char text[48];
+  size_t end;
+  const double magnitude = std::fabs(static_cast<double>(value));
+  if (std::isfinite(value) && decimals >= 0 && decimals <= MAX_FAST_DECIMALS &&
+      magnitude * POW10[decimals] < MAX_FAST_SCALED) {
+    // A float times 10^6 or less is exact in a double, so rounding the scaled
+    // value half to even gives what printf("%.*f") prints.
+    const double scaled = magnitude * POW10[decimals];
+    const double whole = std::floor(scaled);
+    const double fraction = scaled - whole;
+    uint64_t units = static_cast<uint64_t>(whole);
+    if (fraction > 0.5 || (fraction == 0.5 && (units & 1) != 0))
+      units++;
+    const uint64_t divisor = static_cast<uint64_t>(POW10[decimals]);
+    char *out = text;
+    if (std::signbit(value))
+      *out++ = '-';
+    out = put_uint(out, units / divisor);
+    if (decimals > 0) {
+      *out++ = '.';
+      out = put_digits(out, static_cast<uint32_t>(units % divisor), decimals);
+    }
+    end = static_cast<size_t>(out - text);
+  } else {
+    const int n = snprintf(text, sizeof(text), "%.*f", decimals, value);
+    if (n < 0)
+      return 0;
+    end = static_cast<size_t>(n) < sizeof(text) ? static_cast<size_t>(n) : sizeof(text) - 1;
+  }
+  if (size == 0)
+    return 0;
+  if (end > size - 1)
+    end = size - 1;
+  // Trim trailing zeros and a dangling decimal point ("1.500" -> "1.5", "2.000" -> "2").
+  const char *dot = static_cast<const char *>(std::memchr(text, '.', end));
+  if (dot != nullptr) {
+    const size_t dot_pos = static_cast<size_t>(dot - text);
+    while (end > dot_pos + 1 && text[end - 1] == '0')
+      --end;
+    if (end == dot_pos + 1)
+      --end;
+  }
+  std::memcpy(buf, text, end);
+  buf[end] = '\0';
+  return end;
+}
+
+size_t format_date(char *buf, size_t size, const Date &d) {
+  char text[12];
+  char *out = put_digits(text, d.year, 4);
+  *out++ = '-';
+  out = put_digits(out, d.month, 2);
+  *out++ = '-';
+  out = put_digits(out, d.day, 2);
+  return copy_out(buf, size, text, out - text);
+}
+
+size_t format_datetime(char *buf, size_t size, const DateTime &dt) {
+  char text[20];
+  char *out = text + format_date(text, sizeof(text), Date{dt.year, dt.month, dt.day});
+  *out++ = ' ';
+  out = put_digits(out, dt.hour, 2);
+  *out++ = ':';
+  out = put_digits(out, dt.minute, 2);
+  return copy_out(buf, size, text, out - text);
+}
+
+size_t format_timestamp(char *buf, size_t size, std::time_t timestamp) {
+  std::tm tm {};
+#if defined(_WIN32) || defined(_WIN64)
+  gmtime_s(&tm, &timestamp);
+#else
+  gmtime_r(&timestamp, &tm);
+#endif
+  return std::strftime(buf, size, "%Y-%m-%dT%H:%M:%SZ", &tm);
+}
+
+size_t format_status(char *buf, size_t size, uint32_t flags) {
+  if (flags == 0)
+    return copy_out(buf, size, "OK", 2);
+  static const char HEX[] = "0123456789ABCDEF";
+  char text[] = "ERROR_FLAGS_0000";
+  for (size_t i = 0; i < 4; i++)
+    text[sizeof(text) - 2 - i] = HEX[(flags >> (4 * i)) & 0x0F];
+  return copy_out(buf, size, text, sizeof(text) - 1);
+}
+
+size_t DecodedTelegram::history_key(char *buf, size_t size, size_t index) {
+  char text[ATTRIBUTE_KEY_SIZE];
+  static const char PREFIX[] = "consumption_at_history_";
+  std::memcpy(text, PREFIX, sizeof(PREFIX) - 1);
+  char *out = put_uint(text + sizeof(PREFIX) - 1, index + 1);
+  std::memcpy(out, "_m3", 3);
+  return copy_out(buf, size, text, out + 3 - text);
+}
+
+uint32_t DecodedTelegram::changed_fields(const DecodedTelegram &previous, uint16_t &history_changed) const {
+  uint32_t changed = this->present & ~previous.present;
+  auto differs = [&](DecodedField field, bool different) {
+    if (this->has(field) && previous.has(field) && different)
+      changed |= field;
+  };
+  differs(FIELD_TOTAL_M3, this->total_m3 != previous.total_m3);
+  differs(FIELD_TIMESTAMP, this->timestamp != previous.timestamp);
+  differs(FIELD_DEVICE_DATETIME, this->device_datetime != previous.device_datetime);
+  differs(FIELD_FABRICATION_NO, strcmp(this->fabrication_no, previous.fabrication_no) != 0);
+  differs(FIELD_STATUS, this->status_flags != previous.status_flags);
+  differs(FIELD_CONSUMPTION_AT_SET_DATE, this->consumption_at_set_date_m3 != previous.consumption_at_set_date_m3);
+  differs(FIELD_SET_DATE, this->set_date != previous.set_date);
+  differs(FIELD_CONSUMPTION_AT_SET_DATE_2, this->consumption_at_set_date_2_m3 != previous.consumption_at_set_date_2_m3);
+  differs(FIELD_SET_DATE_2, this->set_date_2 != previous.set_date_2);
+  differs(FIELD_MAX_FLOW, this->max_flow_m3h != previous.max_flow_m3h);
+  differs(FIELD_MAX_FLOW_DATETIME, this->max_flow_datetime != previous.max_flow_datetime);
+  differs(FIELD_HISTORY_REFERENCE_DATE, this->history_reference_date != previous.history_reference_date);
+  differs(FIELD_HISTORY_INTERVAL, this->history_interval_months != previous.history_interval_months);
+  differs(FIELD_TOTAL_ENERGY, this->total_energy_kwh != previous.total_energy_kwh);
+  differs(FIELD_POWER, this->power_kw != previous.power_kw);
+  differs(FIELD_VOLUME_FLOW, this->volume_flow_m3h != previous.volume_flow_m3h);
+  differs(FIELD_FLOW_TEMPERATURE, this->flow_temperature_c != previous.flow_temperature_c);
+  differs(FIELD_RETURN_TEMPERATURE, this->return_temperature_c != previous.return_temperature_c);
+  differs(FIELD_RSSI, this->receive.rssi_dbm != previous.receive.rssi_dbm);
+
+  history_changed = this->history_present & ~previous.history_present;
+  for (size_t i = 0; i < MAX_HISTORY; i++) {
+    if (this->has_history(i) && previous.has_history(i) && this->history_m3[i] != previous.history_m3[i])
+      history_changed |= static_cast<uint16_t>(1u << i);
+  }
+  return changed;
+}
+
+void AttributeList::copy_from_(const AttributeList &other) {
+  this->telegram_ = other.telegram_;
+  this->arena_ = other.arena_;
+  this->heap_items_.clear();
+  this->heap_text_.clear();
+  this->materialized_ = other.materialized_ && other.in_arena_;
+  this->in_arena_ = this->materialized_;
+  this->items_ = this->materialized_ ? other.items_ : nullptr;
+  this->count_ = this->materialized_ ? other.count_ : 0;
+  this->generation_ = other.generation_;
+}
+
+const Attribute *AttributeList::entries_() const {
+  if (this->materialized_ && this->in_arena_ && this->arena_->generation() != this->generation_)
+    this->materialized_ = false;
+  if (!this->materialized_) {
+    if (!this->materialize_in_arena_())
+      this->materialize_on_heap_();
+    this->materialized_ = true;
+  }
+  return this->items_;
+}
+
+bool AttributeList::materialize_in_arena_() const {
+  if (this->arena_ == nullptr)
+    return false;
+  size_t count = this->telegram_.attribute_count();
+  Attribute *items = this->arena_->allocate_array<Attribute>(count);
+  if (items == nullptr && count > 0)
+    return false;
+  size_t index = 0;
+  bool ok = true;
+  this->telegram_.for_each_attribute([&](const char *key, const char *value) {
+    size_t key_size = strlen(key);
+    size_t size = key_size + 1 + strlen(value);
+    char *text = ok && index < count ? static_cast<char *>(this->arena_->allocate(size + 1, 1)) : nullptr;
+    if (text == nullptr) {
+      ok = false;
+      return;
+    }
+    memcpy(text, key, key_size);
+    text[key_size] = '=';
+    memcpy(text + key_size + 1, value, size - key_size);  // includes the terminator
+    items[index++] = Attribute(text, static_cast<uint16_t>(size), static_cast<uint16_t>(key_size));
+  });
+  if (!ok)
+    return false;
+  this->items_ = items;
+  this->count_ = index;
+  this->generation_ = this->arena_->generation();
+  this->in_arena_ = true;
+  return true;
+}
+
+void AttributeList::materialize_on_heap_() const {
+  this->heap_text_.clear();
+  this->heap_items_.clear();
+  std::vector<std::pair<size_t, uint16_t>> spans;  // offset, key size
+  this->telegram_.for_each_attribute([&](const char *key, const char *value) {
+    size_t offset = this->heap_text_.size();
+    size_t key_size = strlen(key);
+    this->heap_text_.insert(this->heap_text_.end(), key, key + key_size);
+    this->heap_text_.push_back('=');
+    this->heap_text_.insert(this->heap_text_.end(), value, value + strlen(value) + 1);
+    spans.emplace_back(offset, static_cast<uint16_t>(key_size));
+  });
+  // Pointers are taken only once the text buffer has stopped growing.
+  for (size_t i = 0; i < spans.size(); i++) {
+    size_t end = i + 1 < spans.size() ? spans[i + 1].first : this->heap_text_.size();
+    const char *text = this->heap_text_.data() + spans[i].first;
+    this->heap_items_.emplace_back(text, static_cast<uint16_t>(end - spans[i].first - 1), spans[i].second);
+  }
+  this->items_ = this->heap_items_.data();
+  this->count_ = this->heap_items_.size();
+  this->in_arena_ = false;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
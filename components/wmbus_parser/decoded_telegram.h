@@ -0,0 +1,345 @@
+/**
+ * Typed result of decoding one telegram.
+ *
+ * Drivers fill the numeric, date and history fields directly and mark them
+ * present; nothing is converted to text during decoding. Consumers that want
+ * the classic ``key=value`` attributes get them from for_each_attribute() or
+ * AttributeList, which format into stack buffers on demand.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "arena.h"
+#include "receive_info.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+struct Date {
+  uint16_t year{0};
+  uint8_t month{0};
+  uint8_t day{0};
+
+  bool operator==(const Date &other) const {
+    return this->year == other.year && this->month == other.month && this->day == other.day;
+  }
+  bool operator!=(const Date &other) const { return !(*this == other); }
+};
+
+struct DateTime {
+  uint16_t year{0};
+  uint8_t month{0};
+  uint8_t day{0};
+  uint8_t hour{0};
+  uint8_t minute{0};
+
+  bool operator==(const DateTime &other) const {
+    return this->year == other.year && this->month == other.month && this->day == other.day &&
+           this->hour == other.hour && this->minute == other.minute;
+  }
+  bool operator!=(const DateTime &other) const { return !(*this == other); }
+};
+
+// Presence bits for DecodedTelegram::present.
+enum DecodedField : uint32_t {
+  FIELD_TOTAL_M3 = 1u << 0,
+  FIELD_TIMESTAMP = 1u << 1,
+  FIELD_DEVICE_DATETIME = 1u << 2,
+  FIELD_FABRICATION_NO = 1u << 3,
+  FIELD_STATUS = 1u << 4,
+  FIELD_CONSUMPTION_AT_SET_DATE = 1u << 5,
+  FIELD_SET_DATE = 1u << 6,
+  FIELD_CONSUMPTION_AT_SET_DATE_2 = 1u << 7,
+  FIELD_SET_DATE_2 = 1u << 8,
+  FIELD_MAX_FLOW = 1u << 9,
+  FIELD_MAX_FLOW_DATETIME = 1u << 10,
+  FIELD_HISTORY_REFERENCE_DATE = 1u << 11,
+  FIELD_HISTORY_INTERVAL = 1u << 12,
+  FIELD_TOTAL_ENERGY = 1u << 13,
+  FIELD_POWER = 1u << 14,
+  FIELD_VOLUME_FLOW = 1u << 15,
+  FIELD_FLOW_TEMPERATURE = 1u << 16,
+  FIELD_RETURN_TEMPERATURE = 1u << 17,
+  FIELD_RSSI = 1u << 18,
+};
+
+// Clock and reception fields move with every telegram, so they never count as
+// a change.
+static constexpr uint32_t FIELD_CLOCK_MASK = FIELD_TIMESTAMP | FIELD_DEVICE_DATETIME;
+static constexpr uint32_t FIELD_RECEPTION_MASK = FIELD_RSSI;
+
+// Buffer sizes large enough for any value produced by the format_* helpers.
+static constexpr size_t ATTRIBUTE_KEY_SIZE = 40;
+static constexpr size_t ATTRIBUTE_VALUE_SIZE = 32;
+
+// Whether an attribute value is a number (a JSON number) or text.
+enum class AttributeKind : uint8_t { NUMBER, TEXT };
+
+template<typename Fn> inline void emit_attribute(Fn &fn, const char *key, const char *value, AttributeKind kind) {
+  if constexpr (std::is_invocable_v<Fn &, const char *, const char *, AttributeKind>) {
+    fn(key, value, kind);
+  } else {
+    fn(key, value);
+  }
+}
+
+size_t format_decimal(char *buf, size_t size, float value, int decimals = 3);
+size_t format_date(char *buf, size_t size, const Date &d);
+size_t format_datetime(char *buf, size_t size, const DateTime &dt);
+size_t format_timestamp(char *buf, size_t size, std::time_t timestamp);
+size_t format_status(char *buf, size_t size, uint32_t flags);
+
+struct DecodedTelegram {
+  // Monthly history slots; slot 0 holds storage number 8.
+  static constexpr size_t MAX_HISTORY = 16;
+  static constexpr size_t FABRICATION_NO_SIZE = 17;
+
+  uint32_t present{0};
+  uint16_t history_present{0};
+
+  float total_m3{NAN};
+  float consumption_at_set_date_m3{NAN};
+  float consumption_at_set_date_2_m3{NAN};
+  float max_flow_m3h{NAN};
+  float volume_flow_m3h{NAN};
+  float total_energy_kwh{NAN};
+  float power_kw{NAN};
+  float flow_temperature_c{NAN};
+  float return_temperature_c{NAN};
+  float history_m3[MAX_HISTORY]{};
+
+  Date set_date;
+  Date set_date_2;
+  Date history_reference_date;
+  DateTime device_datetime;
+  DateTime max_flow_datetime;
+
+  std::time_t timestamp{0};  // wall-clock time of reception
+  ReceiveInfo receive;       // set by the parser, FIELD_RSSI if the radio reported one
+  uint32_t status_flags{0};
+  uint8_t history_interval_months{1};
+  char fabrication_no[FABRICATION_NO_SIZE]{};
+
+  bool has(DecodedField field) const { return (this->present & field) != 0; }
+  void mark(DecodedField field) { this->present |= field; }
+
+  bool has_history(size_t index) const { return index < MAX_HISTORY && (this->history_present >> index) & 1u; }
+  void set_history(size_t index, float value) {
+    if (index >= MAX_HISTORY)
+      return;
+    this->history_m3[index] = value;
+    this->history_present |= static_cast<uint16_t>(1u << index);
+  }
+
+  void clear() { *this = DecodedTelegram(); }
+
+  /// Present fields whose value differs from ``previous`` or that it lacks;
+  /// ``history_changed`` receives the same for the history slots.
+  uint32_t changed_fields(const DecodedTelegram &previous, uint16_t &history_changed) const;
+  /// Drop every field and history slot not selected by the masks.
+  void keep_only(uint32_t fields, uint16_t history) {
+    this->present &= fields;
+    this->history_present &= history;
+  }
+
+  /// Number of entries for_each_attribute() will produce.
+  size_t attribute_count() const {
+    size_t count = __builtin_popcount(this->present & ~static_cast<uint32_t>(FIELD_HISTORY_INTERVAL));
+    if (this->history_present != 0)
+      count += __builtin_popcount(this->history_present) + 1;
+    return count;
+  }
+
+  /// Invoke ``fn(const char *key, const char *value)`` for every present
+  /// field, in the order the attributes have always been documented. Keys and
+  /// values point into stack buffers that are only valid during the call.
+  /// ``fn`` may take the AttributeKind as a third argument.
+  template<typename Fn> void for_each_attribute(Fn &&fn) const {
+    char value[ATTRIBUTE_VALUE_SIZE];
+    if (this->has(FIELD_TOTAL_M3)) {
+      format_decimal(value, sizeof(value), this->total_m3);
+      emit_attribute(fn, "total_m3", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_TIMESTAMP)) {
+      format_timestamp(value, sizeof(value), this->timestamp);
+      emit_attribute(fn, "timestamp", value, AttributeKind::TEXT);
+    }
+    if (this->has(FIELD_DEVICE_DATETIME)) {
+      format_datetime(value, sizeof(value), this->device_datetime);
+      emit_attribute(fn, "device_date_time", value, AttributeKind::TEXT);
+    }
+    if (this->has(FIELD_FABRICATION_NO))
+      emit_attribute(fn, "fabrication_no", this->fabrication_no, AttributeKind::TEXT);
+    if (this->has(FIELD_STATUS)) {
+      format_status(value, sizeof(value), this->status_flags);
+      emit_attribute(fn, "current_status", value, AttributeKind::TEXT);
+    }
+    if (this->has(FIELD_CONSUMPTION_AT_SET_DATE)) {
+      format_decimal(value, sizeof(value), this->consumption_at_set_date_m3);
+      emit_attribute(fn, "consumption_at_set_date_m3", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_SET_DATE)) {
+      format_date(value, sizeof(value), this->set_date);
+      emit_attribute(fn, "set_date", value, AttributeKind::TEXT);
+    }
+    if (this->has(FIELD_CONSUMPTION_AT_SET_DATE_2)) {
+      format_decimal(value, sizeof(value), this->consumption_at_set_date_2_m3);
+      emit_attribute(fn, "consumption_at_set_date_2_m3", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_SET_DATE_2)) {
+      format_date(value, sizeof(value), this->set_date_2);
+      emit_attribute(fn, "set_date_2", value, AttributeKind::TEXT);
+    }
+    if (this->has(FIELD_MAX_FLOW)) {
+      format_decimal(value, sizeof(value), this->max_flow_m3h);
+      emit_attribute(fn, "max_flow_since_datetime_m3h", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_MAX_FLOW_DATETIME)) {
+      format_datetime(value, sizeof(value), this->max_flow_datetime);
+      emit_attribute(fn, "max_flow_datetime", value, AttributeKind::TEXT);
+    }
+    if (this->has(FIELD_HISTORY_REFERENCE_DATE)) {
+      format_date(value, sizeof(value), this->history_reference_date);
+      emit_attribute(fn, "history_reference_date", value, AttributeKind::TEXT);
+    }
+    if (this->has(FIELD_VOLUME_FLOW)) {
+      format_decimal(value, sizeof(value), this->volume_flow_m3h);
+      emit_attribute(fn, "volume_flow_m3h", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_TOTAL_ENERGY)) {
+      format_decimal(value, sizeof(value), this->total_energy_kwh);
+      emit_attribute(fn, "total_energy_kwh", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_POWER)) {
+      format_decimal(value, sizeof(value), this->power_kw);
+      emit_attribute(fn, "power_kw", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_FLOW_TEMPERATURE)) {
+      format_decimal(value, sizeof(value), this->flow_temperature_c, 2);
+      emit_attribute(fn, "flow_temperature_c", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_RETURN_TEMPERATURE)) {
+      format_decimal(value, sizeof(value), this->return_temperature_c, 2);
+      emit_attribute(fn, "return_temperature_c", value, AttributeKind::NUMBER);
+    }
+    if (this->has(FIELD_RSSI)) {
+      format_decimal(value, sizeof(value), this->receive.rssi_dbm, 1);
+      emit_attribute(fn, "rssi_dbm", value, AttributeKind::NUMBER);
+    }
+    if (this->history_present != 0) {
+      char key[ATTRIBUTE_KEY_SIZE];
+      for (size_t i = 0; i < MAX_HISTORY; i++) {
+        if (!this->has_history(i))
+          continue;
+        history_key(key, sizeof(key), i);
+        format_decimal(value, sizeof(value), this->history_m3[i]);
+        emit_attribute(fn, key, value, AttributeKind::NUMBER);
+      }
+      format_decimal(value, sizeof(value), this->history_interval_months, 0);
+      emit_attribute(fn, "history_interval_months", value, AttributeKind::NUMBER);
+    }
+  }
+
+  /// ``consumption_at_history_<n>_m3`` with n counted from 1.
+  static size_t history_key(char *buf, size_t size, size_t index);
+};
+
+/// One ``key=value`` entry of an AttributeList. Offers the subset of the
+/// std::string interface that on_decode lambdas use, without owning memory.
+class Attribute {
+ public:
+  static constexpr size_t npos = std::string::npos;
+
+  Attribute() = default;
+  Attribute(const char *text, uint16_t size, uint16_t key_size) : text_(text), size_(size), key_size_(key_size) {}
+
+  const char *c_str() const { return this->text_; }
+  const char *data() const { return this->text_; }
+  size_t size() const { return this->size_; }
+  size_t length() const { return this->size_; }
+  bool empty() const { return this->size_ == 0; }
+  char operator[](size_t index) const { return this->text_[index]; }
+
+  size_t find(char c, size_t pos = 0) const {
+    for (size_t i = pos; i < this->size_; i++) {
+      if (this->text_[i] == c)
+        return i;
+    }
+    return npos;
+  }
+  std::string substr(size_t pos, size_t count = npos) const {
+    if (pos >= this->size_)
+      return {};
+    size_t remaining = this->size_ - pos;
+    return std::string(this->text_ + pos, count < remaining ? count : remaining);
+  }
+  operator std::string() const { return std::string(this->text_, this->size_); }
+
+  std::string key() const { return std::string(this->text_, this->key_size_); }
+  /// NUL-terminated value part.
+  const char *value() const { return this->text_ + this->key_size_ + 1; }
+
+ protected:
+  const char *text_{""};
+  uint16_t size_{0};
+  uint16_t key_size_{0};
+};
+
+/**
+ * ``key=value`` view of a decoded telegram handed to on_decode automations.
+ *
+ * Holds a copy of the typed result and only formats the entries the first
+ * time it is iterated. Entries are placed in the parser's per-telegram arena;
+ * if the arena is full, or the list is used after the arena was reset (for
+ * example by a delayed action), the entries are rebuilt on the heap.
+ */
+class AttributeList {
+ public:
+  AttributeList() = default;
+  explicit AttributeList(const DecodedTelegram &telegram, TelegramArena *arena = nullptr)
+      : telegram_(telegram), arena_(arena) {}
+  AttributeList(const AttributeList &other) { this->copy_from_(other); }
+  AttributeList &operator=(const AttributeList &other) {
+    if (this != &other)
+      this->copy_from_(other);
+    return *this;
+  }
+
+  const DecodedTelegram &telegram() const { return this->telegram_; }
+
+  const Attribute *begin() const { return this->entries_(); }
+  const Attribute *end() const { return this->entries_() + this->count_; }
+  size_t size() const {
+    this->entries_();
+    return this->count_;
+  }
+  bool empty() const { return this->size() == 0; }
+  const Attribute &operator[](size_t index) const { return this->entries_()[index]; }
+
+ protected:
+  // Heap-backed entries point into the source object and are never shared.
+  void copy_from_(const AttributeList &other);
+  const Attribute *entries_() const;
+  bool materialize_in_arena_() const;
+  void materialize_on_heap_() const;
+
+  DecodedTelegram telegram_;
+  TelegramArena *arena_{nullptr};
+  mutable const Attribute *items_{nullptr};
+  mutable size_t count_{0};
+  mutable uint32_t generation_{0};
+  mutable bool materialized_{false};
+  mutable bool in_arena_{false};
+  mutable std::vector<Attribute> heap_items_;
+  mutable std::vector<char> heap_text_;
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,225 @@
+/**
+ * Allocation-free walker for EN 13757-3 data records.
+ *
+ * RecordIterator steps through the application layer of a telegram and yields
+ * one DataRecord per data record: DIF, DIFE chain, VIF, VIFE chain, decoded
+ * storage/tariff/subunit and the data span. DIFE/VIFE chains and data are
+ * exposed as pointers into the telegram, so walking a telegram never touches
+ * the heap.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+static constexpr uint8_t DIF_EXTENSION_BIT = 0x80;
+static constexpr uint8_t VIF_EXTENSION_BIT = 0x80;
+static constexpr uint8_t DIF_IDLE_FILLER = 0x2F;
+static constexpr uint8_t DIF_MANUFACTURER_SPECIFIC = 0x0F;
+static constexpr uint8_t DIF_MANUFACTURER_SPECIFIC_MORE = 0x1F;
+static constexpr uint8_t DATA_CODE_VARIABLE_LENGTH = 0x0D;
+static constexpr uint8_t DATA_CODE_SPECIAL = 0x0F;
+static constexpr uint8_t VIF_PLAIN_TEXT = 0x7C;
+// Length marker for data codes whose size is not fixed by the DIF.
+static constexpr uint8_t DATA_LENGTH_VARIABLE = 0xFF;
+
+/// Data field size in bytes for each DIF data code (EN 13757-3 table 4).
+static constexpr std::array<uint8_t, 16> DIF_DATA_LENGTH = {
+    0,                     // 0: no data
+    1,                     // 1: 8 bit integer
+    2,                     // 2: 16 bit integer
+    3,                     // 3: 24 bit integer
+    4,                     // 4: 32 bit integer
+    4,                     // 5: 32 bit real
+    6,                     // 6: 48 bit integer
+    8,                     // 7: 64 bit integer
+    0,                     // 8: selection for readout
+    1,                     // 9: 2 digit BCD
+    2,                     // A: 4 digit BCD
+    3,                     // B: 6 digit BCD
+    4,                     // C: 8 digit BCD
+    DATA_LENGTH_VARIABLE,  // D: variable length (LVAR)
+    6,                     // E: 12 digit BCD
+    0,                     // F: special functions
+};
+
+/// Data size following an LVAR byte, or DATA_LENGTH_VARIABLE for reserved values.
+constexpr uint16_t lvar_data_length(uint8_t lvar) {
+  if (lvar <= 0xBF)
+    return lvar;  // ASCII string
+  if (lvar <= 0xC9)
+    return lvar - 0xC0;  // positive BCD, (LVAR - C0h) * 2 digits
+  if (lvar >= 0xD0 && lvar <= 0xD9)
+    return lvar - 0xD0;  // negative BCD
+  if (lvar >= 0xE0 && lvar <= 0xEF)
+    return lvar - 0xE0;  // binary number
+  if (lvar >= 0xF0 && lvar <= 0xF4)
+    return 4 * (lvar - 0xEC);  // binary number, 4 * (LVAR - ECh) bytes
+  if (lvar == 0xF5)
+    return 48;
+  if (lvar == 0xF6)
+    return 64;
+  return DATA_LENGTH_VARIABLE;
+}
+
+struct DataRecord {
+  uint8_t dif{0};
+  uint8_t vif{0};
+  uint8_t dife_count{0};
+  uint8_t vife_count{0};
+  const uint8_t *difes{nullptr};
+  const uint8_t *vifes{nullptr};
+  // Plain-text unit for VIF 7Ch/FCh.
+  const uint8_t *vif_text{nullptr};
+  uint8_t vif_text_length{0};
+  // LVAR byte for variable length records (data code Dh).
+  uint8_t lvar{0};
+
+  uint32_t storage{0};
+  uint32_t tariff{0};
+  uint16_t subunit{0};
+
+  const uint8_t *data{nullptr};
+  uint16_t length{0};
+
+  uint8_t data_code() const { return this->dif & 0x0F; }
+  /// Function field: 0 instantaneous, 1 maximum, 2 minimum, 3 value during error state.
+  uint8_t function() const { return (this->dif >> 4) & 0x03; }
+  uint8_t vif_base() const { return this->vif & 0x7F; }
+  bool has_vife() const { return this->vife_count > 0; }
+  uint8_t vife(size_t index) const { return this->vifes[index]; }
+  bool is_manufacturer_specific() const {
+    return this->dif == DIF_MANUFACTURER_SPECIFIC || this->dif == DIF_MANUFACTURER_SPECIFIC_MORE;
+  }
+};
+
+class RecordIterator {
+ public:
+  /// ``records`` must start at the first data record (after the application header).
+  explicit RecordIterator(const TelegramView &records) : records_(records) {}
+
+  /// Fill ``record`` with the next data record. Returns false at the end of the
+  /// telegram or when a record is truncated; truncated() tells the two apart.
+  bool next(DataRecord &record) {
+    const size_t size = this->records_.size();
+    const uint8_t *p = this->records_.data();
+    size_t pos = this->pos_;
+
+    while (pos < size && p[pos] == DIF_IDLE_FILLER)
+      ++pos;
+    if (pos >= size) {
+      this->pos_ = pos;
+      return false;
+    }
+
+    record = DataRecord();
+    record.dif = p[pos++];
+
+    // Manufacturer specific data runs to the end of the telegram.
+    if (record.is_manufacturer_specific()) {
+      record.data = p + pos;
+      record.length = static_cast<uint16_t>(size - pos);
+      this->pos_ = size;
+      return true;
+    }
+    if (record.data_code() == DATA_CODE_SPECIAL) {
+      // Remaining special functions (global readout, reserved) carry no VIF or data.
+      this->pos_ = pos;
+      return true;
+    }
+
+    record.storage = (record.dif >> 6) & 0x01;
+    if (record.dif & DIF_EXTENSION_BIT) {
+      record.difes = p + pos;
+      uint8_t index = 0;
+      uint8_t dife;
+      do {
+        if (pos >= size)
+          return this->fail_();
+        dife = p[pos++];
+        if (index < MAX_DIFE_FIELDS) {
+          record.storage |= static_cast<uint32_t>(dife & 0x0F) << (1 + 4 * index);
+          record.tariff |= static_cast<uint32_t>((dife >> 4) & 0x03) << (2 * index);
+          record.subunit |= static_cast<uint16_t>((dife >> 6) & 0x01) << index;
+        }
+        ++index;
+      } while (dife & DIF_EXTENSION_BIT);
+      record.dife_count = index;
+    }
+
+    if (pos >= size)
+      return this->fail_();
+    record.vif = p[pos++];
+    if (record.vif & VIF_EXTENSION_BIT) {
+      record.vifes = p + pos;
+      uint8_t count = 0;
+      uint8_t vife;
+      do {
+        if (pos >= size)
+          return this->fail_();
+        vife = p[pos++];
+        ++count;
+      } while (vife & VIF_EXTENSION_BIT);
+      record.vife_count = count;
+    }
+    if (record.vif_base() == VIF_PLAIN_TEXT) {
+      if (pos >= size)
+        return this->fail_();
+      record.vif_text_length = p[pos++];
+      record.vif_text = p + pos;
+      pos += record.vif_text_length;
+    }
+
+    uint16_t length = DIF_DATA_LENGTH[record.data_code()];
+    if (length == DATA_LENGTH_VARIABLE) {
+      if (pos >= size)
+        return this->fail_();
+      record.lvar = p[pos++];
+      length = lvar_data_length(record.lvar);
+      if (length == DATA_LENGTH_VARIABLE)
+        return this->fail_();
+    }
+    if (pos + length > size)
+      return this->fail_();
+
+    record.data = p + pos;
+    record.length = length;
+    this->pos_ = pos + length;
+    return true;
+  }
+
+  /// Offset of the next unread byte relative to the start of the records.
+  size_t position() const { return this->pos_; }
+  bool truncated() const { return this->truncated_; }
+
+ protected:
+  // Storage (4 bits), tariff (2) and subunit (1) per DIFE fit 32 bits for 7 DIFEs.
+  static constexpr uint8_t MAX_DIFE_FIELDS = 7;
+
+  bool fail_() {
+    this->truncated_ = true;
+    this->pos_ = this->records_.size();
+    return false;
+  }
+
+  TelegramView records_;
+  size_t pos_{0};
+  bool truncated_{false};
+};
+
+/// Little-endian unsigned integer of up to 4 bytes.
+inline uint32_t read_le_uint(const uint8_t *data, size_t len) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < len && i < 4; i++)
+    value |= static_cast<uint32_t>(data[i]) << (8 * i);
+  return value;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,65 @@
+#include "driver_table.h"
+
+#include <iterator>
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_WMBUS_DRIVER_EVO868
+#include "evo868_driver.h"
+#endif
+#ifdef USE_WMBUS_DRIVER_OMS_HEAT
+#include "oms_heat_driver.h"
+#endif
+#ifdef USE_WMBUS_DRIVER_OMS_WATER
+#include "oms_water_driver.h"
+#endif
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+constexpr DriverEntry DRIVERS[] = {
+#ifdef USE_WMBUS_DRIVER_EVO868
+    {"evo868", &evo868::Evo868Driver::decode, evo868::Evo868Driver::MATCHES,
+     std::size(evo868::Evo868Driver::MATCHES)},
+#endif
+#ifdef USE_WMBUS_DRIVER_OMS_HEAT
+    {"oms_heat", &oms_heat::OmsHeatDriver::decode, oms_heat::OmsHeatDriver::MATCHES,
+     std::size(oms_heat::OmsHeatDriver::MATCHES)},
+#endif
+#ifdef USE_WMBUS_DRIVER_OMS_WATER
+    {"oms_water", &oms_water::OmsWaterDriver::decode, oms_water::OmsWaterDriver::MATCHES,
+     std::size(oms_water::OmsWaterDriver::MATCHES)},
+#endif
+    {nullptr, nullptr, nullptr, 0},  // keeps the array non-empty when no driver is enabled
+};
+
+constexpr size_t DRIVER_COUNT = sizeof(DRIVERS) / sizeof(DRIVERS[0]) - 1;
+
+}  // namespace
+
+size_t driver_count() { return DRIVER_COUNT; }
+
+const DriverEntry &driver_at(size_t index) { return DRIVERS[index]; }
+
+const DriverEntry *find_driver(const std::string &name) {
+  for (size_t i = 0; i < DRIVER_COUNT; i++) {
+    if (name == DRIVERS[i].name)
+      return &DRIVERS[i];
+  }
+  return nullptr;
+}
+
+const DriverEntry *detect_driver(const TelegramView &header) {
+  for (size_t i = 0; i < DRIVER_COUNT; i++) {
+    for (size_t j = 0; j < DRIVERS[i].match_count; j++) {
+      if (DRIVERS[i].matches[j].matches(header))
+        return &DRIVERS[i];
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
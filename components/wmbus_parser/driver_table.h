@@ -0,0 +1,43 @@
+/**
+ * Compile-time table of the WMBus decoders built into the firmware.
+ *
+ * __init__.py emits a USE_WMBUS_DRIVER_<NAME> define for every driver named
+ * in the YAML configuration, so only those drivers are compiled and listed.
+ * Meters resolve their driver by name once in WMBusParser::add_meter and keep
+ * its index; nothing is looked up by name per packet. Meters added with
+ * driver "auto" or through a wildcard manufacturer get theirs from
+ * detect_driver() on their first telegram instead: the first driver, in
+ * table order, with a HeaderMatch for the link header. Specific drivers are
+ * therefore listed before the generic OMS ones.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "decoded_telegram.h"
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+using DecodeFn = bool (*)(const TelegramView &telegram, DecodedTelegram &result);
+
+struct DriverEntry {
+  const char *name;
+  DecodeFn decode;
+  const HeaderMatch *matches;
+  size_t match_count;
+};
+
+/// Number of drivers compiled into this build.
+size_t driver_count();
+const DriverEntry &driver_at(size_t index);
+/// Setup-time lookup by name; nullptr if the driver is not built in.
+const DriverEntry *find_driver(const std::string &name);
+/// Driver for the meter that sent ``header`` (link header up to the device
+/// type); nullptr if no built-in driver reads it.
+const DriverEntry *detect_driver(const TelegramView &header);
+
+}  // namespace wmbus_parser
+}  // namespace esphome
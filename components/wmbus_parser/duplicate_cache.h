@@ -0,0 +1,80 @@
+/**
+ * Per-meter cache of recently seen telegrams.
+ *
+ * Meters retransmit byte-identical frames and repeaters forward frames we have
+ * already heard. Each meter keeps the hashes of its last few payloads so
+ * that copies arriving within the configured window are dropped before the
+ * driver runs.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+/// Hash of the telegram from the access number onwards. The link layer
+/// header is left out because repeaters may rewrite the C-field.
+inline uint32_t telegram_payload_hash(const TelegramView &telegram) {
+  const TelegramView payload = telegram.subview(TELEGRAM_CI_FIELD + 1);
+  const uint8_t *p = payload.data();
+  size_t len = payload.size();
+  uint32_t h = 0x811C9DC5u ^ static_cast<uint32_t>(len);
+  while (len >= 4) {
+    uint32_t word;
+    memcpy(&word, p, sizeof(word));
+    h = (h ^ word) * 0x01000193u;
+    h ^= h >> 15;
+    p += 4;
+    len -= 4;
+  }
+  while (len-- > 0)
+    h = (h ^ *p++) * 0x01000193u;
+  h ^= h >> 13;
+  h *= 0x5BD1E995u;
+  h ^= h >> 15;
+  return h;
+}
+
+class DuplicateCache {
+ public:
+  static constexpr size_t SIZE = 4;
+
+  /// Returns true if ``hash`` was seen less than ``window_ms`` ago. Otherwise
+  /// remembers it (replacing the oldest entry) and returns false.
+  bool check_and_insert(uint32_t hash, uint32_t now_ms, uint32_t window_ms) {
+    size_t victim = 0;
+    for (size_t i = 0; i < SIZE; i++) {
+      Entry &e = this->entries_[i];
+      if (!e.used) {
+        victim = i;
+        break;
+      }
+      if (e.hash == hash) {
+        bool duplicate = now_ms - e.seen_ms < window_ms;
+        if (!duplicate)
+          e.seen_ms = now_ms;
+        return duplicate;
+      }
+      if (now_ms - e.seen_ms > now_ms - this->entries_[victim].seen_ms)
+        victim = i;
+    }
+    this->entries_[victim] = {hash, now_ms, true};
+    return false;
+  }
+
+ protected:
+  struct Entry {
+    uint32_t hash{0};
+    uint32_t seen_ms{0};
+    bool used{false};
+  };
+  Entry entries_[SIZE];
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -1,8 +1,7 @@
 #pragma once
 
-#include <map>
-#include <string>
-#include <vector>
+#include "decoded_telegram.h"
+#include "telegram.h"
 
 namespace esphome {
 namespace wmbus_parser {
@@ -10,9 +9,12 @@ namespace evo868 {
 
 class Evo868Driver {
  public:
-  static bool decode(const std::vector<uint8_t> &raw,
-                     std::map<std::string, std::string> &attributes,
-                     float &main_value);
+  // Maddalena water meters with the Evo868 radio module
+  static constexpr HeaderMatch MATCHES[] = {
+      {manufacturer_field("MAD"), HEADER_ANY, DEVICE_TYPE_WATER},
+  };
+
+  static bool decode(const TelegramView &telegram, DecodedTelegram &result);
 };
 
 }  // namespace evo868
@@ -0,0 +1,76 @@
+#include "foreign_meters.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+void ForeignMeterTable::init(size_t capacity) {
+  this->entries_.reset(capacity > 0 ? new ForeignMeter[capacity] : nullptr);
+  this->capacity_ = capacity;
+  this->size_ = 0;
+  this->frames_ = this->evictions_ = 0;
+}
+
+void ForeignMeterTable::record(const TelegramView &telegram, uint32_t now_ms) {
+  if (this->capacity_ == 0)
+    return;
+  this->frames_++;
+  const uint32_t address = telegram.address();
+  const uint16_t manufacturer = telegram.manufacturer();
+  const uint8_t version = telegram.version();
+  const uint8_t device_type = telegram.device_type();
+
+  // A few dozen slots: a linear scan that also finds the eviction candidate
+  // is cheaper than keeping a hash index consistent across evictions.
+  ForeignMeter *entries = this->entries_.get();
+  ForeignMeter *least = nullptr;
+  for (size_t i = 0; i < this->size_; i++) {
+    ForeignMeter &entry = entries[i];
+    if (entry.address == address && entry.manufacturer == manufacturer && entry.version == version &&
+        entry.device_type == device_type) {
+      entry.hits++;
+      entry.last_seen_ms = now_ms;
+      return;
+    }
+    if (least == nullptr || entry.hits < least->hits)
+      least = &entry;
+  }
+
+  ForeignMeter *slot;
+  uint32_t inherited = 0;
+  if (this->size_ < this->capacity_) {
+    slot = &entries[this->size_++];
+  } else {
+    slot = least;
+    inherited = least->hits;
+    this->evictions_++;
+  }
+  slot->address = address;
+  slot->manufacturer = manufacturer;
+  slot->version = version;
+  slot->device_type = device_type;
+  slot->hits = inherited + 1;
+  slot->error = inherited;
+  slot->first_seen_ms = slot->last_seen_ms = now_ms;
+}
+
+size_t ForeignMeterTable::top(ForeignMeter *out, size_t max) const {
+  size_t count = 0;
+  for (const ForeignMeter &entry : *this) {
+    // Insertion into the sorted prefix of ``out``, dropping the smallest.
+    size_t pos = count < max ? count : max;
+    while (pos > 0 && out[pos - 1].hits < entry.hits) {
+      if (pos < max)
+        out[pos] = out[pos - 1];
+      pos--;
+    }
+    if (pos < max) {
+      out[pos] = entry;
+      if (count < max)
+        count++;
+    }
+  }
+  return count;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,63 @@
+/**
+ * Bounded table of meters heard on air that are not configured.
+ *
+ * At dense sites most received frames belong to other meters. Instead of
+ * logging each one, the parser counts them here per (manufacturer, ID,
+ * version, device type) and reports a summary now and then. The table has a
+ * fixed number of slots allocated once; when it is full, the entry with the
+ * fewest hits is replaced and the newcomer inherits its count (space-saving).
+ * Meters heard often therefore stay in the table while one-off receptions
+ * churn through the bottom slots, and ``hits - error`` is a lower bound of
+ * the true count.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+struct ForeignMeter {
+  uint32_t address{0};  // as TelegramView::address()
+  uint16_t manufacturer{0};
+  uint8_t version{0};
+  uint8_t device_type{0};
+  uint32_t hits{0};
+  uint32_t error{0};  // hits inherited from the evicted entry
+  uint32_t first_seen_ms{0};
+  uint32_t last_seen_ms{0};
+};
+
+class ForeignMeterTable {
+ public:
+  void init(size_t capacity);
+  bool is_enabled() const { return this->capacity_ > 0; }
+
+  /// Count a frame from an unknown meter; the telegram needs a full link header.
+  void record(const TelegramView &telegram, uint32_t now_ms);
+
+  size_t size() const { return this->size_; }
+  size_t capacity() const { return this->capacity_; }
+  const ForeignMeter *begin() const { return this->entries_.get(); }
+  const ForeignMeter *end() const { return this->entries_.get() + this->size_; }
+  /// Frames recorded since init(), including those of evicted entries.
+  uint32_t frames() const { return this->frames_; }
+  uint32_t evictions() const { return this->evictions_; }
+
+  /// Copy up to ``max`` entries with the most hits to ``out``, highest first.
+  size_t top(ForeignMeter *out, size_t max) const;
+
+ protected:
+  std::unique_ptr<ForeignMeter[]> entries_;
+  size_t capacity_{0};
+  size_t size_{0};
+  uint32_t frames_{0};
+  uint32_t evictions_{0};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,176 @@
+#include "frame_check.h"
+
+#include "crc16.h"
+#include "telegram.h"
+#include "three_of_six.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+FrameError strip_format_a(const uint8_t *p, size_t len, uint8_t *out, size_t &out_len) {
+  const uint8_t l_field = p[0];
+  if (l_field < FRAME_MIN_PAYLOAD - 1)
+    return FrameError::BAD_LENGTH;
+  if (len < format_a_size(l_field))
+    return FrameError::TRUNCATED;
+
+  if (!crc16_en13757_matches(p, FRAME_A_FIRST_BLOCK))
+    return FrameError::BAD_CRC;
+  memcpy(out, p, FRAME_A_FIRST_BLOCK);
+  size_t in_pos = FRAME_A_FIRST_BLOCK + 2;
+  size_t out_pos = FRAME_A_FIRST_BLOCK;
+  size_t remaining = 1 + l_field - FRAME_A_FIRST_BLOCK;
+  while (remaining > 0) {
+    size_t block = remaining < FRAME_A_BLOCK ? remaining : FRAME_A_BLOCK;
+    if (!crc16_en13757_matches(p + in_pos, block))
+      return FrameError::BAD_CRC;
+    memcpy(out + out_pos, p + in_pos, block);
+    in_pos += block + 2;
+    out_pos += block;
+    remaining -= block;
+  }
+  out_len = out_pos;
+  return FrameError::NONE;
+}
+
+FrameError strip_format_b(const uint8_t *p, size_t len, uint8_t *out, size_t &out_len) {
+  const size_t total = format_b_size(p[0]);
+  if (total == 0)
+    return FrameError::BAD_LENGTH;
+  if (len < total)
+    return FrameError::TRUNCATED;
+
+  if (total <= FRAME_B_FIRST_BLOCKS + 2) {
+    if (!crc16_en13757_matches(p, total - 2))
+      return FrameError::BAD_CRC;
+    memcpy(out, p, total - 2);
+    out_len = total - 2;
+    return FrameError::NONE;
+  }
+  const size_t last_block = total - FRAME_B_FIRST_BLOCKS - 4;
+  if (!crc16_en13757_matches(p, FRAME_B_FIRST_BLOCKS) ||
+      !crc16_en13757_matches(p + FRAME_B_FIRST_BLOCKS + 2, last_block))
+    return FrameError::BAD_CRC;
+  memcpy(out, p, FRAME_B_FIRST_BLOCKS);
+  memcpy(out + FRAME_B_FIRST_BLOCKS, p + FRAME_B_FIRST_BLOCKS + 2, last_block);
+  out_len = FRAME_B_FIRST_BLOCKS + last_block;
+  return FrameError::NONE;
+}
+
+}  // namespace
+
+size_t format_a_size(uint8_t l_field) {
+  if (l_field < FRAME_MIN_PAYLOAD - 1)
+    return 0;
+  size_t data = l_field - (FRAME_A_FIRST_BLOCK - 1);
+  size_t blocks = 1 + (data + FRAME_A_BLOCK - 1) / FRAME_A_BLOCK;
+  return 1 + l_field + 2 * blocks;
+}
+
+size_t format_b_size(uint8_t l_field) {
+  const size_t total = 1 + static_cast<size_t>(l_field);
+  // A block ending in a lone CRC (total 129 or 130) cannot be produced either.
+  if (total < FRAME_MIN_PAYLOAD + 2 || (total > FRAME_B_FIRST_BLOCKS + 2 && total <= FRAME_B_FIRST_BLOCKS + 4))
+    return 0;
+  return total;
+}
+
+const char *frame_error_to_string(FrameError error) {
+  switch (error) {
+    case FrameError::NONE:
+      return "ok";
+    case FrameError::TOO_SHORT:
+      return "too_short";
+    case FrameError::TRUNCATED:
+      return "truncated";
+    case FrameError::BAD_LENGTH:
+      return "bad_length";
+    case FrameError::BAD_CRC:
+      return "bad_crc";
+    case FrameError::BAD_SYMBOL:
+      return "bad_symbol";
+  }
+  return "unknown";
+}
+
+FrameError check_frame(const uint8_t *raw, size_t len, uint8_t *out, size_t &out_len, FrameFormat *format) {
+  FrameFormat detected = FrameFormat::UNKNOWN;
+  if (has_c1_header(raw, len)) {
+    detected = raw[1] == 0xCD ? FrameFormat::A : FrameFormat::B;
+    raw += 2;
+    len -= 2;
+  }
+  if (raw == nullptr || len < FRAME_MIN_PAYLOAD)
+    return FrameError::TOO_SHORT;
+
+  FrameError error;
+  if (detected == FrameFormat::A) {
+    error = strip_format_a(raw, len, out, out_len);
+  } else if (detected == FrameFormat::B) {
+    error = strip_format_b(raw, len, out, out_len);
+  } else {
+    // Without a sync prefix try the layout whose size matches exactly first.
+    bool a_first = len == format_a_size(raw[0]);
+    detected = a_first ? FrameFormat::A : FrameFormat::B;
+    error = a_first ? strip_format_a(raw, len, out, out_len) : strip_format_b(raw, len, out, out_len);
+    if (error != FrameError::NONE) {
+      FrameError other = a_first ? strip_format_b(raw, len, out, out_len) : strip_format_a(raw, len, out, out_len);
+      if (other == FrameError::NONE || other == FrameError::BAD_CRC || error != FrameError::BAD_CRC) {
+        detected = a_first ? FrameFormat::B : FrameFormat::A;
+        error = other;
+      }
+    }
+  }
+  if (error != FrameError::NONE)
+    return error;
+
+  out[TELEGRAM_L_FIELD] = static_cast<uint8_t>(out_len - 1);
+  if (format != nullptr)
+    *format = detected;
+  return FrameError::NONE;
+}
+
+FrameError check_t1_frame(const uint8_t *raw, size_t len, uint8_t *out, size_t &out_len) {
+  if (raw == nullptr || len < three_of_six_encoded_size(FRAME_MIN_PAYLOAD))
+    return FrameError::TOO_SHORT;
+  uint8_t l_field;
+  if (!decode_three_of_six(raw, 1, &l_field))
+    return FrameError::BAD_SYMBOL;
+  const size_t size = format_a_size(l_field);
+  if (size == 0)
+    return FrameError::BAD_LENGTH;
+  if (len < three_of_six_encoded_size(size))
+    return FrameError::TRUNCATED;
+
+  uint8_t frame[TELEGRAM_MAX_FRAME_SIZE];
+  if (!decode_three_of_six(raw, size, frame))
+    return FrameError::BAD_SYMBOL;
+  FrameError error = strip_format_a(frame, size, out, out_len);
+  if (error != FrameError::NONE)
+    return error;
+  out[TELEGRAM_L_FIELD] = static_cast<uint8_t>(out_len - 1);
+  return FrameError::NONE;
+}
+
+FrameError check_c1_or_t1_frame(const uint8_t *raw, size_t len, uint8_t *out, size_t &out_len, bool &t1) {
+  t1 = false;
+  if (has_c1_header(raw, len))
+    return check_frame(raw, len, out, out_len);
+  const FrameError t1_error = check_t1_frame(raw, len, out, out_len);
+  if (t1_error == FrameError::NONE) {
+    t1 = true;
+    return t1_error;
+  }
+  const FrameError c1_error = check_frame(raw, len, out, out_len);
+  if (c1_error == FrameError::NONE || t1_error == FrameError::BAD_SYMBOL || t1_error == FrameError::TOO_SHORT)
+    return c1_error;
+  t1 = true;
+  return t1_error;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
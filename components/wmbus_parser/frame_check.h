@@ -0,0 +1,72 @@
+/**
+ * Link-layer validation of received frames.
+ *
+ * check_frame() verifies the L-field and the EN 13757-4 block CRCs of a frame
+ * in format A or B and copies the link layer without the C1 sync prefix and
+ * without CRCs, so drivers only ever see clean payloads. The format is taken
+ * from the C1 prefix (0x54 0xCD = A, 0x54 0x3D = B) or, without a prefix,
+ * from whichever layout matches the L-field and the CRCs.
+ *
+ * T1 frames arrive 3-of-6 encoded and without a prefix; check_t1_frame()
+ * decodes them to format A first and then runs the same checks.
+ * check_c1_or_t1_frame() accepts both where a receiver hears both modes.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace wmbus_parser {
+
+enum class FrameError : uint8_t {
+  NONE = 0,
+  TOO_SHORT,   // not even a link header and CI-field
+  TRUNCATED,   // fewer bytes than the L-field announces
+  BAD_LENGTH,  // L-field that no block layout can produce
+  BAD_CRC,
+  BAD_SYMBOL,  // invalid 3-of-6 symbol in a T1 frame
+};
+
+enum class FrameFormat : uint8_t { UNKNOWN = 0, A, B };
+
+// Link header (L, C, M, A) plus CI-field; anything shorter cannot be decoded.
+static constexpr size_t FRAME_MIN_PAYLOAD = 11;
+// Largest link layer once the CRCs are removed (L = 255).
+static constexpr size_t FRAME_MAX_STRIPPED_SIZE = 256;
+// Largest 3-of-6 encoded T1 frame: format A with L = 255 is 290 bytes.
+static constexpr size_t FRAME_MAX_T1_SIZE = 435;
+
+// Format A: a 10 byte first block, then blocks of 16 data bytes, each
+// followed by its CRC. The L-field does not count the CRCs.
+static constexpr size_t FRAME_A_FIRST_BLOCK = 10;
+static constexpr size_t FRAME_A_BLOCK = 16;
+// Format B: one CRC after the first 126 bytes (L-field included) and one at
+// the end. The L-field counts the CRCs.
+static constexpr size_t FRAME_B_FIRST_BLOCKS = 126;
+
+/// Size of a frame with this L-field, CRCs included and without a prefix, or
+/// 0 if the format cannot produce it.
+size_t format_a_size(uint8_t l_field);
+size_t format_b_size(uint8_t l_field);
+
+const char *frame_error_to_string(FrameError error);
+
+/// Validate ``raw`` and copy the link layer without CRCs to ``out`` (at least
+/// FRAME_MAX_STRIPPED_SIZE bytes). The L-field of the copy is rewritten to the
+/// stripped length. Bytes after the announced frame length are ignored.
+FrameError check_frame(const uint8_t *raw, size_t len, uint8_t *out, size_t &out_len,
+                       FrameFormat *format = nullptr);
+
+/// As check_frame() for a 3-of-6 encoded T1 frame, which is always format A.
+/// The L-field is decoded first, so noise is rejected after two bytes.
+FrameError check_t1_frame(const uint8_t *raw, size_t len, uint8_t *out, size_t &out_len);
+
+/// Frames with a C1 prefix go to check_frame(), anything else is tried as T1
+/// first and as a C1 frame whose prefix the radio removed second. ``t1`` tells
+/// which one the result belongs to; a rejected frame is reported as T1 only
+/// if all of its symbols were valid.
+FrameError check_c1_or_t1_frame(const uint8_t *raw, size_t len, uint8_t *out, size_t &out_len, bool &t1);
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,296 @@
+#include "frame_stream.h"
+
+#include "crc16.h"
+#include "three_of_six.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+constexpr uint8_t C1_SYNC = 0x54;
+// Raw bytes looked at before a frame without prefix is taken for T1: eight
+// symbols, which random C1 bytes form once in 65536 frames.
+constexpr size_t T1_PROBE_SIZE = 6;
+
+}  // namespace
+
+void FrameStream::reset() {
+  this->raw_len_ = 0;
+  this->payload_len_ = 0;
+  this->t1_pos_ = 0;
+  this->link_pos_ = 0;
+  this->link_size_ = 0;
+  this->data_size_ = 0;
+  this->block_left_ = 0;
+  this->crc_left_ = 0;
+  this->crc_ = 0;
+  this->state_ = State::START;
+  this->layout_ = Layout::UNKNOWN;
+  this->b_open_ = false;
+  this->error_ = FrameError::NONE;
+  this->c1_header_ = false;
+  this->t1_ = false;
+  this->header_reported_ = false;
+  this->header_checked_ = false;
+}
+
+size_t FrameStream::feed(const uint8_t *data, size_t len, Event &event) {
+  event = Event::NONE;
+  size_t used = 0;
+  // The L-field ends the frame before raw_ can fill up: 292 bytes for C1, 435
+  // for T1.
+  while (used < len && this->state_ != State::DONE) {
+    if (this->state_ == State::BODY && !this->t1_ && this->block_left_ > 0 && this->link_pos_ > 0) {
+      used += this->push_data_(data + used, len - used, event);
+      if (event != Event::NONE)
+        return used;
+      continue;
+    }
+    const uint8_t byte = data[used++];
+    this->raw_[this->raw_len_++] = byte;
+    switch (this->state_) {
+      case State::START:
+        if (byte == C1_SYNC) {
+          this->state_ = State::PREFIX;
+        } else {
+          event = this->start_body_();
+        }
+        break;
+      case State::PREFIX:
+        if (byte == 0xCD || byte == 0x3D) {
+          this->c1_header_ = true;
+          this->layout_ = byte == 0xCD ? Layout::A : Layout::B;
+          this->state_ = State::BODY;
+        } else {
+          event = this->start_body_();
+        }
+        break;
+      case State::T1_PROBE:
+        if (this->raw_len_ == T1_PROBE_SIZE)
+          event = this->start_body_();
+        break;
+      case State::BODY:
+        event = this->t1_ ? this->decode_t1_() : this->push_link_(byte);
+        break;
+      case State::DONE:
+        break;
+    }
+    if (event != Event::NONE)
+      return used;
+  }
+  return len;
+}
+
+// Called once the bytes in raw_ are known not to be a C1 prefix.
+FrameStream::Event FrameStream::start_body_() {
+  if (this->t1_enabled_ && this->state_ != State::T1_PROBE) {
+    this->state_ = State::T1_PROBE;
+    return Event::NONE;
+  }
+  uint8_t probe[T1_PROBE_SIZE * 2 / 3];
+  this->t1_ = this->state_ == State::T1_PROBE && decode_three_of_six(this->raw_, sizeof(probe), probe);
+  this->state_ = State::BODY;
+  if (this->t1_) {
+    this->layout_ = Layout::A;
+    return this->decode_t1_();
+  }
+  for (size_t i = 0; i < this->raw_len_; i++) {
+    const Event event = this->push_link_(this->raw_[i]);
+    if (event != Event::NONE)
+      return event;
+  }
+  return Event::NONE;
+}
+
+// Three raw bytes give two link bytes; the last byte of an odd-sized frame
+// comes in two.
+FrameStream::Event FrameStream::decode_t1_() {
+  for (;;) {
+    const size_t pending = this->raw_len_ - this->t1_pos_;
+    size_t count = 0;
+    if (pending >= 3) {
+      count = 2;
+    } else if (pending == 2 && this->link_size_ != 0 && this->link_size_ - this->link_pos_ == 1) {
+      count = 1;
+    }
+    if (count == 0)
+      return Event::NONE;
+    uint8_t decoded[2];
+    if (!decode_three_of_six(this->raw_ + this->t1_pos_, count, decoded))
+      return this->fail_(FrameError::BAD_SYMBOL);
+    this->t1_pos_ += three_of_six_encoded_size(count);
+    for (size_t i = 0; i < count; i++) {
+      const Event event = this->push_link_(decoded[i]);
+      if (event != Event::NONE)
+        return event;
+    }
+  }
+}
+
+FrameStream::Event FrameStream::push_link_(uint8_t byte) {
+  if (this->link_pos_++ == 0) {
+    const Event event = this->start_frame_(byte);
+    if (event != Event::NONE)
+      return event;
+  }
+  const Event event = this->push_block_(byte);
+  if (event == Event::NONE && this->b_open_ && this->link_pos_ == format_b_size(this->l_field_))
+    return this->close_format_b_();
+  return event;
+}
+
+FrameStream::Event FrameStream::push_block_(uint8_t byte) {
+  if (this->block_left_ > 0) {
+    this->payload_[this->payload_len_++] = byte;
+    this->crc_ = crc16_en13757_update(this->crc_, byte);
+    if (--this->block_left_ == 0)
+      this->crc_left_ = 2;
+    if (!this->header_reported_ && this->layout_ == Layout::B && this->payload_len_ == TELEGRAM_CI_FIELD)
+      return this->report_header_(false);
+    return Event::NONE;
+  }
+  this->crc_bytes_[2 - this->crc_left_] = byte;
+  if (--this->crc_left_ > 0)
+    return Event::NONE;
+  return this->end_block_();
+}
+
+// The data bytes of a C1 block in one go; stops at the end of the link
+// header so it can be reported in format B.
+size_t FrameStream::push_data_(const uint8_t *data, size_t len, Event &event) {
+  size_t count = std::min(this->block_left_, len);
+  if (!this->header_reported_ && this->payload_len_ < TELEGRAM_CI_FIELD)
+    count = std::min(count, TELEGRAM_CI_FIELD - this->payload_len_);
+  if (this->b_open_)
+    count = std::min(count, format_b_size(this->l_field_) - this->link_pos_);
+  std::memcpy(this->raw_ + this->raw_len_, data, count);
+  std::memcpy(this->payload_ + this->payload_len_, data, count);
+  uint16_t crc = this->crc_;
+  for (size_t i = 0; i < count; i++)
+    crc = crc16_en13757_update(crc, data[i]);
+  this->crc_ = crc;
+  this->raw_len_ += count;
+  this->link_pos_ += count;
+  this->payload_len_ += count;
+  this->block_left_ -= count;
+  if (this->block_left_ == 0)
+    this->crc_left_ = 2;
+  if (!this->header_reported_ && this->layout_ == Layout::B && this->payload_len_ == TELEGRAM_CI_FIELD) {
+    event = this->report_header_(false);
+  } else if (this->b_open_ && this->link_pos_ == format_b_size(this->l_field_)) {
+    event = this->close_format_b_();
+  }
+  return count;
+}
+
+FrameStream::Event FrameStream::start_frame_(uint8_t l_field) {
+  const size_t a_size = this->layout_ != Layout::B ? format_a_size(l_field) : 0;
+  const size_t b_size = this->layout_ != Layout::A ? format_b_size(l_field) : 0;
+  if (a_size == 0 && b_size == 0)
+    return this->fail_(FrameError::BAD_LENGTH);
+  this->l_field_ = l_field;
+  if (a_size == 0) {
+    this->start_format_b_();
+    return Event::NONE;
+  }
+  // Format A, or either format until the first block CRC tells them apart.
+  if (b_size == 0)
+    this->layout_ = Layout::A;
+  this->link_size_ = a_size;
+  this->data_size_ = 1 + static_cast<size_t>(l_field);
+  this->block_left_ = FRAME_A_FIRST_BLOCK;
+  return Event::NONE;
+}
+
+void FrameStream::start_format_b_() {
+  const size_t total = format_b_size(this->l_field_);
+  const bool single_block = total <= FRAME_B_FIRST_BLOCKS + 2;
+  this->layout_ = Layout::B;
+  this->link_size_ = total;
+  this->data_size_ = single_block ? total - 2 : total - 4;
+  this->block_left_ = (single_block ? total - 2 : FRAME_B_FIRST_BLOCKS) - this->payload_len_;
+}
+
+FrameStream::Event FrameStream::end_block_() {
+  const uint16_t crc = static_cast<uint16_t>(~this->crc_);
+  const bool match =
+      this->crc_bytes_[0] == static_cast<uint8_t>(crc >> 8) && this->crc_bytes_[1] == static_cast<uint8_t>(crc);
+  if (this->layout_ == Layout::UNKNOWN && !match) {
+    // No CRC after the first ten bytes: format B, and the two bytes were
+    // data (or, for the shortest frames, data and the first CRC byte).
+    const uint8_t held[2] = {this->crc_bytes_[0], this->crc_bytes_[1]};
+    this->start_format_b_();
+    this->push_block_(held[0]);
+    this->push_block_(held[1]);
+    return this->report_header_(false);
+  }
+  if (!match)
+    return this->b_open_ ? this->restart_format_b_() : this->fail_(FrameError::BAD_CRC);
+
+  this->crc_ = 0;
+  const size_t left = this->data_size_ - this->payload_len_;
+  if (left == 0) {
+    this->payload_[TELEGRAM_L_FIELD] = static_cast<uint8_t>(this->payload_len_ - 1);
+    this->state_ = State::DONE;
+    return Event::FRAME;
+  }
+  this->block_left_ = this->layout_ != Layout::B && left > FRAME_A_BLOCK ? FRAME_A_BLOCK : left;
+  if (this->layout_ == Layout::UNKNOWN) {
+    // Format A so far, but the two bytes may be data of a format B frame
+    // that happen to match. Its own CRCs decide once its last byte is in.
+    this->layout_ = Layout::A;
+    this->b_open_ = true;
+  }
+  // In format A the first block is the link header, now checked.
+  return this->header_reported_ ? Event::NONE : this->report_header_(true);
+}
+
+// The link bytes so far are a whole format B frame; if its CRCs match it
+// is one, as check_frame() tries format B first unless the buffer has the
+// exact format A size.
+FrameStream::Event FrameStream::close_format_b_() {
+  this->b_open_ = false;
+  const size_t total = this->link_pos_;
+  const bool valid = total <= FRAME_B_FIRST_BLOCKS + 2
+                         ? crc16_en13757_matches(this->raw_, total - 2)
+                         : crc16_en13757_matches(this->raw_, FRAME_B_FIRST_BLOCKS) &&
+                               crc16_en13757_matches(this->raw_ + FRAME_B_FIRST_BLOCKS + 2,
+                                                     total - FRAME_B_FIRST_BLOCKS - 4);
+  return valid ? this->restart_format_b_() : Event::NONE;
+}
+
+// Drop the format A reading and run the link bytes so far through the
+// format B blocks. Only frames without prefix get here, so raw_ holds
+// exactly the link bytes.
+FrameStream::Event FrameStream::restart_format_b_() {
+  this->b_open_ = false;
+  this->payload_len_ = 0;
+  this->crc_ = 0;
+  this->crc_left_ = 0;
+  this->start_format_b_();
+  for (size_t i = 0; i < this->link_pos_; i++) {
+    const Event event = this->push_block_(this->raw_[i]);
+    if (event != Event::NONE)
+      return event;
+  }
+  return Event::NONE;
+}
+
+FrameStream::Event FrameStream::report_header_(bool checked) {
+  this->header_reported_ = true;
+  this->header_checked_ = checked;
+  return Event::HEADER;
+}
+
+FrameStream::Event FrameStream::fail_(FrameError error) {
+  this->error_ = error;
+  this->state_ = State::DONE;
+  return Event::ERROR;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,112 @@
+/**
+ * Incremental link-layer deframer for frames read from the radio FIFO.
+ *
+ * receive_packet() needs the whole frame before it can look at it, so the
+ * radio has to wait for, and buffer, its maximum payload length. FrameStream
+ * takes the bytes as they arrive instead: the L-field gives the real frame
+ * length, every block CRC is checked as soon as the block is in, and the link
+ * header is reported early so frames from foreign meters can be dropped while
+ * they are still on air: in format A once the first block CRC passed, in
+ * format B after ten bytes, before its CRC 116 bytes later. The CRCs are stripped on the way, so
+ * a complete frame needs no second pass.
+ *
+ * It accepts the frames check_frame() accepts (check_c1_or_t1_frame() with
+ * T1 enabled). Without a C1 prefix the format is told apart by the block
+ * CRCs: a frame whose first ten bytes pass the format A CRC is read as
+ * format A, and taken as format B instead if the bytes up to the end of a
+ * format B frame of that length pass its CRCs, as check_frame() does with
+ * radio padding after the frame. Only a frame valid in both layouts and
+ * handed to check_frame() at exactly the format A size comes out
+ * differently. T1 is told apart by the first eight 3-of-6 symbols.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "frame_check.h"
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+class FrameStream {
+ public:
+  enum class Event : uint8_t {
+    NONE = 0,  // all bytes used, the frame is not finished
+    HEADER,    // the link header (L-field to device type) is in, see payload() and header_checked()
+    FRAME,     // the frame is complete and valid, see payload()
+    ERROR,     // the frame was rejected, see error()
+  };
+
+  /// Also accept 3-of-6 encoded T1 frames when there is no C1 prefix.
+  void set_t1(bool enabled) { this->t1_enabled_ = enabled; }
+
+  /// Start over for the next frame.
+  void reset();
+  /// Consume bytes up to the next event and return how many were used. Once
+  /// the frame is finished, further bytes (radio padding) are used up without
+  /// effect until reset().
+  size_t feed(const uint8_t *data, size_t len, Event &event);
+  /// Ignore the rest of the current frame.
+  void drop() { this->state_ = State::DONE; }
+
+  bool started() const { return this->raw_len_ > 0; }
+  bool finished() const { return this->state_ == State::DONE; }
+  bool has_c1_header() const { return this->c1_header_; }
+  bool is_t1() const { return this->t1_; }
+  /// Whether a block CRC covered the link header when HEADER was reported;
+  /// false for format B, whose first CRC comes much later.
+  bool header_checked() const { return this->header_checked_; }
+  FrameError error() const { return this->error_; }
+
+  /// Link layer received so far, without prefix and CRCs. After FRAME the
+  /// L-field is rewritten to the stripped length, as check_frame() does.
+  TelegramView payload() const { return TelegramView(this->payload_, this->payload_len_); }
+  /// The frame as received, up to its last byte.
+  const uint8_t *raw() const { return this->raw_; }
+  size_t raw_size() const { return this->raw_len_; }
+
+ protected:
+  enum class State : uint8_t { START, PREFIX, T1_PROBE, BODY, DONE };
+  enum class Layout : uint8_t { UNKNOWN, A, B };
+
+  Event start_body_();
+  Event decode_t1_();
+  Event push_link_(uint8_t byte);
+  Event push_block_(uint8_t byte);
+  size_t push_data_(const uint8_t *data, size_t len, Event &event);
+  Event start_frame_(uint8_t l_field);
+  void start_format_b_();
+  Event end_block_();
+  Event close_format_b_();
+  Event restart_format_b_();
+  Event report_header_(bool checked);
+  Event fail_(FrameError error);
+
+  uint8_t raw_[FRAME_MAX_T1_SIZE];
+  uint8_t payload_[FRAME_MAX_STRIPPED_SIZE];
+  size_t raw_len_{0};
+  size_t payload_len_{0};
+  size_t t1_pos_{0};       // first raw byte not yet 3-of-6 decoded
+  size_t link_pos_{0};     // link-layer bytes (CRCs included) seen
+  size_t link_size_{0};    // link-layer bytes the L-field announces
+  size_t data_size_{0};    // payload bytes the L-field announces
+  size_t block_left_{0};   // data bytes left in the current block
+  uint8_t crc_left_{0};    // CRC bytes left of the current block
+  uint16_t crc_{0};
+  uint8_t crc_bytes_[2]{};
+  uint8_t l_field_{0};
+  State state_{State::START};
+  Layout layout_{Layout::UNKNOWN};
+  bool b_open_{false};  // read as format A, format B not yet ruled out
+  FrameError error_{FrameError::NONE};
+  bool c1_header_{false};
+  bool t1_{false};
+  bool t1_enabled_{false};
+  bool header_reported_{false};
+  bool header_checked_{false};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
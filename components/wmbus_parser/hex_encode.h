@@ -0,0 +1,43 @@
+/**
+ * Table-driven hex encoding for raw telegram dumps.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace hex_detail {
+
+constexpr std::array<char, 512> make_hex_table() {
+  std::array<char, 512> table{};
+  constexpr char digits[] = "0123456789ABCDEF";
+  for (size_t i = 0; i < 256; i++) {
+    table[2 * i] = digits[i >> 4];
+    table[2 * i + 1] = digits[i & 0x0F];
+  }
+  return table;
+}
+
+}  // namespace hex_detail
+
+// Two uppercase hex characters per byte value.
+static constexpr std::array<char, 512> HEX_PAIRS = hex_detail::make_hex_table();
+
+/// Write ``len`` bytes as uppercase hex plus a terminating NUL. ``out`` must
+/// hold 2 * len + 1 characters. Returns the number of characters written.
+inline size_t hex_encode(const uint8_t *data, size_t len, char *out) {
+  for (size_t i = 0; i < len; i++) {
+    const char *pair = &HEX_PAIRS[2 * data[i]];
+    out[2 * i] = pair[0];
+    out[2 * i + 1] = pair[1];
+  }
+  out[2 * len] = '\0';
+  return 2 * len;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
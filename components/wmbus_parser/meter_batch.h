@@ -0,0 +1,55 @@
+/**
+ * Payload of the on_batch trigger.
+ *
+ * When a publish interval is configured, the parser keeps only the newest
+ * telegram of every meter and hands them to on_batch together, so the number
+ * of network writes depends on the interval rather than on how many meters
+ * transmit. A MeterBatch is a view over parser-owned state: it is cheap to
+ * copy but only valid while the trigger runs.
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "arena.h"
+#include "decoded_telegram.h"
+#include "meter_index.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+struct BatchEntry {
+  uint32_t address;  // packed meter ID, see format_meter_id()
+  const DecodedTelegram *telegram;
+};
+
+class MeterBatch {
+ public:
+  MeterBatch() = default;
+  MeterBatch(const BatchEntry *entries, size_t count, TelegramArena *arena)
+      : entries_(entries), count_(count), arena_(arena) {}
+
+  size_t size() const { return this->count_; }
+  bool empty() const { return this->count_ == 0; }
+  const BatchEntry *begin() const { return this->entries_; }
+  const BatchEntry *end() const { return this->entries_ + this->count_; }
+
+  std::string meter_id(size_t index) const {
+    char id[9];
+    format_meter_id(this->entries_[index].address, id);
+    return id;
+  }
+  const DecodedTelegram &telegram(size_t index) const { return *this->entries_[index].telegram; }
+  float total_m3(size_t index) const { return this->entries_[index].telegram->total_m3; }
+  // Formatted lazily into the parser arena, which is reset after the trigger.
+  AttributeList attributes(size_t index) const { return AttributeList(*this->entries_[index].telegram, this->arena_); }
+
+ protected:
+  const BatchEntry *entries_{nullptr};
+  size_t count_{0};
+  TelegramArena *arena_{nullptr};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,118 @@
+/**
+ * Open-addressing index from packed meter address to meter slot.
+ *
+ * Configured meter IDs are parsed once into the 32-bit value carried in the
+ * telegram address field, so routing a packet is a multiply, a mask and a
+ * short probe sequence. Unknown addresses are rejected without allocating or
+ * formatting anything.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace wmbus_parser {
+
+/// Parse an 8 digit hexadecimal meter ID ("23123046") into the value read
+/// little-endian from the telegram address field.
+inline bool parse_meter_id(const std::string &text, uint32_t &out) {
+  if (text.size() != 8)
+    return false;
+  uint32_t value = 0;
+  for (char c : text) {
+    uint32_t nibble;
+    if (c >= '0' && c <= '9') {
+      nibble = c - '0';
+    } else if (c >= 'A' && c <= 'F') {
+      nibble = c - 'A' + 10;
+    } else if (c >= 'a' && c <= 'f') {
+      nibble = c - 'a' + 10;
+    } else {
+      return false;
+    }
+    value = (value << 4) | nibble;
+  }
+  out = value;
+  return true;
+}
+
+/// Inverse of parse_meter_id: eight uppercase hex digits and a NUL.
+inline void format_meter_id(uint32_t address, char out[9]) {
+  static const char DIGITS[] = "0123456789ABCDEF";
+  for (int i = 7; i >= 0; i--) {
+    out[i] = DIGITS[address & 0xF];
+    address >>= 4;
+  }
+  out[8] = '\0';
+}
+
+class MeterIndex {
+ public:
+  static constexpr uint16_t NOT_FOUND = 0xFFFF;
+
+  /// Map ``address`` to ``slot``; an existing entry for the address is replaced.
+  void insert(uint32_t address, uint16_t slot) {
+    if ((this->count_ + 1) * 2 > this->slots_.size())
+      this->grow_();
+    if (this->insert_(address, slot))
+      this->count_++;
+  }
+
+  uint16_t find(uint32_t address) const {
+    if (this->slots_.empty())
+      return NOT_FOUND;
+    size_t mask = this->slots_.size() - 1;
+    for (size_t i = hash(address) & mask;; i = (i + 1) & mask) {
+      const Entry &e = this->slots_[i];
+      if (e.slot == NOT_FOUND)
+        return NOT_FOUND;
+      if (e.address == address)
+        return e.slot;
+    }
+  }
+
+  size_t size() const { return this->count_; }
+
+ protected:
+  struct Entry {
+    uint32_t address{0};
+    uint16_t slot{NOT_FOUND};
+  };
+
+  static size_t hash(uint32_t address) { return static_cast<size_t>((address * 0x9E3779B1u) >> 7); }
+
+  bool insert_(uint32_t address, uint16_t slot) {
+    size_t mask = this->slots_.size() - 1;
+    for (size_t i = hash(address) & mask;; i = (i + 1) & mask) {
+      Entry &e = this->slots_[i];
+      if (e.slot == NOT_FOUND) {
+        e.address = address;
+        e.slot = slot;
+        return true;
+      }
+      if (e.address == address) {
+        e.slot = slot;
+        return false;
+      }
+    }
+  }
+
+  void grow_() {
+    std::vector<Entry> old;
+    old.swap(this->slots_);
+    this->slots_.resize(old.empty() ? 8 : old.size() * 2);
+    for (const Entry &e : old) {
+      if (e.slot != NOT_FOUND)
+        this->insert_(e.address, e.slot);
+    }
+  }
+
+  std::vector<Entry> slots_;
+  size_t count_{0};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
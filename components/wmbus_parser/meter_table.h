@@ -0,0 +1,127 @@
+/**
+ * Configured meters, stored column-wise in WMBusParser.
+ *
+ * A meter is a slot number. The receive path only touches the address,
+ * driver, cipher and duplicate columns of one slot; sensors and throttling
+ * are read when a telegram is published. The full last and pending
+ * telegrams are only kept when on_change or the publish scheduler needs
+ * them, and the reading history only with history_size, so a plain meter
+ * costs about a hundred bytes.
+ *
+ * Meters found by auto-detect are appended while frames are being decoded.
+ * WMBusParser::setup() reserves room for them in every column, so appending
+ * never moves the slots the decode task is reading.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "aes128.h"
+#include "decoded_telegram.h"
+#include "duplicate_cache.h"
+#include "metrics.h"
+#include "reading_history.h"
+
+namespace esphome {
+namespace sensor {
+class Sensor;
+}  // namespace sensor
+
+namespace wmbus_parser {
+
+// Per-meter limits on total_m3 sensor updates and the last published state.
+struct SensorThrottle {
+  uint32_t min_interval_ms{0};
+  float threshold{0.0f};
+  float value{0.0f};
+  uint32_t published_ms{0};
+};
+
+struct MeterTable {
+  static constexpr uint8_t FLAG_HAS_LAST = 1 << 0;
+  static constexpr uint8_t FLAG_HAS_PENDING = 1 << 1;
+  static constexpr uint8_t FLAG_SENSOR_PUBLISHED = 1 << 2;
+  static constexpr uint8_t FLAG_AUTO_DETECTED = 1 << 3;  // added by a wildcard manufacturer
+  // Driver column values besides driver table indices
+  static constexpr uint8_t DRIVER_AUTO = 0xFF;  // picked from the first telegram
+  static constexpr uint8_t DRIVER_NONE = 0xFE;  // auto, and no built-in driver matched
+
+  size_t size() const { return this->address.size(); }
+
+  void reserve(size_t count) {
+    this->address.reserve(count);
+    this->driver.reserve(count);
+    this->flags.reserve(count);
+    this->total_m3_sensor.reserve(count);
+    this->last_seen_sensor.reserve(count);
+    this->cipher.reserve(count);
+    this->duplicates.reserve(count);
+    this->stats.reserve(count);
+    this->throttle.reserve(count);
+    if (this->has_last_)
+      this->last.reserve(count);
+    if (this->has_pending_)
+      this->pending.reserve(count);
+    if (this->has_history_)
+      this->history.reserve(count);
+  }
+
+  uint16_t add(uint32_t meter_address, uint8_t driver_index) {
+    this->address.push_back(meter_address);
+    this->driver.push_back(driver_index);
+    this->flags.push_back(0);
+    this->total_m3_sensor.push_back(nullptr);
+    this->last_seen_sensor.push_back(nullptr);
+    this->cipher.emplace_back();
+    this->duplicates.emplace_back();
+    this->stats.emplace_back();
+    this->throttle.emplace_back();
+    if (this->has_last_)
+      this->last.emplace_back();
+    if (this->has_pending_)
+      this->pending.emplace_back();
+    if (this->has_history_)
+      this->history.emplace_back();
+    return static_cast<uint16_t>(this->size() - 1);
+  }
+
+  // Optional columns, sized once the features that need them are known.
+  void keep_last() {
+    this->has_last_ = true;
+    this->last.resize(this->size());
+  }
+  void keep_pending() {
+    this->has_pending_ = true;
+    this->pending.resize(this->size());
+  }
+  void keep_history() {
+    this->has_history_ = true;
+    this->history.resize(this->size());
+  }
+  bool has_last_column() const { return this->has_last_; }
+  bool has_history_column() const { return this->has_history_; }
+
+  std::vector<uint32_t> address;  // packed meter ID, as TelegramView::address()
+  std::vector<uint8_t> driver;    // index into the driver table
+  std::vector<uint8_t> flags;
+  std::vector<sensor::Sensor *> total_m3_sensor;
+  std::vector<sensor::Sensor *> last_seen_sensor;
+  std::vector<std::unique_ptr<Aes128>> cipher;  // only meters with a key
+  std::vector<DuplicateCache> duplicates;
+  std::vector<MeterStats> stats;
+  std::vector<SensorThrottle> throttle;
+  std::vector<DecodedTelegram> last;     // with on_change
+  std::vector<DecodedTelegram> pending;  // with publish_interval
+  std::vector<ReadingHistory> history;   // with history_size
+
+ protected:
+  bool has_last_{false};
+  bool has_pending_{false};
+  bool has_history_{false};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,140 @@
+#include "metrics.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+// Up to 10 ms for the stages themselves, then the range of queue waits and
+// main-loop latency.
+constexpr uint32_t BUCKET_LIMITS_US[LatencyHistogram::BUCKET_COUNT - 1] = {
+    25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};
+
+}  // namespace
+
+const char *failure_reason_to_string(FailureReason reason) {
+  switch (reason) {
+    case FailureReason::OVERSIZED:
+      return "oversized";
+    case FailureReason::TOO_SHORT:
+      return "too_short";
+    case FailureReason::BAD_LENGTH:
+      return "bad_length";
+    case FailureReason::BAD_CRC:
+      return "bad_crc";
+    case FailureReason::BAD_SYMBOL:
+      return "bad_symbol";
+    case FailureReason::NO_KEY:
+      return "no_key";
+    case FailureReason::BAD_KEY:
+      return "bad_key";
+    case FailureReason::UNSUPPORTED_MODE:
+      return "unsupported_mode";
+    case FailureReason::DRIVER:
+      return "driver";
+    case FailureReason::NO_DRIVER:
+      return "no_driver";
+    default:
+      return "unknown";
+  }
+}
+
+const char *trace_stage_to_string(TraceStage stage) {
+  switch (stage) {
+    case TraceStage::LINK_CHECK:
+      return "link_check";
+    case TraceStage::ID_LOOKUP:
+      return "id_lookup";
+    case TraceStage::QUEUE:
+      return "queue";
+    case TraceStage::DEDUPE:
+      return "dedupe";
+    case TraceStage::DECODE:
+      return "decode";
+    case TraceStage::PUBLISH:
+      return "publish";
+    default:
+      return "unknown";
+  }
+}
+
+FailureReason failure_reason_from(FrameError error) {
+  switch (error) {
+    case FrameError::TOO_SHORT:
+      return FailureReason::TOO_SHORT;
+    case FrameError::BAD_CRC:
+      return FailureReason::BAD_CRC;
+    case FrameError::BAD_SYMBOL:
+      return FailureReason::BAD_SYMBOL;
+    default:
+      return FailureReason::BAD_LENGTH;
+  }
+}
+
+FailureReason failure_reason_from(DecryptResult result) {
+  switch (result) {
+    case DecryptResult::NO_KEY:
+      return FailureReason::NO_KEY;
+    case DecryptResult::BAD_KEY:
+      return FailureReason::BAD_KEY;
+    case DecryptResult::UNSUPPORTED_MODE:
+      return FailureReason::UNSUPPORTED_MODE;
+    default:
+      return FailureReason::BAD_LENGTH;
+  }
+}
+
+uint32_t LatencyHistogram::bucket_limit_us(size_t index) {
+  return index < BUCKET_COUNT - 1 ? BUCKET_LIMITS_US[index] : UINT32_MAX;
+}
+
+void LatencyHistogram::record(uint32_t us) {
+  size_t index = 0;
+  while (index < BUCKET_COUNT - 1 && us > BUCKET_LIMITS_US[index])
+    index++;
+  this->buckets_[index]++;
+  this->count_++;
+  this->total_us_ += us;
+  if (us > this->max_us_)
+    this->max_us_ = us;
+}
+
+uint32_t LatencyHistogram::percentile_us(float fraction) const {
+  if (this->count_ == 0)
+    return 0;
+  // Rank of the sample, rounded up so that fraction 1.0 is the last one.
+  auto rank = static_cast<uint32_t>(fraction * static_cast<float>(this->count_) + 0.999f);
+  if (rank == 0)
+    rank = 1;
+  uint32_t seen = 0;
+  for (size_t i = 0; i < BUCKET_COUNT - 1; i++) {
+    seen += this->buckets_[i];
+    if (seen >= rank)
+      return BUCKET_LIMITS_US[i];
+  }
+  return this->max_us_;
+}
+
+LatencyHistogram LatencyHistogram::since(const LatencyHistogram &earlier) const {
+  LatencyHistogram diff;
+  for (size_t i = 0; i < BUCKET_COUNT; i++)
+    diff.buckets_[i] = this->buckets_[i] - earlier.buckets_[i];
+  diff.count_ = this->count_ - earlier.count_;
+  diff.total_us_ = this->total_us_ - earlier.total_us_;
+  diff.max_us_ = this->max_us_;
+  return diff;
+}
+
+void ParserMetrics::record_decode(TelegramTrace &trace) {
+  if (trace.has_decode_time)
+    this->decode_time.record(trace.decode_us);
+  for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+    if (trace.unrecorded_stages & (1u << i))
+      this->stage_time[i].record(trace.stage_us[i]);
+  }
+  trace.has_decode_time = false;
+  trace.unrecorded_stages = 0;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
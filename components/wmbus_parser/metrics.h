@@ -0,0 +1,229 @@
+/**
+ * Counters and decode timings of the parser and its meters.
+ *
+ * Link-layer and unknown-ID counters are updated by receive_packet, decode
+ * counters by whichever context runs the decode (the decode worker or
+ * loop()). Counters the decode writes are relaxed atomics, so loop() can copy
+ * them while the worker runs; a copy may be a few telegrams behind and its
+ * counters need not agree with each other.
+ *
+ * Stage timings follow a telegram from the radio to its publication: each
+ * frame carries a TelegramTrace that every stage stamps in passing. The
+ * histograms are only written from loop(): the decode leaves its timings in
+ * the trace, which comes back through the result queue to be recorded.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "frame_check.h"
+#include "receive_info.h"
+#include "telegram_crypto.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+enum class FailureReason : uint8_t {
+  OVERSIZED = 0,     // longer than the largest C1 or T1 frame
+  TOO_SHORT,
+  BAD_LENGTH,        // L-field or configuration word inconsistent with the frame
+  BAD_CRC,
+  BAD_SYMBOL,        // invalid 3-of-6 symbol in a T1 frame
+  NO_KEY,            // encrypted telegram for a meter without key
+  BAD_KEY,
+  UNSUPPORTED_MODE,  // security mode other than 0 and 5
+  DRIVER,            // the driver rejected the payload
+  NO_DRIVER,         // driver "auto" and no built-in driver reads the meter's telegrams
+  COUNT,
+};
+
+inline constexpr size_t FAILURE_REASON_COUNT = static_cast<size_t>(FailureReason::COUNT);
+
+const char *failure_reason_to_string(FailureReason reason);
+FailureReason failure_reason_from(FrameError error);
+FailureReason failure_reason_from(DecryptResult result);
+
+/// A counter or timestamp shared with the decode worker. Loads and stores
+/// are relaxed: they are never torn, but order nothing else.
+template<typename T> class RelaxedAtomic {
+ public:
+  constexpr RelaxedAtomic(T value = T()) : value_(value) {}
+  RelaxedAtomic(const RelaxedAtomic &other) : value_(other.load()) {}
+  RelaxedAtomic &operator=(const RelaxedAtomic &other) {
+    this->store(other.load());
+    return *this;
+  }
+  RelaxedAtomic &operator=(T value) {
+    this->store(value);
+    return *this;
+  }
+  operator T() const { return this->load(); }
+  T operator++(int) { return this->value_.fetch_add(1, std::memory_order_relaxed); }
+
+  T load() const { return this->value_.load(std::memory_order_relaxed); }
+  void store(T value) { this->value_.store(value, std::memory_order_relaxed); }
+
+ protected:
+  std::atomic<T> value_;
+};
+
+/// Latencies in fixed buckets; bucket i counts samples up to
+/// bucket_limit_us(i), the last bucket everything above.
+class LatencyHistogram {
+ public:
+  static constexpr size_t BUCKET_COUNT = 15;
+
+  static uint32_t bucket_limit_us(size_t index);
+
+  void record(uint32_t us);
+
+  uint32_t count() const { return this->count_; }
+  uint32_t bucket(size_t index) const { return this->buckets_[index]; }
+  uint32_t max_us() const { return this->max_us_; }
+  uint32_t mean_us() const { return this->count_ > 0 ? static_cast<uint32_t>(this->total_us_ / this->count_) : 0; }
+  /// Upper limit of the bucket holding the given fraction of the samples
+  /// (the observed maximum for the last bucket), 0 without samples.
+  uint32_t percentile_us(float fraction) const;
+  /// Samples recorded after ``earlier``, an older copy of this histogram.
+  /// max_us() of the result is the all-time maximum.
+  LatencyHistogram since(const LatencyHistogram &earlier) const;
+
+ protected:
+  uint32_t buckets_[BUCKET_COUNT]{};
+  uint32_t count_{0};
+  uint64_t total_us_{0};
+  uint32_t max_us_{0};
+};
+
+enum class TraceStage : uint8_t {
+  LINK_CHECK = 0,  // reception to the end of the link-layer checks
+  ID_LOOKUP,       // meter table lookup
+  QUEUE,           // enqueue and wait for the decode task
+  DEDUPE,          // duplicate filter
+  DECODE,          // decryption and driver
+  PUBLISH,         // wait for loop(), sensors and triggers (staging with publish_interval)
+  COUNT,
+};
+
+inline constexpr size_t TRACE_STAGE_COUNT = static_cast<size_t>(TraceStage::COUNT);
+
+const char *trace_stage_to_string(TraceStage stage);
+
+/// Time spent by one telegram in each stage, in µs.
+struct TelegramTrace {
+  ReceiveInfo info;
+  uint32_t address{0};
+  uint32_t stage_us[TRACE_STAGE_COUNT]{};
+  uint32_t mark_us{0};  // end of the last stage
+  // Taken by the decode, for loop() to record with ParserMetrics::record_decode().
+  uint32_t decode_us{0};
+  bool has_decode_time{false};
+  uint8_t unrecorded_stages{0};  // bit per stage lapped but not yet recorded
+
+  void start(const ReceiveInfo &receive) {
+    *this = TelegramTrace();
+    this->info = receive;
+    this->mark_us = receive.received_us;
+  }
+  void start_now(uint32_t now_us) { this->info.received_us = this->mark_us = now_us; }
+  /// Close ``stage`` at ``now_us`` and return its duration.
+  uint32_t lap(TraceStage stage, uint32_t now_us) {
+    const uint32_t elapsed = now_us - this->mark_us;
+    this->stage_us[static_cast<size_t>(stage)] = elapsed;
+    this->mark_us = now_us;
+    return elapsed;
+  }
+  /// As lap(), for a stage whose histogram is written later.
+  void lap_unrecorded(TraceStage stage, uint32_t now_us) {
+    this->lap(stage, now_us);
+    this->unrecorded_stages |= 1u << static_cast<size_t>(stage);
+  }
+  void set_decode_time(uint32_t us) {
+    this->decode_us = us;
+    this->has_decode_time = true;
+  }
+  uint32_t stage(TraceStage stage) const { return this->stage_us[static_cast<size_t>(stage)]; }
+  /// Reception to the end of the last stage.
+  uint32_t total_us() const { return this->mark_us - this->info.received_us; }
+};
+
+/// The last few published telegrams' traces; only written from loop().
+class TraceRing {
+ public:
+  void init(size_t capacity) {
+    this->items_.reset(capacity > 0 ? new TelegramTrace[capacity] : nullptr);
+    this->capacity_ = capacity;
+    this->count_ = 0;
+    this->next_ = 0;
+  }
+  bool is_enabled() const { return this->capacity_ > 0; }
+  void add(const TelegramTrace &trace) {
+    if (this->capacity_ == 0)
+      return;
+    this->items_[this->next_] = trace;
+    this->next_ = (this->next_ + 1) % this->capacity_;
+    if (this->count_ < this->capacity_)
+      this->count_++;
+  }
+  size_t size() const { return this->count_; }
+  size_t capacity() const { return this->capacity_; }
+  /// Trace ``index``, 0 being the oldest.
+  const TelegramTrace &at(size_t index) const {
+    return this->items_[(this->next_ + this->capacity_ - this->count_ + index) % this->capacity_];
+  }
+
+ protected:
+  std::unique_ptr<TelegramTrace[]> items_;
+  size_t capacity_{0};
+  size_t count_{0};
+  size_t next_{0};
+};
+
+struct MeterStats {
+  RelaxedAtomic<uint32_t> received{0};  // frames addressed to the meter, duplicates included
+  RelaxedAtomic<uint32_t> decoded{0};
+  RelaxedAtomic<uint32_t> duplicates{0};
+  RelaxedAtomic<uint32_t> failed{0};
+  uint32_t unchanged{0};  // published telegrams that changed nothing (on_change skipped)
+  uint32_t throttled{0};  // total_m3 updates held back by the sensor throttle
+  RelaxedAtomic<uint32_t> last_seen_ms{0};  // millis() of the last frame, valid once received > 0
+
+  /// Milliseconds since the last frame, UINT32_MAX if none was received.
+  uint32_t last_seen_age_ms(uint32_t now_ms) const {
+    return this->received > 0 ? now_ms - this->last_seen_ms : UINT32_MAX;
+  }
+};
+
+struct ParserMetrics {
+  RelaxedAtomic<uint32_t> received{0};  // frames passed to receive_packet
+  RelaxedAtomic<uint32_t> decoded{0};
+  RelaxedAtomic<uint32_t> duplicates{0};
+  RelaxedAtomic<uint32_t> unknown_id{0};
+  // Fed frames dropped on a link header no CRC had checked yet (format B)
+  RelaxedAtomic<uint32_t> early_drops{0};
+  // Link-layer reasons are counted by receive_packet, the others by the decode.
+  RelaxedAtomic<uint32_t> failures[FAILURE_REASON_COUNT]{};
+  LatencyHistogram decode_time;  // decryption and driver, per decoded or failed telegram
+  LatencyHistogram stage_time[TRACE_STAGE_COUNT];  // per stage, for every frame that reached it
+  LatencyHistogram end_to_end;  // reception to publication, per published telegram
+
+  const LatencyHistogram &stage(TraceStage stage) const { return this->stage_time[static_cast<size_t>(stage)]; }
+  void record_stage(TraceStage stage, uint32_t us) { this->stage_time[static_cast<size_t>(stage)].record(us); }
+  /// Record the decode time and stages the decode left in ``trace``; loop() only.
+  void record_decode(TelegramTrace &trace);
+
+  uint32_t failures_for(FailureReason reason) const { return this->failures[static_cast<size_t>(reason)]; }
+  uint32_t failed() const {
+    uint32_t total = 0;
+    for (uint32_t count : this->failures)
+      total += count;
+    return total;
+  }
+  void count_failure(FailureReason reason) { this->failures[static_cast<size_t>(reason)]++; }
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
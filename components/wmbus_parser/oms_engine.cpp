@@ -0,0 +1,199 @@
+#include "oms_engine.h"
+
+#include "esphome/core/log.h"
+#include "telegram_crypto.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace esphome {
+namespace wmbus_parser {
+namespace oms {
+
+namespace {
+
+constexpr uint8_t CI_NO_HEADER = 0x78;
+
+constexpr float POW10[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f};
+constexpr int MAX_EXPONENT = sizeof(POW10) / sizeof(POW10[0]) - 1;
+
+// Dividing by the power of ten rather than multiplying by its inverse keeps
+// values such as 16590 / 1000 exact to the last float bit.
+inline float scale(float value, int exponent) {
+  if (exponent < 0)
+    return value / POW10[std::min(-exponent, MAX_EXPONENT)];
+  return exponent > 0 ? value * POW10[std::min(exponent, MAX_EXPONENT)] : value;
+}
+
+// Integer (type B, signed), BCD (type A) or real (type H) value of a record,
+// scaled by 10^exponent.
+bool read_number(const DataRecord &record, int exponent, float &value) {
+  const uint8_t *data = record.data;
+  const uint16_t len = record.length;
+  const uint8_t code = record.data_code();
+  if (code >= 0x1 && code <= 0x4) {
+    // Nearly every meter value; sign-extend from the top data bit.
+    const unsigned shift = 32 - 8 * len;
+    value = scale(static_cast<float>(static_cast<int32_t>(read_le_uint(data, len) << shift) >> shift), exponent);
+    return true;
+  }
+  switch (code) {
+    case 0x6:
+    case 0x7: {
+      uint64_t raw = 0;
+      for (size_t i = 0; i < len; i++)
+        raw |= static_cast<uint64_t>(data[i]) << (8 * i);
+      if (len < 8 && (data[len - 1] & 0x80))
+        raw |= ~static_cast<uint64_t>(0) << (8 * len);
+      value = scale(static_cast<float>(static_cast<int64_t>(raw)), exponent);
+      return true;
+    }
+    case 0x5: {
+      float real;
+      std::memcpy(&real, data, sizeof(real));
+      value = scale(real, exponent);
+      return true;
+    }
+    case 0x9:
+    case 0xA:
+    case 0xB:
+    case 0xC:
+    case 0xE: {
+      uint64_t digits = 0;
+      for (size_t idx = len; idx-- > 0;)
+        digits = digits * 100 + ((data[idx] >> 4) & 0x0F) * 10 + (data[idx] & 0x0F);
+      value = scale(static_cast<float>(digits), exponent);
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+// BCD digits most significant first. Nibbles above 9 are kept as hex digits,
+// which matches rendering the whole field as hex. ``out`` must hold
+// 2 * len + 1 bytes.
+void decode_bcd_string(const uint8_t *data, size_t len, char *out) {
+  static const char DIGITS[] = "0123456789ABCDEF";
+  for (size_t idx = len; idx-- > 0;) {
+    *out++ = DIGITS[(data[idx] >> 4) & 0x0F];
+    *out++ = DIGITS[data[idx] & 0x0F];
+  }
+  *out = '\0';
+}
+
+// Type G date; returns false when day or month is zero (field not set).
+bool decode_date_g(const uint8_t *data, Date &d) {
+  uint16_t raw = static_cast<uint16_t>(data[0]) | (static_cast<uint16_t>(data[1]) << 8);
+  d.day = raw & 0x1F;
+  d.month = (raw >> 8) & 0x0F;
+  int year_high = (raw >> 12) & 0x0F;
+  int year_low = (raw >> 5) & 0x07;
+  d.year = 2000 + ((year_high << 3) | year_low);
+  return d.day > 0 && d.month > 0;
+}
+
+// Type F date and time; returns false when day or month is zero.
+bool decode_datetime_f(const uint8_t *data, DateTime &dt) {
+  dt.minute = data[0] & 0x3F;
+  dt.hour = data[1] & 0x1F;
+  dt.day = data[2] & 0x1F;
+  dt.month = data[3] & 0x0F;
+  int year_high = (data[3] >> 4) & 0x0F;
+  int year_low = (data[2] >> 5) & 0x07;
+  dt.year = 2000 + ((year_high << 3) | year_low);
+  return dt.day > 0 && dt.month > 0;
+}
+
+}  // namespace
+
+namespace detail {
+
+size_t records_offset(const Descriptor &descriptor, const TelegramView &telegram) {
+  if (telegram.size() < descriptor.min_size || telegram.size() <= TELEGRAM_CI_FIELD) {
+    ESP_LOGW(descriptor.tag, "Telegram too short (%u bytes)", static_cast<unsigned>(telegram.size()));
+    return 0;
+  }
+  size_t offset;
+  switch (telegram[TELEGRAM_CI_FIELD]) {
+    case CI_SHORT_HEADER:
+      offset = TELEGRAM_CI_FIELD + 5;  // access number, status, config word
+      break;
+    case CI_LONG_HEADER:
+      offset = TELEGRAM_CI_FIELD + 13;  // plus address, manufacturer, version, type
+      break;
+    case CI_NO_HEADER:
+      offset = TELEGRAM_CI_FIELD + 1;
+      break;
+    default:
+      ESP_LOGW(descriptor.tag, "Unsupported CI-field 0x%02X", telegram[TELEGRAM_CI_FIELD]);
+      return 0;
+  }
+  if (offset >= telegram.size()) {
+    ESP_LOGW(descriptor.tag, "Unexpected end of telegram");
+    return 0;
+  }
+  return offset;
+}
+
+bool check_required(const Descriptor &descriptor, const DecodedTelegram &result) {
+  if ((result.present & descriptor.required) != descriptor.required) {
+    ESP_LOGW(descriptor.tag, "Missing required fields (0x%04X)",
+             static_cast<unsigned>(descriptor.required & ~result.present));
+    return false;
+  }
+  return true;
+}
+
+void store_number(const DataRecord &record, int exponent, float DecodedTelegram::*member, DecodedField field,
+                  DecodedTelegram &result) {
+  float value;
+  if (!read_number(record, exponent, value))
+    return;
+  result.*member = value;
+  result.mark(field);
+}
+
+void store_history(const DataRecord &record, int exponent, size_t index, DecodedTelegram &result) {
+  float value;
+  if (read_number(record, exponent, value))
+    result.set_history(index, value);
+}
+
+void store_date(const DataRecord &record, Date DecodedTelegram::*member, DecodedField field, DecodedTelegram &result) {
+  Date date;
+  if (!decode_date_g(record.data, date))
+    return;
+  result.*member = date;
+  result.mark(field);
+}
+
+void store_date_time(const DataRecord &record, DateTime DecodedTelegram::*member, DecodedField field,
+                     DecodedTelegram &result) {
+  DateTime dt;
+  if (!decode_datetime_f(record.data, dt))
+    return;
+  result.*member = dt;
+  result.mark(field);
+}
+
+void store_fabrication_no(const DataRecord &record, DecodedTelegram &result) {
+  size_t digits = std::min<size_t>(record.length, (DecodedTelegram::FABRICATION_NO_SIZE - 1) / 2);
+  decode_bcd_string(record.data, digits, result.fabrication_no);
+  result.mark(FIELD_FABRICATION_NO);
+}
+
+void store_status(const DataRecord &record, DecodedTelegram &result) {
+  result.status_flags = read_le_uint(record.data, record.length);
+  result.mark(FIELD_STATUS);
+}
+
+void store_history_interval(const DataRecord &record, DecodedTelegram &result) {
+  result.history_interval_months = record.data[0] != 0 ? record.data[0] : 1;
+  result.mark(FIELD_HISTORY_INTERVAL);
+}
+
+}  // namespace detail
+}  // namespace oms
+}  // namespace wmbus_parser
+}  // namespace esphome
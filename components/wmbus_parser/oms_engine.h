@@ -0,0 +1,294 @@
+/**
+ * Table-driven decoder for OMS / EN 13757-3 meters.
+ *
+ * A driver is a constexpr array of FieldRule: each rule matches a VIF (or an
+ * FDh-extended VIF), a storage number range, a tariff and a function field,
+ * and names the DecodedTelegram member the record is written to together
+ * with the decimal scale. decode<RULES>() is instantiated per table: the
+ * rules become constants, and compile_dispatch() builds a table indexed by
+ * VIF holding a bit per candidate rule, so each record is only checked
+ * against the few rules that can match it.
+ *
+ *   constexpr oms::FieldRule RULES[] = {
+ *       oms::number(oms::VIF_VOLUME_M3, &DecodedTelegram::total_m3, FIELD_TOTAL_M3),
+ *       oms::date(oms::VIF_DATE, &DecodedTelegram::set_date, FIELD_SET_DATE).at_storage(1),
+ *   };
+ *   constexpr oms::Descriptor DESCRIPTOR{TAG, FIELD_TOTAL_M3, 18};
+ *   ... return oms::decode<RULES>(DESCRIPTOR, telegram, result);
+ *
+ * Records are taken by the first rule that accepts them, and a field keeps
+ * the first record written to it. A VIFE changes what a record means (04 93 3C
+ * is the backflow volume, not the total), so records with one, beyond the
+ * code of an FDh rule, only match rules that name it with with_vife().
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "decoded_telegram.h"
+#include "dif_vif.h"
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+namespace oms {
+
+// Dispatch keys: 00h-7Fh primary VIF (without the extension bit), 80h-FFh
+// the first VIFE after an FDh VIF.
+static constexpr size_t DISPATCH_SIZE = 256;
+static constexpr uint8_t VIF_TABLE_PRIMARY = 0;
+static constexpr uint8_t VIF_TABLE_FD = 1;
+static constexpr uint8_t VIF_FD = 0xFD;
+
+using RuleMask = uint32_t;
+static constexpr size_t MAX_RULES = 32;
+
+static constexpr uint8_t ANY = 0xFF;
+static constexpr uint8_t NO_VIFE = 0x80;  // VIFE codes are seven bits
+static constexpr uint8_t FUNCTION_INSTANTANEOUS = 0;
+static constexpr uint8_t FUNCTION_MAXIMUM = 1;
+static constexpr uint8_t FUNCTION_MINIMUM = 2;
+
+/// VIF codes ``(vif & mask) == code`` in one VIF table. For unit VIFs the bits
+/// outside the mask are a decimal exponent, and ``exponent`` is added to them
+/// to scale the value to the unit named by the constant.
+struct VifMatch {
+  uint8_t table;
+  uint8_t code;
+  uint8_t mask;
+  int8_t exponent;
+
+  constexpr bool matches_key(size_t key) const {
+    return key / 128 == this->table && ((key & 0x7F) & this->mask) == this->code;
+  }
+  constexpr int exponent_for(uint8_t code) const { return (code & ~this->mask & 0x7F) + this->exponent; }
+};
+
+constexpr VifMatch fd(uint8_t vife) { return {VIF_TABLE_FD, vife, 0x7F, 0}; }
+
+// EN 13757-3 table 10 (primary VIFs) and table 14 (FDh extension).
+static constexpr VifMatch VIF_ENERGY_KWH{VIF_TABLE_PRIMARY, 0x00, 0x78, -6};  // Wh * 10^(n-3)
+static constexpr VifMatch VIF_VOLUME_M3{VIF_TABLE_PRIMARY, 0x10, 0x78, -6};   // m3 * 10^(n-6)
+static constexpr VifMatch VIF_POWER_KW{VIF_TABLE_PRIMARY, 0x28, 0x78, -6};    // W * 10^(n-3)
+static constexpr VifMatch VIF_VOLUME_FLOW_M3H{VIF_TABLE_PRIMARY, 0x38, 0x78, -6};
+static constexpr VifMatch VIF_FLOW_TEMPERATURE_C{VIF_TABLE_PRIMARY, 0x58, 0x7C, -3};
+static constexpr VifMatch VIF_RETURN_TEMPERATURE_C{VIF_TABLE_PRIMARY, 0x5C, 0x7C, -3};
+static constexpr VifMatch VIF_DATE{VIF_TABLE_PRIMARY, 0x6C, 0x7F, 0};       // type G
+static constexpr VifMatch VIF_DATE_TIME{VIF_TABLE_PRIMARY, 0x6D, 0x7F, 0};  // type F
+static constexpr VifMatch VIF_FABRICATION_NO{VIF_TABLE_PRIMARY, 0x78, 0x7F, 0};
+static constexpr VifMatch VIF_ERROR_FLAGS = fd(0x17);
+static constexpr VifMatch VIF_STORAGE_INTERVAL_MONTHS = fd(0x28);
+
+enum class FieldKind : uint8_t {
+  NUMBER,
+  HISTORY,  // history_m3 slot ``storage - storage_min``
+  DATE,
+  DATE_TIME,
+  FABRICATION_NO,
+  STATUS,
+  HISTORY_INTERVAL,
+};
+
+struct FieldRule {
+  VifMatch vif;
+  FieldKind kind;
+  DecodedField field;
+  float DecodedTelegram::*number;
+  Date DecodedTelegram::*date;
+  DateTime DecodedTelegram::*date_time;
+  uint32_t storage_min;
+  uint32_t storage_max;
+  uint8_t tariff;
+  uint8_t function;
+  uint8_t min_length;
+  uint8_t vife;
+
+  constexpr FieldRule at_storage(uint32_t storage) const { return this->at_storage(storage, storage); }
+  constexpr FieldRule at_storage(uint32_t first, uint32_t last) const {
+    FieldRule rule = *this;
+    rule.storage_min = first;
+    rule.storage_max = last;
+    return rule;
+  }
+  constexpr FieldRule any_storage() const { return this->at_storage(0, UINT32_MAX); }
+  constexpr FieldRule at_tariff(uint8_t value) const {
+    FieldRule rule = *this;
+    rule.tariff = value;
+    return rule;
+  }
+  constexpr FieldRule with_function(uint8_t value) const {
+    FieldRule rule = *this;
+    rule.function = value;
+    return rule;
+  }
+  constexpr FieldRule with_min_length(uint8_t value) const {
+    FieldRule rule = *this;
+    rule.min_length = value;
+    return rule;
+  }
+  /// Records whose first VIFE (after the FDh code) is ``value`` without the
+  /// extension bit, or with any VIFEs for ANY.
+  constexpr FieldRule with_vife(uint8_t value) const {
+    FieldRule rule = *this;
+    rule.vife = value;
+    return rule;
+  }
+
+  bool accepts(const DataRecord &record) const {
+    return record.storage >= this->storage_min && record.storage <= this->storage_max &&
+           (this->tariff == ANY || record.tariff == this->tariff) &&
+           (this->function == ANY || record.function() == this->function) && record.length >= this->min_length &&
+           this->accepts_vife(record);
+  }
+  bool accepts_vife(const DataRecord &record) const {
+    const size_t first = this->vif.table == VIF_TABLE_FD ? 1 : 0;
+    if (this->vife == ANY)
+      return true;
+    if (this->vife == NO_VIFE)
+      return record.vife_count <= first;
+    return record.vife_count > first && (record.vife(first) & 0x7F) == this->vife;
+  }
+};
+
+// Rules default to storage 0, any tariff, any function and no VIFE.
+constexpr FieldRule make_rule(VifMatch vif, FieldKind kind, DecodedField field, uint8_t min_length) {
+  return {vif, kind, field, nullptr, nullptr, nullptr, 0, 0, ANY, ANY, min_length, NO_VIFE};
+}
+
+constexpr FieldRule number(VifMatch vif, float DecodedTelegram::*member, DecodedField field) {
+  FieldRule rule = make_rule(vif, FieldKind::NUMBER, field, 1);
+  rule.number = member;
+  return rule;
+}
+/// History slots from storage number 8 on; slot 0 is storage 8.
+constexpr FieldRule history(VifMatch vif) {
+  return make_rule(vif, FieldKind::HISTORY, static_cast<DecodedField>(0), 1)
+      .at_storage(8, 8 + DecodedTelegram::MAX_HISTORY - 1);
+}
+constexpr FieldRule date(VifMatch vif, Date DecodedTelegram::*member, DecodedField field) {
+  FieldRule rule = make_rule(vif, FieldKind::DATE, field, 2);
+  rule.date = member;
+  return rule;
+}
+constexpr FieldRule date_time(VifMatch vif, DateTime DecodedTelegram::*member, DecodedField field) {
+  FieldRule rule = make_rule(vif, FieldKind::DATE_TIME, field, 4);
+  rule.date_time = member;
+  return rule;
+}
+constexpr FieldRule fabrication_no() {
+  return make_rule(VIF_FABRICATION_NO, FieldKind::FABRICATION_NO, FIELD_FABRICATION_NO, 1);
+}
+constexpr FieldRule error_flags() { return make_rule(VIF_ERROR_FLAGS, FieldKind::STATUS, FIELD_STATUS, 2); }
+constexpr FieldRule history_interval() {
+  return make_rule(VIF_STORAGE_INTERVAL_MONTHS, FieldKind::HISTORY_INTERVAL, FIELD_HISTORY_INTERVAL, 1);
+}
+
+/// Bit ``i`` of entry ``key`` is set when rule ``i`` matches that VIF.
+template<size_t N> constexpr std::array<RuleMask, DISPATCH_SIZE> compile_dispatch(const FieldRule (&rules)[N]) {
+  static_assert(N <= MAX_RULES, "a descriptor holds at most 32 rules");
+  std::array<RuleMask, DISPATCH_SIZE> dispatch{};
+  for (size_t key = 0; key < DISPATCH_SIZE; key++) {
+    for (size_t i = 0; i < N; i++) {
+      if (rules[i].vif.matches_key(key))
+        dispatch[key] |= static_cast<RuleMask>(1) << i;
+    }
+  }
+  return dispatch;
+}
+
+struct Descriptor {
+  const char *tag;    // log tag of the driver
+  uint32_t required;  // DecodedField bits without which decoding fails
+  uint8_t min_size;   // shorter telegrams are rejected up front
+};
+
+namespace detail {
+
+/// Offset of the first data record, or 0 (logged) when the telegram cannot be decoded.
+size_t records_offset(const Descriptor &descriptor, const TelegramView &telegram);
+bool check_required(const Descriptor &descriptor, const DecodedTelegram &result);
+
+inline size_t dispatch_key(const DataRecord &record) {
+  if (record.vif == VIF_FD && record.has_vife())
+    return 128 + (record.vife(0) & 0x7F);
+  return record.vif_base();
+}
+
+void store_number(const DataRecord &record, int exponent, float DecodedTelegram::*member, DecodedField field,
+                  DecodedTelegram &result);
+void store_history(const DataRecord &record, int exponent, size_t index, DecodedTelegram &result);
+void store_date(const DataRecord &record, Date DecodedTelegram::*member, DecodedField field, DecodedTelegram &result);
+void store_date_time(const DataRecord &record, DateTime DecodedTelegram::*member, DecodedField field,
+                     DecodedTelegram &result);
+void store_fabrication_no(const DataRecord &record, DecodedTelegram &result);
+void store_status(const DataRecord &record, DecodedTelegram &result);
+void store_history_interval(const DataRecord &record, DecodedTelegram &result);
+
+// Rule ``I`` is a constant here, so the checks below fold into the few
+// comparisons the rule actually needs.
+template<const auto &RULES, size_t I>
+inline bool try_rule(const DataRecord &record, uint8_t code, DecodedTelegram &result) {
+  constexpr const FieldRule &rule = RULES[I];
+  if (!rule.accepts(record))
+    return false;
+  if constexpr (rule.kind == FieldKind::HISTORY) {
+    const size_t index = record.storage - rule.storage_min;
+    if (!result.has_history(index))
+      store_history(record, rule.vif.exponent_for(code), index, result);
+  } else if (!result.has(rule.field)) {
+    if constexpr (rule.kind == FieldKind::NUMBER) {
+      store_number(record, rule.vif.exponent_for(code), rule.number, rule.field, result);
+    } else if constexpr (rule.kind == FieldKind::DATE) {
+      store_date(record, rule.date, rule.field, result);
+    } else if constexpr (rule.kind == FieldKind::DATE_TIME) {
+      store_date_time(record, rule.date_time, rule.field, result);
+    } else if constexpr (rule.kind == FieldKind::FABRICATION_NO) {
+      store_fabrication_no(record, result);
+    } else if constexpr (rule.kind == FieldKind::STATUS) {
+      store_status(record, result);
+    } else {
+      store_history_interval(record, result);
+    }
+  }
+  return true;
+}
+
+template<const auto &RULES, size_t... I>
+inline void dispatch(RuleMask candidates, const DataRecord &record, uint8_t code, DecodedTelegram &result,
+                     std::index_sequence<I...>) {
+  (void) ((((candidates >> I) & 1) != 0 && try_rule<RULES, I>(record, code, result)) || ...);
+}
+
+template<const auto &RULES> constexpr auto DISPATCH = compile_dispatch(RULES);
+
+}  // namespace detail
+
+/// Decode the data records of ``telegram`` (short, long or no transport
+/// header) with the rule table ``RULES``. Returns false when the telegram is
+/// too short or a required field is missing.
+template<const auto &RULES>
+bool decode(const Descriptor &descriptor, const TelegramView &telegram, DecodedTelegram &result) {
+  result.clear();
+  const size_t offset = detail::records_offset(descriptor, telegram);
+  if (offset == 0)
+    return false;
+
+  constexpr size_t count = sizeof(RULES) / sizeof(RULES[0]);
+  RecordIterator records(telegram.subview(offset));
+  DataRecord record;
+  while (records.next(record)) {
+    if (record.length == 0 || record.is_manufacturer_specific())
+      continue;
+    const size_t key = detail::dispatch_key(record);
+    detail::dispatch<RULES>(detail::DISPATCH<RULES>[key], record, static_cast<uint8_t>(key & 0x7F), result,
+                            std::make_index_sequence<count>());
+  }
+  return detail::check_required(descriptor, result);
+}
+
+}  // namespace oms
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,56 @@
+#include "oms_heat_driver.h"
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_WMBUS_DRIVER_OMS_HEAT
+
+#include "oms_engine.h"
+
+namespace esphome {
+namespace wmbus_parser {
+namespace oms_heat {
+
+namespace {
+
+constexpr const char *TAG = "wmbus_parser.oms_heat";
+
+// Current values of OMS heat meters in Wh/W units; storage 1 holds the
+// reading at the billing date. Meters reporting energy in J or through the
+// FBh extension table need their own descriptor.
+constexpr oms::FieldRule RULES[] = {
+    oms::number(oms::VIF_ENERGY_KWH, &DecodedTelegram::total_energy_kwh, FIELD_TOTAL_ENERGY)
+        .at_tariff(0)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::number(oms::VIF_VOLUME_M3, &DecodedTelegram::total_m3, FIELD_TOTAL_M3)
+        .at_tariff(0)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::number(oms::VIF_POWER_KW, &DecodedTelegram::power_kw, FIELD_POWER)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::number(oms::VIF_VOLUME_FLOW_M3H, &DecodedTelegram::volume_flow_m3h, FIELD_VOLUME_FLOW)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::number(oms::VIF_VOLUME_FLOW_M3H, &DecodedTelegram::max_flow_m3h, FIELD_MAX_FLOW)
+        .any_storage()
+        .with_function(oms::FUNCTION_MAXIMUM),
+    oms::number(oms::VIF_FLOW_TEMPERATURE_C, &DecodedTelegram::flow_temperature_c, FIELD_FLOW_TEMPERATURE)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::number(oms::VIF_RETURN_TEMPERATURE_C, &DecodedTelegram::return_temperature_c, FIELD_RETURN_TEMPERATURE)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::date_time(oms::VIF_DATE_TIME, &DecodedTelegram::device_datetime, FIELD_DEVICE_DATETIME),
+    oms::date(oms::VIF_DATE, &DecodedTelegram::set_date, FIELD_SET_DATE).at_storage(1),
+    oms::fabrication_no(),
+    oms::error_flags().with_min_length(1),
+};
+
+constexpr oms::Descriptor DESCRIPTOR{TAG, FIELD_TOTAL_ENERGY, TELEGRAM_LINK_HEADER_SIZE + 3};
+
+}  // namespace
+
+bool OmsHeatDriver::decode(const TelegramView &telegram, DecodedTelegram &result) {
+  return oms::decode<RULES>(DESCRIPTOR, telegram, result);
+}
+
+}  // namespace oms_heat
+}  // namespace wmbus_parser
+}  // namespace esphome
+
+#endif  // USE_WMBUS_DRIVER_OMS_HEAT
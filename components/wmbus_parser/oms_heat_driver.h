@@ -0,0 +1,24 @@
+#pragma once
+
+#include "decoded_telegram.h"
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+namespace oms_heat {
+
+/// Generic OMS heat meter: energy, volume, power, flow and temperatures.
+class OmsHeatDriver {
+ public:
+  static constexpr HeaderMatch MATCHES[] = {
+      {HEADER_ANY, HEADER_ANY, DEVICE_TYPE_HEAT_OUTLET},
+      {HEADER_ANY, HEADER_ANY, DEVICE_TYPE_HEAT_INLET},
+      {HEADER_ANY, HEADER_ANY, DEVICE_TYPE_HEAT_COOLING},
+  };
+
+  static bool decode(const TelegramView &telegram, DecodedTelegram &result);
+};
+
+}  // namespace oms_heat
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,53 @@
+#include "oms_water_driver.h"
+
+#include "esphome/core/defines.h"
+
+#ifdef USE_WMBUS_DRIVER_OMS_WATER
+
+#include "oms_engine.h"
+
+namespace esphome {
+namespace wmbus_parser {
+namespace oms_water {
+
+namespace {
+
+constexpr const char *TAG = "wmbus_parser.oms_water";
+
+// The current values of OMS water meters (OMS Vol. 2 annex), read from the
+// untariffed records; storage 1 is the billing date reading.
+constexpr oms::FieldRule RULES[] = {
+    oms::number(oms::VIF_VOLUME_M3, &DecodedTelegram::total_m3, FIELD_TOTAL_M3)
+        .at_tariff(0)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::number(oms::VIF_VOLUME_M3, &DecodedTelegram::consumption_at_set_date_m3, FIELD_CONSUMPTION_AT_SET_DATE)
+        .at_storage(1)
+        .at_tariff(0),
+    oms::history(oms::VIF_VOLUME_M3).at_tariff(0),
+    oms::date(oms::VIF_DATE, &DecodedTelegram::set_date, FIELD_SET_DATE).at_storage(1),
+    oms::date_time(oms::VIF_DATE_TIME, &DecodedTelegram::device_datetime, FIELD_DEVICE_DATETIME),
+    oms::number(oms::VIF_VOLUME_FLOW_M3H, &DecodedTelegram::volume_flow_m3h, FIELD_VOLUME_FLOW)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::number(oms::VIF_VOLUME_FLOW_M3H, &DecodedTelegram::max_flow_m3h, FIELD_MAX_FLOW)
+        .any_storage()
+        .with_function(oms::FUNCTION_MAXIMUM),
+    oms::number(oms::VIF_FLOW_TEMPERATURE_C, &DecodedTelegram::flow_temperature_c, FIELD_FLOW_TEMPERATURE)
+        .with_function(oms::FUNCTION_INSTANTANEOUS),
+    oms::fabrication_no(),
+    oms::error_flags().with_min_length(1),
+    oms::history_interval(),
+};
+
+constexpr oms::Descriptor DESCRIPTOR{TAG, FIELD_TOTAL_M3, TELEGRAM_LINK_HEADER_SIZE + 3};
+
+}  // namespace
+
+bool OmsWaterDriver::decode(const TelegramView &telegram, DecodedTelegram &result) {
+  return oms::decode<RULES>(DESCRIPTOR, telegram, result);
+}
+
+}  // namespace oms_water
+}  // namespace wmbus_parser
+}  // namespace esphome
+
+#endif  // USE_WMBUS_DRIVER_OMS_WATER
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "decoded_telegram.h"
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+namespace oms_water {
+
+/// Generic OMS water meter: volume, flow, water temperature and monthly history.
+class OmsWaterDriver {
+ public:
+  static constexpr HeaderMatch MATCHES[] = {
+      {HEADER_ANY, HEADER_ANY, DEVICE_TYPE_WATER},
+      {HEADER_ANY, HEADER_ANY, DEVICE_TYPE_WARM_WATER},
+      {HEADER_ANY, HEADER_ANY, DEVICE_TYPE_HOT_WATER},
+      {HEADER_ANY, HEADER_ANY, DEVICE_TYPE_COLD_WATER},
+  };
+
+  static bool decode(const TelegramView &telegram, DecodedTelegram &result);
+};
+
+}  // namespace oms_water
+}  // namespace wmbus_parser
+}  // namespace esphome
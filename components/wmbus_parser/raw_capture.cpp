@@ -0,0 +1,139 @@
+#include "raw_capture.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace wmbus_parser {
+
+void write_capture_file_header(uint8_t *out) {
+  memcpy(out, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+  out[4] = CAPTURE_VERSION;
+  out[5] = out[6] = out[7] = 0;
+}
+
+bool is_capture_file(const uint8_t *data, size_t size) {
+  return size >= CAPTURE_FILE_HEADER_SIZE && memcmp(data, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) == 0 &&
+         data[4] == CAPTURE_VERSION;
+}
+
+bool parse_capture_record(const uint8_t *data, size_t size, size_t &pos, CaptureRecord &record) {
+  if (pos + CAPTURE_RECORD_HEADER_SIZE > size)
+    return false;
+  const uint8_t *p = data + pos;
+  record.length = static_cast<uint16_t>(p[0] | (p[1] << 8));
+  record.timestamp_ms = static_cast<uint32_t>(p[2]) | (static_cast<uint32_t>(p[3]) << 8) |
+                        (static_cast<uint32_t>(p[4]) << 16) | (static_cast<uint32_t>(p[5]) << 24);
+  record.flags = p[6];
+  if (pos + CAPTURE_RECORD_HEADER_SIZE + record.length > size)
+    return false;
+  record.data = p + CAPTURE_RECORD_HEADER_SIZE;
+  pos += CAPTURE_RECORD_HEADER_SIZE + record.length;
+  return true;
+}
+
+void RawCaptureBuffer::init(size_t capacity) {
+  this->buffer_.reset(capacity > 0 ? new uint8_t[capacity] : nullptr);
+  this->capacity_ = capacity;
+  this->head_ = this->tail_ = this->used_ = 0;
+  this->records_ = 0;
+}
+
+void RawCaptureBuffer::put_(const uint8_t *data, size_t len) {
+  size_t first = this->capacity_ - this->head_;
+  if (first > len)
+    first = len;
+  memcpy(this->buffer_.get() + this->head_, data, first);
+  memcpy(this->buffer_.get(), data + first, len - first);
+  this->head_ = (this->head_ + len) % this->capacity_;
+  this->used_ += len;
+}
+
+void RawCaptureBuffer::peek_(size_t offset, uint8_t *out, size_t len) const {
+  size_t start = (this->tail_ + offset) % this->capacity_;
+  size_t first = this->capacity_ - start;
+  if (first > len)
+    first = len;
+  memcpy(out, this->buffer_.get() + start, first);
+  memcpy(out + first, this->buffer_.get(), len - first);
+}
+
+uint16_t RawCaptureBuffer::peek_length_() const {
+  uint8_t len[2];
+  this->peek_(0, len, sizeof(len));
+  return static_cast<uint16_t>(len[0] | (len[1] << 8));
+}
+
+void RawCaptureBuffer::drop_oldest_() {
+  size_t record_size = CAPTURE_RECORD_HEADER_SIZE + this->peek_length_();
+  this->tail_ = (this->tail_ + record_size) % this->capacity_;
+  this->used_ -= record_size;
+  this->records_--;
+  this->dropped_++;
+}
+
+bool RawCaptureBuffer::append(const uint8_t *frame, size_t len, uint32_t timestamp_ms, uint8_t flags) {
+  size_t record_size = CAPTURE_RECORD_HEADER_SIZE + len;
+  if (this->buffer_ == nullptr || len > 0xFFFF || record_size > this->capacity_) {
+    this->dropped_++;
+    return false;
+  }
+  while (this->capacity_ - this->used_ < record_size)
+    this->drop_oldest_();
+
+  uint8_t header[CAPTURE_RECORD_HEADER_SIZE] = {
+      static_cast<uint8_t>(len),          static_cast<uint8_t>(len >> 8),
+      static_cast<uint8_t>(timestamp_ms), static_cast<uint8_t>(timestamp_ms >> 8),
+      static_cast<uint8_t>(timestamp_ms >> 16), static_cast<uint8_t>(timestamp_ms >> 24),
+      flags,
+  };
+  this->put_(header, sizeof(header));
+  this->put_(frame, len);
+  this->records_++;
+  this->appended_++;
+  return true;
+}
+
+size_t RawCaptureBuffer::read(uint8_t *out, size_t max) {
+  size_t written = 0;
+  while (this->records_ > 0) {
+    size_t record_size = CAPTURE_RECORD_HEADER_SIZE + this->peek_length_();
+    if (written + record_size > max)
+      break;
+    this->peek_(0, out + written, record_size);
+    this->tail_ = (this->tail_ + record_size) % this->capacity_;
+    this->used_ -= record_size;
+    this->records_--;
+    written += record_size;
+  }
+  return written;
+}
+
+bool FileCaptureSink::open(const char *path) {
+  this->close();
+  this->file_ = fopen(path, "ab");
+  if (this->file_ == nullptr)
+    return false;
+  if (ftell(this->file_) == 0) {
+    uint8_t header[CAPTURE_FILE_HEADER_SIZE];
+    write_capture_file_header(header);
+    fwrite(header, 1, sizeof(header), this->file_);
+  }
+  return true;
+}
+
+void FileCaptureSink::close() {
+  if (this->file_ != nullptr)
+    fclose(this->file_);
+  this->file_ = nullptr;
+}
+
+bool FileCaptureSink::write(const uint8_t *data, size_t len) {
+  if (this->file_ == nullptr)
+    return false;
+  bool ok = fwrite(data, 1, len, this->file_) == len;
+  fflush(this->file_);
+  return ok;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,102 @@
+/**
+ * Compact binary capture of received frames.
+ *
+ * Frames are appended to an in-RAM ring as records of
+ *
+ *   u16 length | u32 receive time (ms, little-endian) | u8 flags | frame bytes
+ *
+ * and drained whole-record by a CaptureSink or by read(). When the ring is
+ * full the oldest records are dropped. A capture file is an 8 byte header
+ * ("WMBC", version, 3 reserved bytes) followed by the same records, and is
+ * read by the host tools (wmbus_replay).
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+namespace esphome {
+namespace wmbus_parser {
+
+static constexpr uint8_t CAPTURE_MAGIC[4] = {'W', 'M', 'B', 'C'};
+static constexpr uint8_t CAPTURE_VERSION = 1;
+static constexpr size_t CAPTURE_FILE_HEADER_SIZE = 8;
+static constexpr size_t CAPTURE_RECORD_HEADER_SIZE = 7;
+
+enum CaptureFlag : uint8_t {
+  CAPTURE_FLAG_C1_HEADER = 1u << 0,
+  CAPTURE_FLAG_METER_MATCH = 1u << 1,
+  CAPTURE_FLAG_FRAME_OK = 1u << 2,  // L-field and CRCs passed (or CRC check disabled)
+  CAPTURE_FLAG_T1 = 1u << 3,        // 3-of-6 encoded T1 frame
+};
+
+struct CaptureRecord {
+  uint32_t timestamp_ms{0};
+  uint8_t flags{0};
+  uint16_t length{0};
+  const uint8_t *data{nullptr};
+};
+
+void write_capture_file_header(uint8_t *out);
+bool is_capture_file(const uint8_t *data, size_t size);
+/// Parse the record at ``pos`` of a contiguous capture and advance ``pos``.
+/// Returns false at the end of the data or on a truncated record.
+bool parse_capture_record(const uint8_t *data, size_t size, size_t &pos, CaptureRecord &record);
+
+class RawCaptureBuffer {
+ public:
+  /// Allocate the ring once. A capacity of 0 disables capturing.
+  void init(size_t capacity);
+  bool is_enabled() const { return this->capacity_ > 0; }
+
+  /// Append one frame, dropping the oldest records if needed.
+  bool append(const uint8_t *frame, size_t len, uint32_t timestamp_ms, uint8_t flags);
+  /// Move as many whole records as fit into ``out``; returns bytes written.
+  size_t read(uint8_t *out, size_t max);
+
+  size_t capacity() const { return this->capacity_; }
+  size_t used() const { return this->used_; }
+  uint32_t records() const { return this->records_; }
+  uint32_t appended() const { return this->appended_; }
+  uint32_t dropped() const { return this->dropped_; }
+
+ protected:
+  void put_(const uint8_t *data, size_t len);
+  void peek_(size_t offset, uint8_t *out, size_t len) const;
+  uint16_t peek_length_() const;
+  void drop_oldest_();
+
+  std::unique_ptr<uint8_t[]> buffer_;
+  size_t capacity_{0};
+  size_t head_{0};  // write position
+  size_t tail_{0};  // oldest record
+  size_t used_{0};
+  uint32_t records_{0};
+  uint32_t appended_{0};
+  uint32_t dropped_{0};
+};
+
+/// Destination for drained capture records.
+class CaptureSink {
+ public:
+  virtual ~CaptureSink() = default;
+  virtual bool write(const uint8_t *data, size_t len) = 0;
+};
+
+/// Appends records to a capture file through stdio, so it works on the host
+/// and on ESP-IDF with a mounted filesystem.
+class FileCaptureSink : public CaptureSink {
+ public:
+  ~FileCaptureSink() override { this->close(); }
+  bool open(const char *path);
+  void close();
+  bool write(const uint8_t *data, size_t len) override;
+
+ protected:
+  FILE *file_{nullptr};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,257 @@
+#include "reading_history.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+// Two zigzag varints of up to ten bytes each.
+constexpr size_t MAX_DELTA_SIZE = 20;
+
+uint64_t zigzag(int64_t value) { return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63); }
+int64_t unzigzag(uint64_t value) { return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1); }
+
+size_t put_varint(uint8_t *out, uint64_t value) {
+  size_t len = 0;
+  while (value >= 0x80) {
+    out[len++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  out[len++] = static_cast<uint8_t>(value);
+  return len;
+}
+
+// Preference keys: one per page and one for the header (page 0xFF).
+uint32_t preference_key(uint32_t address, uint8_t page) {
+  uint32_t h = 0x811C9DC5u;
+  const uint8_t bytes[] = {'H',
+                           static_cast<uint8_t>(address),
+                           static_cast<uint8_t>(address >> 8),
+                           static_cast<uint8_t>(address >> 16),
+                           static_cast<uint8_t>(address >> 24),
+                           page};
+  for (uint8_t b : bytes)
+    h = (h ^ b) * 0x01000193u;
+  return h;
+}
+
+constexpr uint8_t HEADER_PAGE = 0xFF;
+
+}  // namespace
+
+ReadingHistory::Iterator::Iterator(const ReadingHistory *history, size_t index)
+    : history_(history), index_(0), pos_(0), time_(0), litres_(0) {
+  if (history == nullptr || history->header_.count == 0) {
+    this->index_ = index;
+    return;
+  }
+  this->pos_ = history->header_.head;
+  this->time_ = history->header_.first_time;
+  this->litres_ = history->header_.first_litres;
+  const size_t count = history->header_.count;
+  if (index >= count) {
+    this->index_ = index;
+    return;
+  }
+  while (this->index_ < index)
+    ++*this;
+}
+
+HistoryReading ReadingHistory::Iterator::operator*() const {
+  return HistoryReading{static_cast<std::time_t>(this->time_), static_cast<float>(this->litres_) / 1000.0f};
+}
+
+ReadingHistory::Iterator &ReadingHistory::Iterator::operator++() {
+  if (++this->index_ < this->history_->header_.count)
+    this->pos_ = this->history_->read_delta_(this->pos_, this->time_, this->litres_);
+  return *this;
+}
+
+void ReadingHistory::init(size_t size) {
+  const size_t pages = std::min((size + PAGE_SIZE - 1) / PAGE_SIZE, MAX_PAGES);
+  this->capacity_ = pages * PAGE_SIZE;
+  this->data_.reset(pages > 0 ? new uint8_t[this->capacity_]() : nullptr);
+  this->clear_();
+}
+
+bool ReadingHistory::append(std::time_t timestamp, float total_m3, uint32_t min_spacing_s) {
+  if (this->capacity_ == 0 || std::isnan(total_m3) || timestamp < MIN_TIMESTAMP)
+    return false;
+  Header &h = this->header_;
+  const int64_t time = timestamp;
+  const int32_t litres = static_cast<int32_t>(std::lround(static_cast<double>(total_m3) * 1000.0));
+  if (h.count == 0) {
+    h.first_time = h.last_time = time;
+    h.first_litres = h.last_litres = litres;
+    h.count = 1;
+    h.unsent = 1;
+    this->header_dirty_ = true;
+    return true;
+  }
+  // A clock stepped back is recorded rather than waited out.
+  if (time >= h.last_time && time - h.last_time < static_cast<int64_t>(min_spacing_s))
+    return false;
+
+  uint8_t delta[MAX_DELTA_SIZE];
+  size_t len = put_varint(delta, zigzag(time - h.last_time));
+  len += put_varint(delta + len, zigzag(static_cast<int64_t>(litres) - h.last_litres));
+  while (this->capacity_ - h.used < len || h.count == UINT16_MAX)
+    this->drop_oldest_();
+  this->write_(delta, len);
+  h.last_time = time;
+  h.last_litres = litres;
+  h.count++;
+  h.unsent = std::min<uint16_t>(h.unsent + 1, h.count);
+  this->header_dirty_ = true;
+  return true;
+}
+
+void ReadingHistory::mark_sent() {
+  if (this->header_.unsent == 0)
+    return;
+  this->header_.unsent = 0;
+  this->header_dirty_ = true;
+}
+
+void ReadingHistory::write_(const uint8_t *bytes, size_t len) {
+  size_t pos = (this->header_.head + this->header_.used) % this->capacity_;
+  for (size_t i = 0; i < len; i++) {
+    this->data_[pos] = bytes[i];
+    this->dirty_pages_ |= uint64_t{1} << (pos / PAGE_SIZE);
+    if (++pos == this->capacity_)
+      pos = 0;
+  }
+  this->header_.used += static_cast<uint16_t>(len);
+}
+
+// Adds the delta at ``pos`` to time and litres and returns the position after it.
+size_t ReadingHistory::read_delta_(size_t pos, int64_t &time, int64_t &litres) const {
+  for (int64_t *field : {&time, &litres}) {
+    uint64_t value = 0;
+    unsigned shift = 0;
+    uint8_t byte;
+    do {
+      byte = this->data_[pos];
+      if (++pos == this->capacity_)
+        pos = 0;
+      if (shift < 64)
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      shift += 7;
+    } while ((byte & 0x80) && shift < 7 * 10);
+    *field += unzigzag(value);
+  }
+  return pos;
+}
+
+void ReadingHistory::drop_oldest_() {
+  Header &h = this->header_;
+  int64_t time = h.first_time;
+  int64_t litres = h.first_litres;
+  const size_t next = this->read_delta_(h.head, time, litres);
+  const size_t len = (next + this->capacity_ - h.head) % this->capacity_;
+  h.first_time = time;
+  h.first_litres = static_cast<int32_t>(litres);
+  h.head = static_cast<uint16_t>(next);
+  h.used -= static_cast<uint16_t>(len);
+  h.count--;
+  if (h.unsent > h.count) {
+    h.unsent = h.count;
+    h.lost++;
+  }
+}
+
+bool ReadingHistory::load(uint32_t key) {
+  this->clear_();
+  this->header_.key = key;
+  if (this->capacity_ == 0)
+    return false;
+  this->header_pref_ = global_preferences->make_preference<Header>(preference_key(key, HEADER_PAGE), true);
+  const size_t pages = this->capacity_ / PAGE_SIZE;
+  this->page_prefs_.clear();
+  this->page_prefs_.reserve(pages);
+  for (size_t i = 0; i < pages; i++)
+    this->page_prefs_.push_back(global_preferences->make_preference<Page>(preference_key(key, i), true));
+
+  if (this->load_saved_())
+    return true;
+  // Start over, and write every page with the first save so the next load
+  // finds a complete record.
+  this->clear_();
+  this->dirty_pages_ = pages == MAX_PAGES ? ~uint64_t{0} : (uint64_t{1} << pages) - 1;
+  this->header_dirty_ = true;
+  return false;
+}
+
+bool ReadingHistory::load_saved_() {
+  Header saved;
+  if (!this->header_pref_.load(&saved) || saved.key != this->header_.key || saved.capacity != this->capacity_)
+    return false;
+  for (size_t i = 0; i < this->page_prefs_.size(); i++) {
+    Page page;
+    if (!this->page_prefs_[i].load(&page))
+      return false;
+    std::memcpy(this->data_.get() + i * PAGE_SIZE, page.data, PAGE_SIZE);
+  }
+  this->header_ = saved;
+  // A reboot between saving a page and its header leaves them apart.
+  return this->is_consistent_();
+}
+
+size_t ReadingHistory::save() {
+  if (this->page_prefs_.empty())
+    return 0;
+  size_t written = 0;
+  for (size_t i = 0; this->dirty_pages_ != 0; i++) {
+    if ((this->dirty_pages_ & (uint64_t{1} << i)) == 0)
+      continue;
+    Page page;
+    std::memcpy(page.data, this->data_.get() + i * PAGE_SIZE, PAGE_SIZE);
+    this->page_prefs_[i].save(&page);
+    this->dirty_pages_ &= ~(uint64_t{1} << i);
+    written++;
+  }
+  if (this->header_dirty_) {
+    this->header_pref_.save(&this->header_);
+    this->header_dirty_ = false;
+    written++;
+  }
+  return written;
+}
+
+bool ReadingHistory::is_consistent_() const {
+  const Header &h = this->header_;
+  if (h.head >= this->capacity_ || h.used > this->capacity_ || h.unsent > h.count || (h.count <= 1 && h.used != 0))
+    return false;
+  // Walk the deltas: they have to end exactly at the newest reading.
+  int64_t time = h.first_time;
+  int64_t litres = h.first_litres;
+  size_t pos = h.head;
+  size_t walked = 0;
+  for (size_t i = 1; i < h.count; i++) {
+    const size_t next = this->read_delta_(pos, time, litres);
+    walked += (next + this->capacity_ - pos) % this->capacity_;
+    if (walked > h.used)
+      return false;
+    pos = next;
+  }
+  return walked == h.used && time == h.last_time && litres == h.last_litres;
+}
+
+void ReadingHistory::clear_() {
+  const uint32_t key = this->header_.key;
+  this->header_ = Header{};
+  this->header_.key = key;
+  this->header_.capacity = static_cast<uint16_t>(this->capacity_);
+  this->dirty_pages_ = 0;
+  this->header_dirty_ = false;
+}
+
+ReadingHistory::Iterator HistoryReadings::begin() const { return ReadingHistory::Iterator(this->history_, this->first_); }
+
+}  // namespace wmbus_parser
+}  // namespace esphome
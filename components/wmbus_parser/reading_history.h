@@ -0,0 +1,144 @@
+/**
+ * Per-meter history of total_m3 readings, kept across reboots.
+ *
+ * Readings that arrive while Wi-Fi or MQTT is down are otherwise lost: the
+ * sensors only hold the current value. ReadingHistory keeps a ring of
+ * (timestamp, total) pairs so they can be replayed once the connection is
+ * back. Only the oldest reading is stored in full; each later one is the
+ * difference to its predecessor in seconds and litres, zigzag and varint
+ * encoded, which is two or three bytes for a meter read every few minutes.
+ * When the ring is full the oldest readings are dropped.
+ *
+ * The ring is split into pages that are saved as separate ESPHome
+ * preferences, so an append only rewrites the page it touched.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "esphome/core/preferences.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+struct HistoryReading {
+  std::time_t timestamp;
+  float total_m3;
+};
+
+class ReadingHistory {
+ public:
+  static constexpr size_t PAGE_SIZE = 64;
+  static constexpr size_t MAX_PAGES = 64;
+  // Readings stamped before 2020 were taken before the clock was set.
+  static constexpr std::time_t MIN_TIMESTAMP = 1577836800;
+
+  class Iterator {
+   public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = HistoryReading;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const HistoryReading *;
+    using reference = HistoryReading;
+
+    Iterator(const ReadingHistory *history, size_t index);
+    HistoryReading operator*() const;
+    Iterator &operator++();
+    bool operator==(const Iterator &other) const { return this->index_ == other.index_; }
+    bool operator!=(const Iterator &other) const { return this->index_ != other.index_; }
+
+   protected:
+    const ReadingHistory *history_;
+    size_t index_;
+    size_t pos_;
+    int64_t time_;
+    int64_t litres_;
+  };
+
+  /// Allocate ``size`` bytes, rounded up to whole pages (0 disables).
+  void init(size_t size);
+  bool is_enabled() const { return this->capacity_ > 0; }
+
+  /// Record a reading unless it comes less than ``min_spacing_s`` after the
+  /// previous one, has no value or is stamped before the clock was set.
+  bool append(std::time_t timestamp, float total_m3, uint32_t min_spacing_s = 0);
+  /// Count every reading as replayed; they stay in the ring.
+  void mark_sent();
+
+  size_t size() const { return this->header_.count; }
+  bool empty() const { return this->header_.count == 0; }
+  /// The newest readings not yet handed to on_backfill.
+  size_t unsent() const { return this->header_.unsent; }
+  /// Readings dropped from the full ring before they were replayed.
+  uint32_t lost() const { return this->header_.lost; }
+  size_t bytes_used() const { return this->header_.used; }
+  size_t capacity() const { return this->capacity_; }
+  Iterator begin() const { return Iterator(this, 0); }
+  Iterator end() const { return Iterator(this, this->header_.count); }
+
+  /// Load the history saved for ``key`` (the meter address); a missing or
+  /// inconsistent record starts an empty one.
+  bool load(uint32_t key);
+  /// Save the pages changed since the last call. Returns how many were written.
+  size_t save();
+
+ protected:
+  struct Header {
+    uint32_t key;
+    uint16_t capacity;
+    uint16_t head;  // oldest delta byte
+    uint16_t used;  // delta bytes
+    uint16_t count;
+    uint16_t unsent;
+    uint16_t reserved;
+    uint32_t lost;
+    int64_t first_time;
+    int64_t last_time;
+    int32_t first_litres;
+    int32_t last_litres;
+  };
+  struct Page {
+    uint8_t data[PAGE_SIZE];
+  };
+
+  void write_(const uint8_t *bytes, size_t len);
+  size_t read_delta_(size_t pos, int64_t &time, int64_t &litres) const;
+  void drop_oldest_();
+  bool load_saved_();
+  bool is_consistent_() const;
+  void clear_();
+
+  std::unique_ptr<uint8_t[]> data_;
+  size_t capacity_{0};
+  Header header_{};
+  uint64_t dirty_pages_{0};
+  bool header_dirty_{false};
+  ESPPreferenceObject header_pref_;
+  std::vector<ESPPreferenceObject> page_prefs_;
+};
+
+/// Payload of the on_backfill trigger: one meter's readings not yet replayed,
+/// oldest first. A view over parser-owned state, only valid while the trigger
+/// runs.
+class HistoryReadings {
+ public:
+  HistoryReadings() = default;
+  HistoryReadings(const ReadingHistory *history, size_t first) : history_(history), first_(first) {}
+
+  size_t size() const { return this->history_ != nullptr ? this->history_->size() - this->first_ : 0; }
+  bool empty() const { return this->size() == 0; }
+  ReadingHistory::Iterator begin() const;
+  ReadingHistory::Iterator end() const { return ReadingHistory::Iterator(this->history_, this->first_ + this->size()); }
+
+ protected:
+  const ReadingHistory *history_{nullptr};
+  size_t first_{0};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,26 @@
+/**
+ * What the radio knows about a frame besides its bytes.
+ *
+ * The receive time is taken when the frame is handed over, so the telegram
+ * timestamp and the latency trace measure from reception rather than from
+ * whenever the decode task got to the frame.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+namespace esphome {
+namespace wmbus_parser {
+
+struct ReceiveInfo {
+  uint32_t received_us{0};  // micros() when the radio delivered the frame
+  float rssi_dbm{NAN};
+  float snr_db{NAN};
+  uint8_t source{0};  // radio or input the frame came from, numbered by the caller
+
+  bool has_rssi() const { return !std::isnan(this->rssi_dbm); }
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
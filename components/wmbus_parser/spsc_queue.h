@@ -0,0 +1,68 @@
+/**
+ * Bounded lock-free single-producer/single-consumer ring of fixed-size slots.
+ *
+ * Slots are allocated once by init() and filled in place: the producer gets
+ * a slot with acquire(), writes it and hands it over with publish(); the
+ * consumer reads front() and releases it with pop(). Only the producer
+ * writes head_ and only the consumer writes tail_, so no locks are needed.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace esphome {
+namespace wmbus_parser {
+
+template<typename T> class SpscQueue {
+ public:
+  /// Allocate ``capacity`` slots, rounded up to a power of two. Not thread-safe;
+  /// call before producer and consumer start.
+  void init(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity)
+      size <<= 1;
+    this->slots_.reset(new T[size]);
+    this->mask_ = size - 1;
+    this->head_.store(0, std::memory_order_relaxed);
+    this->tail_.store(0, std::memory_order_relaxed);
+  }
+
+  bool is_initialized() const { return this->slots_ != nullptr; }
+  size_t capacity() const { return this->slots_ == nullptr ? 0 : this->mask_ + 1; }
+  size_t size() const {
+    return this->head_.load(std::memory_order_acquire) - this->tail_.load(std::memory_order_acquire);
+  }
+  bool full() const { return this->size() >= this->capacity(); }
+
+  /// Producer: next free slot, or nullptr if the queue is full.
+  T *acquire() {
+    uint32_t head = this->head_.load(std::memory_order_relaxed);
+    if (this->slots_ == nullptr || head - this->tail_.load(std::memory_order_acquire) > this->mask_)
+      return nullptr;
+    return &this->slots_[head & this->mask_];
+  }
+  /// Producer: make the slot returned by acquire() visible to the consumer.
+  void publish() { this->head_.store(this->head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  /// Consumer: oldest filled slot, or nullptr if the queue is empty.
+  T *front() {
+    uint32_t tail = this->tail_.load(std::memory_order_relaxed);
+    if (this->slots_ == nullptr || tail == this->head_.load(std::memory_order_acquire))
+      return nullptr;
+    return &this->slots_[tail & this->mask_];
+  }
+  /// Consumer: release the slot returned by front().
+  void pop() { this->tail_.store(this->tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+ protected:
+  std::unique_ptr<T[]> slots_;
+  uint32_t mask_{0};
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,144 @@
+/**
+ * Non-owning view of a received wM-Bus telegram.
+ *
+ * The view starts at the L-field: any C1 sync prefix (0x54 0x3D / 0x54 0xCD)
+ * is resolved when the view is created, so drivers can index the link layer
+ * directly. The underlying bytes must outlive the view; frames can come from
+ * a std::vector, the radio FIFO or a memory-mapped capture alike.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace esphome {
+namespace wmbus_parser {
+
+// Link layer field offsets relative to the L-field.
+static constexpr size_t TELEGRAM_L_FIELD = 0;
+static constexpr size_t TELEGRAM_C_FIELD = 1;
+static constexpr size_t TELEGRAM_M_FIELD = 2;
+static constexpr size_t TELEGRAM_ID_FIELD = 4;
+static constexpr size_t TELEGRAM_VERSION_FIELD = 8;
+static constexpr size_t TELEGRAM_TYPE_FIELD = 9;
+static constexpr size_t TELEGRAM_CI_FIELD = 10;
+static constexpr size_t TELEGRAM_LINK_HEADER_SIZE = 11;
+
+// Largest frame as received: C1 sync prefix, L = 255 and 17 frame format A
+// block CRCs (2 + 1 + 255 + 34).
+static constexpr size_t TELEGRAM_MAX_FRAME_SIZE = 292;
+
+/// Three-letter manufacturer code (EN 13757-3 "FLAG" id) of an M-field,
+/// written to ``out`` with a terminating NUL.
+inline void manufacturer_code(uint16_t m_field, char out[4]) {
+  out[0] = static_cast<char>('@' + ((m_field >> 10) & 0x1F));
+  out[1] = static_cast<char>('@' + ((m_field >> 5) & 0x1F));
+  out[2] = static_cast<char>('@' + (m_field & 0x1F));
+  out[3] = '\0';
+}
+
+/// M-field of a three-letter manufacturer code, e.g. manufacturer_field("MAD").
+/// The code must be three letters A-Z.
+constexpr uint16_t manufacturer_field(const char *code) {
+  return static_cast<uint16_t>(((code[0] - '@') << 10) | ((code[1] - '@') << 5) | (code[2] - '@'));
+}
+
+/// Setup-time parse of a manufacturer code in either case; false unless it is
+/// three letters.
+inline bool parse_manufacturer_code(const char *text, uint16_t &out) {
+  char code[3];
+  for (size_t i = 0; i < 3; i++) {
+    code[i] = static_cast<char>(text[i] & ~0x20);  // upper case; NUL stays NUL
+    if (code[i] < 'A' || code[i] > 'Z')
+      return false;
+  }
+  if (text[3] != '\0')
+    return false;
+  out = manufacturer_field(code);
+  return true;
+}
+
+// Device types (EN 13757-7 table 13) the built-in drivers read.
+static constexpr uint8_t DEVICE_TYPE_HEAT_OUTLET = 0x04;
+static constexpr uint8_t DEVICE_TYPE_WARM_WATER = 0x06;
+static constexpr uint8_t DEVICE_TYPE_WATER = 0x07;
+static constexpr uint8_t DEVICE_TYPE_HEAT_INLET = 0x0C;
+static constexpr uint8_t DEVICE_TYPE_HEAT_COOLING = 0x0D;
+static constexpr uint8_t DEVICE_TYPE_HOT_WATER = 0x15;
+static constexpr uint8_t DEVICE_TYPE_COLD_WATER = 0x16;
+
+inline bool has_c1_header(const uint8_t *frame, size_t len) {
+  return frame != nullptr && len >= 2 && frame[0] == 0x54 && (frame[1] == 0x3D || frame[1] == 0xCD);
+}
+
+class TelegramView {
+ public:
+  constexpr TelegramView() = default;
+  constexpr TelegramView(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+  /// Build a view over a received frame, skipping a C1 sync prefix if present.
+  static TelegramView from_frame(const uint8_t *frame, size_t len) {
+    if (has_c1_header(frame, len))
+      return TelegramView(frame + 2, len - 2);
+    return TelegramView(frame, len);
+  }
+  static TelegramView from_frame(const std::vector<uint8_t> &frame) {
+    return from_frame(frame.data(), frame.size());
+  }
+
+  const uint8_t *data() const { return this->data_; }
+  size_t size() const { return this->size_; }
+  bool empty() const { return this->size_ == 0; }
+  const uint8_t *begin() const { return this->data_; }
+  const uint8_t *end() const { return this->data_ + this->size_; }
+  uint8_t operator[](size_t index) const { return this->data_[index]; }
+
+  /// Sub-range starting at ``offset``; clamped to the end of the telegram.
+  TelegramView subview(size_t offset, size_t count = SIZE_MAX) const {
+    if (offset >= this->size_)
+      return TelegramView(this->end(), 0);
+    size_t remaining = this->size_ - offset;
+    return TelegramView(this->data_ + offset, count < remaining ? count : remaining);
+  }
+
+  /// Address field packed as read on air (little-endian), i.e. 0x23123046 for
+  /// meter "23123046". Requires at least TELEGRAM_ID_FIELD + 4 bytes.
+  uint32_t address() const {
+    const uint8_t *a = this->data_ + TELEGRAM_ID_FIELD;
+    return static_cast<uint32_t>(a[0]) | (static_cast<uint32_t>(a[1]) << 8) | (static_cast<uint32_t>(a[2]) << 16) |
+           (static_cast<uint32_t>(a[3]) << 24);
+  }
+
+  /// Link header fields; require a full link header (TELEGRAM_LINK_HEADER_SIZE).
+  uint16_t manufacturer() const {
+    return static_cast<uint16_t>(this->data_[TELEGRAM_M_FIELD] | (this->data_[TELEGRAM_M_FIELD + 1] << 8));
+  }
+  uint8_t version() const { return this->data_[TELEGRAM_VERSION_FIELD]; }
+  uint8_t device_type() const { return this->data_[TELEGRAM_TYPE_FIELD]; }
+
+ private:
+  const uint8_t *data_{nullptr};
+  size_t size_{0};
+};
+
+/// Link headers a driver reads, for picking the driver of a meter from its
+/// telegrams. HEADER_ANY matches every value of a field; M-fields never
+/// have the top bit set.
+static constexpr uint16_t HEADER_ANY = 0xFFFF;
+
+struct HeaderMatch {
+  uint16_t manufacturer;
+  uint16_t version;
+  uint16_t device_type;
+
+  /// Requires the link header up to the device type.
+  bool matches(const TelegramView &header) const {
+    return (this->manufacturer == HEADER_ANY || this->manufacturer == header.manufacturer()) &&
+           (this->version == HEADER_ANY || this->version == header.version()) &&
+           (this->device_type == HEADER_ANY || this->device_type == header.device_type());
+  }
+};
+
+}  // namespace wmbus_parser
+}  // namespace esphome
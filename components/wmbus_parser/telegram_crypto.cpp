@@ -0,0 +1,121 @@
+#include "telegram_crypto.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+// Transport header layout after the CI-field.
+struct TransportHeader {
+  size_t access_number;  // offset of the access number
+  size_t config;         // offset of the 2 byte configuration word
+  size_t payload;        // first (possibly encrypted) payload byte
+  size_t address;        // offset of the 8 byte ID/manufacturer/version/type used for the IV
+  bool long_header;
+};
+
+bool transport_header(const TelegramView &telegram, TransportHeader &header) {
+  if (telegram.size() <= TELEGRAM_CI_FIELD)
+    return false;
+  switch (telegram[TELEGRAM_CI_FIELD]) {
+    case CI_SHORT_HEADER:
+      header = {TELEGRAM_CI_FIELD + 1, TELEGRAM_CI_FIELD + 3, TELEGRAM_CI_FIELD + 5, TELEGRAM_M_FIELD, false};
+      break;
+    case CI_LONG_HEADER:
+      // ID(4) M(2) version type precede access number, status and config.
+      header = {TELEGRAM_CI_FIELD + 9, TELEGRAM_CI_FIELD + 11, TELEGRAM_CI_FIELD + 13, TELEGRAM_CI_FIELD + 1, true};
+      break;
+    default:
+      return false;
+  }
+  return telegram.size() >= header.payload;
+}
+
+}  // namespace
+
+const char *decrypt_result_to_string(DecryptResult result) {
+  switch (result) {
+    case DecryptResult::NOT_ENCRYPTED:
+      return "not_encrypted";
+    case DecryptResult::OK:
+      return "ok";
+    case DecryptResult::NO_KEY:
+      return "no_key";
+    case DecryptResult::BAD_KEY:
+      return "bad_key";
+    case DecryptResult::BAD_LENGTH:
+      return "bad_length";
+    case DecryptResult::UNSUPPORTED_MODE:
+      return "unsupported_mode";
+  }
+  return "unknown";
+}
+
+bool parse_aes_key(const std::string &text, uint8_t *out) {
+  if (text.size() != 2 * Aes128::KEY_SIZE)
+    return false;
+  for (size_t i = 0; i < Aes128::KEY_SIZE; i++) {
+    uint8_t byte = 0;
+    for (size_t j = 0; j < 2; j++) {
+      char c = text[2 * i + j];
+      uint8_t nibble;
+      if (c >= '0' && c <= '9') {
+        nibble = c - '0';
+      } else if (c >= 'A' && c <= 'F') {
+        nibble = c - 'A' + 10;
+      } else if (c >= 'a' && c <= 'f') {
+        nibble = c - 'a' + 10;
+      } else {
+        return false;
+      }
+      byte = static_cast<uint8_t>((byte << 4) | nibble);
+    }
+    out[i] = byte;
+  }
+  return true;
+}
+
+DecryptResult decrypt_telegram(const TelegramView &telegram, const Aes128 *cipher, uint8_t *out) {
+  TransportHeader header;
+  if (!transport_header(telegram, header))
+    return DecryptResult::NOT_ENCRYPTED;
+  const uint16_t config = static_cast<uint16_t>(telegram[header.config] | (telegram[header.config + 1] << 8));
+  const uint8_t mode = (config >> 8) & 0x1F;
+  if (mode == SECURITY_MODE_NONE)
+    return DecryptResult::NOT_ENCRYPTED;
+  if (mode != SECURITY_MODE_AES_CBC_IV)
+    return DecryptResult::UNSUPPORTED_MODE;
+  if (cipher == nullptr || !cipher->has_key())
+    return DecryptResult::NO_KEY;
+
+  size_t available = telegram.size() - header.payload;
+  size_t blocks = (config >> 4) & 0x0F;
+  if (blocks == 0)
+    blocks = available / Aes128::BLOCK_SIZE;
+  const size_t encrypted = blocks * Aes128::BLOCK_SIZE;
+  if (encrypted == 0 || encrypted > available)
+    return DecryptResult::BAD_LENGTH;
+
+  // IV: manufacturer, ID, version, type (in that order) and 8x access number.
+  uint8_t iv[Aes128::BLOCK_SIZE];
+  if (header.long_header) {
+    const size_t a = header.address;
+    memcpy(iv, telegram.data() + a + 4, 2);
+    memcpy(iv + 2, telegram.data() + a, 4);
+    memcpy(iv + 6, telegram.data() + a + 6, 2);
+  } else {
+    memcpy(iv, telegram.data() + header.address, 8);
+  }
+  memset(iv + 8, telegram[header.access_number], 8);
+
+  memcpy(out, telegram.data(), telegram.size());
+  cipher->decrypt_cbc(iv, out + header.payload, encrypted);
+  if (out[header.payload] != 0x2F || out[header.payload + 1] != 0x2F)
+    return DecryptResult::BAD_KEY;
+  return DecryptResult::OK;
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
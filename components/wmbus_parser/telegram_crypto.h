@@ -0,0 +1,45 @@
+/**
+ * Transport-layer decryption of wM-Bus telegrams.
+ *
+ * Supports security mode 5 (AES-128-CBC, IV from the manufacturer, address
+ * and access number) for the short (0x7A) and long (0x72) transport headers.
+ * The configuration word tells how many 16 byte blocks are encrypted; the
+ * plaintext must start with the 0x2F 0x2F verification filler.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "aes128.h"
+#include "telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+static constexpr uint8_t CI_SHORT_HEADER = 0x7A;
+static constexpr uint8_t CI_LONG_HEADER = 0x72;
+static constexpr uint8_t SECURITY_MODE_NONE = 0;
+static constexpr uint8_t SECURITY_MODE_AES_CBC_IV = 5;
+
+enum class DecryptResult : uint8_t {
+  NOT_ENCRYPTED = 0,  // telegram can be decoded as is
+  OK,                 // decrypted copy written to the output buffer
+  NO_KEY,
+  BAD_KEY,            // verification bytes did not decrypt to 0x2F 0x2F
+  BAD_LENGTH,         // fewer bytes than the configuration word announces
+  UNSUPPORTED_MODE,
+};
+
+const char *decrypt_result_to_string(DecryptResult result);
+
+/// Parse a 32 digit hexadecimal AES key.
+bool parse_aes_key(const std::string &text, uint8_t *out);
+
+/// Decrypt ``telegram`` into ``out`` (at least telegram.size() bytes). Only
+/// touches ``out`` when the telegram is encrypted.
+DecryptResult decrypt_telegram(const TelegramView &telegram, const Aes128 *cipher, uint8_t *out);
+
+}  // namespace wmbus_parser
+}  // namespace esphome
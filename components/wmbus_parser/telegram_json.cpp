@@ -0,0 +1,100 @@
+#include "telegram_json.h"
+
+#include <cstring>
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+class JsonWriter {
+ public:
+  JsonWriter(char *buf, size_t size) : buf_(buf), size_(size) {}
+
+  void raw(const char *text, size_t len) {
+    // One byte stays free for the terminating NUL.
+    if (this->overflow_ || len >= this->size_ - this->pos_) {
+      this->overflow_ = true;
+      return;
+    }
+    std::memcpy(this->buf_ + this->pos_, text, len);
+    this->pos_ += len;
+  }
+  void raw(char c) { this->raw(&c, 1); }
+
+  void string(const char *text) {
+    static const char HEX[] = "0123456789abcdef";
+    this->raw('"');
+    const char *run = text;
+    for (const char *p = text; *p != '\0'; p++) {
+      const auto c = static_cast<unsigned char>(*p);
+      if (c >= 0x20 && c != '"' && c != '\\')
+        continue;
+      this->raw(run, p - run);
+      if (c == '"' || c == '\\') {
+        const char escaped[] = {'\\', static_cast<char>(c)};
+        this->raw(escaped, sizeof(escaped));
+      } else {
+        const char escaped[] = {'\\', 'u', '0', '0', HEX[c >> 4], HEX[c & 0x0F]};
+        this->raw(escaped, sizeof(escaped));
+      }
+      run = p + 1;
+    }
+    this->raw(run, std::strlen(run));
+    this->raw('"');
+  }
+
+  size_t finish() {
+    if (this->size_ == 0)
+      return 0;
+    if (this->overflow_)
+      this->pos_ = 0;
+    this->buf_[this->pos_] = '\0';
+    return this->pos_;
+  }
+
+ protected:
+  char *buf_;
+  size_t size_;
+  size_t pos_{0};
+  bool overflow_{false};
+};
+
+// format_decimal() prints "nan" or "inf" for values a meter never sent;
+// JSON has no such numbers.
+bool is_json_number(const char *value) {
+  const char *digits = value[0] == '-' ? value + 1 : value;
+  return *digits >= '0' && *digits <= '9';
+}
+
+}  // namespace
+
+size_t format_telegram_json(char *buf, size_t size, const char *meter_id, const DecodedTelegram &telegram) {
+  JsonWriter out(buf, size);
+  out.raw('{');
+  bool first = true;
+  if (meter_id != nullptr) {
+    out.raw("\"meter_id\":", 11);
+    out.string(meter_id);
+    first = false;
+  }
+  telegram.for_each_attribute([&](const char *key, const char *value, AttributeKind kind) {
+    if (!first)
+      out.raw(',');
+    first = false;
+    out.string(key);
+    out.raw(':');
+    if (kind == AttributeKind::TEXT) {
+      out.string(value);
+    } else if (is_json_number(value)) {
+      out.raw(value, std::strlen(value));
+    } else {
+      out.raw("null", 4);
+    }
+  });
+  out.raw('}');
+  return out.finish();
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,30 @@
+/**
+ * JSON rendering of a decoded telegram into a caller-owned buffer.
+ *
+ * The on_decode attributes are text, so an automation that publishes JSON had
+ * to split every ``key=value`` entry and rebuild a document from the pieces.
+ * format_telegram_json() writes the object directly with the attribute keys
+ * and order: numeric fields as JSON numbers, dates, status and fabrication
+ * number as strings. Nothing is allocated.
+ */
+#pragma once
+
+#include <cstddef>
+
+#include "decoded_telegram.h"
+
+namespace esphome {
+namespace wmbus_parser {
+
+// Every presence bit plus the history slots, each with a key and a value at
+// their buffer limits; real telegrams need well under half of it.
+static constexpr size_t TELEGRAM_JSON_MAX_SIZE =
+    32 + (19 + DecodedTelegram::MAX_HISTORY) * (ATTRIBUTE_KEY_SIZE + ATTRIBUTE_VALUE_SIZE + 6);
+
+/// Write ``{"meter_id":"23123046","total_m3":16.59,...}`` to ``buf``,
+/// NUL-terminated. ``meter_id`` may be nullptr to leave it out. Returns the
+/// length, or 0 with an empty string if ``size`` is too small.
+size_t format_telegram_json(char *buf, size_t size, const char *meter_id, const DecodedTelegram &telegram);
+
+}  // namespace wmbus_parser
+}  // namespace esphome
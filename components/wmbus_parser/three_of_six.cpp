@@ -0,0 +1,71 @@
+#include "three_of_six.h"
+
+#include <array>
+
+namespace esphome {
+namespace wmbus_parser {
+
+namespace {
+
+// Symbol for each nibble (EN 13757-4 table 10).
+constexpr uint8_t SYMBOLS[16] = {0x16, 0x0D, 0x0E, 0x0B, 0x1C, 0x19, 0x1A, 0x13,
+                                 0x2C, 0x25, 0x26, 0x23, 0x34, 0x31, 0x32, 0x29};
+
+constexpr uint16_t INVALID = 0xFFFF;
+
+// Two symbols (12 bits) -> byte, or INVALID. 8 KiB of flash buys one lookup
+// per byte instead of two lookups, a shift and a validity check.
+constexpr std::array<uint16_t, 4096> make_decode_table() {
+  std::array<uint16_t, 4096> table{};
+  for (auto &entry : table)
+    entry = INVALID;
+  for (unsigned high = 0; high < 16; high++) {
+    for (unsigned low = 0; low < 16; low++)
+      table[(SYMBOLS[high] << 6) | SYMBOLS[low]] = static_cast<uint16_t>((high << 4) | low);
+  }
+  return table;
+}
+
+constexpr std::array<uint16_t, 4096> DECODE_TABLE = make_decode_table();
+
+}  // namespace
+
+bool decode_three_of_six(const uint8_t *raw, size_t decoded_len, uint8_t *out) {
+  // Three encoded bytes carry two decoded ones.
+  size_t i = 0;
+  for (; i + 2 <= decoded_len; i += 2, raw += 3) {
+    const uint16_t first = DECODE_TABLE[(raw[0] << 4) | (raw[1] >> 4)];
+    const uint16_t second = DECODE_TABLE[((raw[1] & 0x0F) << 8) | raw[2]];
+    if ((first | second) > 0xFF)
+      return false;
+    out[i] = static_cast<uint8_t>(first);
+    out[i + 1] = static_cast<uint8_t>(second);
+  }
+  if (i < decoded_len) {
+    const uint16_t last = DECODE_TABLE[(raw[0] << 4) | (raw[1] >> 4)];
+    if (last == INVALID)
+      return false;
+    out[i] = static_cast<uint8_t>(last);
+  }
+  return true;
+}
+
+void encode_three_of_six(const uint8_t *data, size_t len, uint8_t *out) {
+  size_t i = 0;
+  for (; i + 2 <= len; i += 2, out += 3) {
+    const uint32_t bits = (static_cast<uint32_t>(SYMBOLS[data[i] >> 4]) << 18) |
+                          (static_cast<uint32_t>(SYMBOLS[data[i] & 0x0F]) << 12) |
+                          (static_cast<uint32_t>(SYMBOLS[data[i + 1] >> 4]) << 6) | SYMBOLS[data[i + 1] & 0x0F];
+    out[0] = static_cast<uint8_t>(bits >> 16);
+    out[1] = static_cast<uint8_t>(bits >> 8);
+    out[2] = static_cast<uint8_t>(bits);
+  }
+  if (i < len) {
+    const uint16_t bits = static_cast<uint16_t>((SYMBOLS[data[i] >> 4] << 6) | SYMBOLS[data[i] & 0x0F]);
+    out[0] = static_cast<uint8_t>(bits >> 4);
+    out[1] = static_cast<uint8_t>(bits << 4);
+  }
+}
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -0,0 +1,30 @@
+/**
+ * 3-of-6 line code of wM-Bus T1 frames (EN 13757-4).
+ *
+ * Every data nibble is sent as a 6 bit symbol with exactly three bits set,
+ * high nibble first, so one byte becomes 12 bits and a frame grows by half.
+ * Only 16 of the 64 possible symbols are valid, which lets a receiver reject
+ * noise after the first few symbols.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace esphome {
+namespace wmbus_parser {
+
+/// Encoded size of ``decoded_len`` bytes, rounded up to whole bytes.
+constexpr size_t three_of_six_encoded_size(size_t decoded_len) { return (3 * decoded_len + 1) / 2; }
+
+/// Decode ``decoded_len`` bytes from ``raw`` (at least
+/// three_of_six_encoded_size(decoded_len) bytes). Stops at the first invalid
+/// symbol and returns false.
+bool decode_three_of_six(const uint8_t *raw, size_t decoded_len, uint8_t *out);
+
+/// Encode ``len`` bytes into three_of_six_encoded_size(len) bytes of ``out``;
+/// a trailing half byte is padded with zero bits.
+void encode_three_of_six(const uint8_t *data, size_t len, uint8_t *out);
+
+}  // namespace wmbus_parser
+}  // namespace esphome
@@ -1,134 +1,1045 @@
 #include "wmbus_parser.h"
 #include "esphome/core/log.h"
 #include "evo868_driver.h"
+#include "frame_check.h"
+#include "hex_encode.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <ctime>
 
-namespace {
+namespace esphome {
+namespace wmbus_parser {
+
+static const char *TAG = "wmbus_parser";
 
-std::string format_raw_hex(const std::vector<uint8_t> &raw) {
-  std::string hex;
-  hex.reserve(raw.size() * 3);
-  char buf[4];
-  for (size_t i = 0; i < raw.size(); ++i) {
-    snprintf(buf, sizeof(buf), "%02X", raw[i]);
-    hex += buf;
+// Capture bytes handed to the sink per write.
+static constexpr size_t CAPTURE_DRAIN_CHUNK = 512;
+static_assert(CAPTURE_DRAIN_CHUNK >= CAPTURE_RECORD_HEADER_SIZE + FRAME_MAX_T1_SIZE,
+              "drain chunk must hold the largest record");
+
+static bool raw_level_matches(RawLogLevel level, uint8_t flags) {
+  switch (level) {
+    case RAW_LOG_LEVEL_ALL:
+      return true;
+    case RAW_LOG_LEVEL_VALID_C1_HEADER:
+      return flags & CAPTURE_FLAG_C1_HEADER;
+    case RAW_LOG_LEVEL_MATCHING_METER_ID:
+      return flags & CAPTURE_FLAG_METER_MATCH;
+    default:
+      return false;
   }
-  return hex;
 }
 
-}  // namespace
+uint32_t WMBusMeter::address() const { return this->is_valid() ? this->parent_->meters_.address[this->slot_] : 0; }
 
-namespace esphome {
-namespace wmbus_parser {
+std::string WMBusMeter::meter_id() const {
+  char id[9];
+  format_meter_id(this->address(), id);
+  return id;
+}
 
-static const char *TAG = "wmbus_parser";
+const char *WMBusMeter::driver() const {
+  if (!this->is_valid())
+    return "";
+  const uint8_t driver = this->parent_->meters_.driver[this->slot_];
+  return driver < MeterTable::DRIVER_NONE ? driver_at(driver).name : "auto";
+}
 
-WMBusMeter::WMBusMeter(const std::string &meter_id, const std::string &driver)
-    : WMBusMeter(meter_id, meter_id, driver) {}
+bool WMBusMeter::is_auto_detected() const {
+  return this->is_valid() && (this->parent_->meters_.flags[this->slot_] & MeterTable::FLAG_AUTO_DETECTED);
+}
 
-WMBusMeter::WMBusMeter(const std::string &id, const std::string &meter_id, const std::string &driver)
-    : id_(id), meter_id_(meter_id), driver_(driver) {}
+void WMBusMeter::set_total_m3(sensor::Sensor *sensor) {
+  if (this->is_valid())
+    this->parent_->meters_.total_m3_sensor[this->slot_] = sensor;
+}
 
-void WMBusMeter::set_parent(WMBusParser *parent) { this->parent_ = parent; }
+void WMBusMeter::set_min_publish_interval(uint32_t interval_ms) {
+  if (this->is_valid())
+    this->parent_->meters_.throttle[this->slot_].min_interval_ms = interval_ms;
+}
 
-void WMBusMeter::set_total_m3(sensor::Sensor *sensor) { this->total_m3_sensor_ = sensor; }
+void WMBusMeter::set_total_m3_threshold(float threshold) {
+  if (this->is_valid())
+    this->parent_->meters_.throttle[this->slot_].threshold = threshold;
+}
+
+void WMBusMeter::set_last_seen(sensor::Sensor *sensor) {
+  if (this->is_valid())
+    this->parent_->meters_.last_seen_sensor[this->slot_] = sensor;
+}
 
-bool WMBusMeter::decode_packet(const std::vector<uint8_t> &raw, std::map<std::string, std::string> &attrs, float &value) {
-  auto decode_fn = DriverRegistry::instance().find(this->driver_);
-  if (decode_fn == nullptr) {
-    ESP_LOGW(TAG, "Driver not supported: %s", this->driver_.c_str());
+bool WMBusMeter::set_key(const std::string &key) {
+  if (!this->is_valid())
     return false;
+  uint8_t raw[Aes128::KEY_SIZE];
+  bool ok = parse_aes_key(key, raw);
+  if (ok) {
+    auto cipher = std::unique_ptr<Aes128>(new Aes128());
+    cipher->set_key(raw);
+    this->parent_->meters_.cipher[this->slot_] = std::move(cipher);
+  } else {
+    ESP_LOGE(TAG, "Invalid key for meter %08X (expected 32 hex digits)", static_cast<unsigned>(this->address()));
   }
-  return decode_fn(raw, attrs, value);
+  volatile uint8_t *wipe = raw;
+  for (size_t i = 0; i < sizeof(raw); i++)
+    wipe[i] = 0;
+  return ok;
+}
+
+bool WMBusMeter::has_key() const { return this->is_valid() && this->parent_->meters_.cipher[this->slot_] != nullptr; }
+
+const MeterStats &WMBusMeter::stats() const {
+  static const MeterStats EMPTY;
+  return this->is_valid() ? this->parent_->meters_.stats[this->slot_] : EMPTY;
+}
+
+const DecodedTelegram *WMBusMeter::last_state() const {
+  if (!this->is_valid())
+    return nullptr;
+  const MeterTable &table = this->parent_->meters_;
+  if (table.has_last_column() && (table.flags[this->slot_] & MeterTable::FLAG_HAS_LAST))
+    return &table.last[this->slot_];
+  return nullptr;
 }
 
-void WMBusMeter::handle_packet(const std::vector<uint8_t> &raw) {
-  std::map<std::string, std::string> attrs;
-  float main_value = NAN;
+const ReadingHistory *WMBusMeter::history() const {
+  if (!this->is_valid() || !this->parent_->meters_.has_history_column())
+    return nullptr;
+  return &this->parent_->meters_.history[this->slot_];
+}
 
-  if (!this->decode_packet(raw, attrs, main_value)) {
-    ESP_LOGW(TAG, "Failed to decode packet for meter %s", this->meter_id_.c_str());
+bool WMBusParser::decode_meter_(uint16_t slot, const TelegramView &telegram, DecodedTelegram &result,
+                                FailureReason &failure) {
+  MeterStats &stats = this->meters_.stats[slot];
+  const uint32_t address = this->meters_.address[slot];
+  uint8_t plain[TELEGRAM_MAX_FRAME_SIZE];
+  TelegramView payload = telegram;
+  DecryptResult crypt = telegram.size() <= sizeof(plain)
+                            ? decrypt_telegram(telegram, this->meters_.cipher[slot].get(), plain)
+                            : DecryptResult::BAD_LENGTH;
+  if (crypt == DecryptResult::OK) {
+    payload = TelegramView(plain, telegram.size());
+  } else if (crypt != DecryptResult::NOT_ENCRYPTED) {
+    ESP_LOGD(TAG, "Cannot decrypt telegram for meter %08X: %s", static_cast<unsigned>(address),
+             decrypt_result_to_string(crypt));
+    stats.failed++;
+    failure = failure_reason_from(crypt);
+    return false;
+  }
+
+  if (!driver_at(this->meters_.driver[slot]).decode(payload, result)) {
+    ESP_LOGD(TAG, "Failed to decode packet for meter %08X", static_cast<unsigned>(address));
+    stats.failed++;
+    failure = FailureReason::DRIVER;
+    return false;
+  }
+  stats.decoded++;
+  return true;
+}
+
+void WMBusParser::publish_meter_(uint16_t slot, const DecodedTelegram &decoded) {
+  char meter_id_text[9];
+  format_meter_id(this->meters_.address[slot], meter_id_text);
+  if (this->meters_.total_m3_sensor[slot] != nullptr) {
+    this->publish_sensor_(slot, decoded.total_m3);
+  } else {
+    ESP_LOGI(TAG, "Meter %s decoded (no sensor): total=%.3f", meter_id_text, decoded.total_m3);
+  }
+  if (this->meters_.has_history_column())
+    this->meters_.history[slot].append(decoded.timestamp, decoded.total_m3, this->history_interval_ms_ / 1000);
+
+  // Eight characters fit the small-string buffer, so this does not allocate.
+  const std::string meter_id(meter_id_text);
+  this->fire_on_decode(meter_id, decoded);
+  this->fire_on_decode_json(meter_id, decoded);
+  if (this->meters_.has_last_column()) {
+    if (this->has_change_triggers())
+      this->publish_changes_(slot, decoded);
+    this->meters_.last[slot] = decoded;
+    this->meters_.flags[slot] |= MeterTable::FLAG_HAS_LAST;
+  }
+}
+
+void WMBusParser::publish_sensor_(uint16_t slot, float total_m3) {
+  SensorThrottle &throttle = this->meters_.throttle[slot];
+  uint8_t &flags = this->meters_.flags[slot];
+  const uint32_t now = millis();
+  // The threshold is measured from the last published state, so slow
+  // consumption still adds up to an update.
+  if ((flags & MeterTable::FLAG_SENSOR_PUBLISHED) &&
+      (now - throttle.published_ms < throttle.min_interval_ms ||
+       std::fabs(total_m3 - throttle.value) < throttle.threshold)) {
+    this->meters_.stats[slot].throttled++;
+    return;
+  }
+  this->meters_.total_m3_sensor[slot]->publish_state(total_m3);
+  flags |= MeterTable::FLAG_SENSOR_PUBLISHED;
+  throttle.value = total_m3;
+  throttle.published_ms = now;
+}
+
+void WMBusParser::publish_changes_(uint16_t slot, const DecodedTelegram &decoded) {
+  uint16_t history_changed = decoded.history_present;
+  uint32_t changed = decoded.present;
+  if (this->meters_.flags[slot] & MeterTable::FLAG_HAS_LAST)
+    changed = decoded.changed_fields(this->meters_.last[slot], history_changed);
+  changed &= ~(FIELD_CLOCK_MASK | FIELD_RECEPTION_MASK);
+  if (changed == 0 && history_changed == 0) {
+    this->meters_.stats[slot].unchanged++;
     return;
   }
+  // The receive timestamp tells consumers when the change was seen.
+  DecodedTelegram changes = decoded;
+  changes.keep_only(changed | FIELD_TIMESTAMP, history_changed);
+  char meter_id[9];
+  format_meter_id(this->meters_.address[slot], meter_id);
+  this->fire_on_change(meter_id, changes);
+}
 
-  if (this->total_m3_sensor_ != nullptr) {
-    this->total_m3_sensor_->publish_state(main_value);
-    // if (!attrs.empty()) {
-    //   for (const auto &kv : attrs) {
-    //     ESP_LOGD(TAG, "  %s: %s", kv.first.c_str(), kv.second.c_str());
-    //   }
-    // }
+WMBusMeter *WMBusParser::add_meter(const std::string &meter_id, const std::string &driver) {
+  uint16_t slot = MeterIndex::NOT_FOUND;
+  uint32_t address;
+  const bool detect = driver == "auto";
+  const DriverEntry *entry = detect ? nullptr : find_driver(driver);
+  if (!parse_meter_id(meter_id, address)) {
+    ESP_LOGE(TAG, "Invalid meter_id '%s' (expected 8 hex digits)", meter_id.c_str());
+  } else if (this->meters_.size() >= MeterIndex::NOT_FOUND) {
+    ESP_LOGE(TAG, "Too many meters, ignoring %s", meter_id.c_str());
+  } else if (entry == nullptr && !detect) {
+    ESP_LOGE(TAG, "Driver '%s' for meter %s is not built in", driver.c_str(), meter_id.c_str());
   } else {
-    ESP_LOGI(TAG, "Meter %s decoded (no sensor): total=%.3f", this->meter_id_.c_str(), main_value);
+    slot = this->meters_.add(address, detect ? MeterTable::DRIVER_AUTO : static_cast<uint8_t>(entry - &driver_at(0)));
+    this->meter_index_.insert(address, slot);
+    this->pending_slots_.reserve(this->meters_.size());
+    ESP_LOGI(TAG, "Added meter %s driver=%s", meter_id.c_str(), detect ? "auto" : entry->name);
+  }
+  this->handles_.emplace_back(this, slot);
+  return &this->handles_.back();
+}
+
+void WMBusParser::reserve_meters(size_t count) { this->meters_.reserve(count); }
+
+bool WMBusParser::add_auto_manufacturer(const std::string &code) {
+  uint16_t manufacturer;
+  if (!parse_manufacturer_code(code.c_str(), manufacturer)) {
+    ESP_LOGE(TAG, "Invalid manufacturer '%s' (expected three letters)", code.c_str());
+    return false;
   }
+  if (!this->is_auto_manufacturer_(manufacturer))
+    this->auto_manufacturers_.push_back(manufacturer);
+  return true;
+}
 
-  AttributeList attr_list;
-  attr_list.reserve(attrs.size());
-  for (const auto &kv : attrs) {
-    attr_list.emplace_back(kv.first + "=" + kv.second);
+void WMBusParser::setup() {
+  this->arena_.init(this->arena_size_);
+  this->foreign_.init(this->foreign_table_size_);
+  if (this->raw_capture_level_ != RAW_LOG_LEVEL_NONE)
+    this->capture_.init(this->capture_size_);
+  if (this->decode_worker_) {
+    this->rx_queue_.init(this->queue_size_);
+    this->results_.init(this->queue_size_);
+    // Without a worker the queue is still used and drained from loop().
+    this->worker_.start(&WMBusParser::drain_queue_entry_, this);
+  }
+  if (this->publish_interval_ms_ > 0)
+    this->batch_.reserve(this->publish_batch_size_);
+  // The latency sensor is computed from the stage timings.
+  this->stage_timing_ |= this->latency_sensor_ != nullptr;
+  if (this->stage_timing_)
+    this->traces_.init(this->trace_size_);
+  if (!this->json_triggers_.empty())
+    this->json_buffer_.reset(new char[TELEGRAM_JSON_MAX_SIZE]);
+  this->has_metric_sensors_ = this->received_sensor_ != nullptr || this->decoded_sensor_ != nullptr ||
+                              this->failed_sensor_ != nullptr || this->duplicates_sensor_ != nullptr ||
+                              this->unknown_id_sensor_ != nullptr || this->decode_time_sensor_ != nullptr ||
+                              this->latency_sensor_ != nullptr;
+  for (auto *sensor : this->meters_.last_seen_sensor)
+    this->has_metric_sensors_ |= sensor != nullptr;
+  if (this->has_change_triggers() || this->publish_interval_ms_ > 0)
+    this->meters_.keep_last();
+  if (this->publish_interval_ms_ > 0)
+    this->meters_.keep_pending();
+  if (this->history_size_ > 0)
+    this->meters_.keep_history();
+  if (!this->auto_manufacturers_.empty()) {
+    // Detected meters are appended while the decode task reads the table.
+    this->auto_meter_limit_ = std::min<size_t>(this->auto_meter_limit_, MeterIndex::NOT_FOUND - this->meters_.size());
+    this->meters_.reserve(this->meters_.size() + this->auto_meter_limit_);
+    this->pending_slots_.reserve(this->meters_.size() + this->auto_meter_limit_);
   }
-  if (this->parent_ != nullptr) {
-    this->parent_->fire_on_decode(this->meter_id_, main_value, attr_list);
+  if (this->history_size_ > 0) {
+    for (size_t slot = 0; slot < this->meters_.size(); slot++)
+      this->init_history_(slot);
   }
 }
 
-void WMBusParser::add_meter(WMBusMeter *meter) {
-  meter->set_parent(this);
-  this->meters_.push_back(meter);
-  ESP_LOGI(TAG, "Added meter id=%s meter_id=%s driver=%s", meter->id_.c_str(), meter->meter_id_.c_str(), meter->driver_.c_str());
+void WMBusParser::init_history_(uint16_t slot) {
+  ReadingHistory &history = this->meters_.history[slot];
+  history.init(this->history_size_);
+  if (history.load(this->meters_.address[slot])) {
+    char meter_id[9];
+    format_meter_id(this->meters_.address[slot], meter_id);
+    ESP_LOGD(TAG, "Restored %u readings of meter %s", static_cast<unsigned>(history.size()), meter_id);
+  }
 }
 
+void WMBusParser::loop() {
+  if (this->capture_sink_ != nullptr && this->capture_.records() > 0)
+    this->drain_capture_();
+  if (this->rx_queue_.is_initialized()) {
+    if (!this->worker_.is_running())
+      this->drain_queue_();
+    while (ResultSlot *result = this->results_.front()) {
+      this->metrics_.record_decode(result->trace);
+      if (result->meter != MeterIndex::NOT_FOUND)
+        this->publish_(result->meter, result->telegram, result->trace, result->allocations);
+      this->results_.pop();
+    }
+  }
+  if (this->publish_interval_ms_ > 0)
+    this->flush_pending_();
+  if (this->history_replaying_)
+    this->replay_history_step_();
+  if (this->meters_.has_history_column() && millis() - this->last_history_save_ms_ >= this->history_save_interval_ms_) {
+    this->last_history_save_ms_ = millis();
+    this->save_history();
+  }
+  if (this->foreign_report_interval_ms_ > 0 && this->foreign_.is_enabled() &&
+      millis() - this->last_foreign_report_ms_ >= this->foreign_report_interval_ms_)
+    this->report_foreign_meters_();
+  if (this->has_metric_sensors_ && millis() - this->last_metrics_ms_ >= this->metrics_interval_ms_)
+    this->publish_metrics_();
+}
+
+void WMBusParser::dump_config() {
+  ESP_LOGCONFIG(TAG, "wM-Bus parser:");
+  ESP_LOGCONFIG(TAG, "  Meters: %u", static_cast<unsigned>(this->meters_.size()));
+  if (!this->auto_manufacturers_.empty()) {
+    char codes[4 * 8] = "";
+    size_t pos = 0;
+    for (size_t i = 0; i < this->auto_manufacturers_.size() && pos + 4 < sizeof(codes); i++) {
+      if (i > 0)
+        codes[pos++] = ' ';
+      manufacturer_code(this->auto_manufacturers_[i], codes + pos);
+      pos += 3;
+    }
+    ESP_LOGCONFIG(TAG, "  Auto-detect: meters from %s, %u of %u added, %u IDs without driver", codes,
+                  static_cast<unsigned>(this->auto_meters_), static_cast<unsigned>(this->auto_meter_limit_),
+                  static_cast<unsigned>(this->undecodable_.size()));
+  }
+  if (this->foreign_.is_enabled()) {
+    ESP_LOGCONFIG(TAG, "  Unknown meters: %u of %u slots, %u frames, reported every %u s",
+                  static_cast<unsigned>(this->foreign_.size()), static_cast<unsigned>(this->foreign_.capacity()),
+                  static_cast<unsigned>(this->foreign_.frames()),
+                  static_cast<unsigned>(this->foreign_report_interval_ms_ / 1000));
+  }
+  ESP_LOGCONFIG(TAG, "  Duplicate window: %u ms", static_cast<unsigned>(this->duplicate_window_ms_));
+  ESP_LOGCONFIG(TAG, "  CRC check: %s", this->check_crc_ ? "enabled" : "disabled");
+  ESP_LOGCONFIG(TAG, "  Link modes: %s", this->t1_mode_ ? "C1, T1" : "C1");
+  const ParserMetrics m = this->metrics();
+  ESP_LOGCONFIG(TAG, "  Frames: received %u, decoded %u, duplicates %u, unknown id %u, failed %u",
+                static_cast<unsigned>(m.received), static_cast<unsigned>(m.decoded),
+                static_cast<unsigned>(m.duplicates), static_cast<unsigned>(m.unknown_id),
+                static_cast<unsigned>(m.failed()));
+  if (m.early_drops > 0)
+    ESP_LOGCONFIG(TAG, "    dropped on an unchecked header: %u", static_cast<unsigned>(m.early_drops));
+  for (size_t i = 0; i < FAILURE_REASON_COUNT; i++) {
+    if (m.failures[i] > 0)
+      ESP_LOGCONFIG(TAG, "    %s: %u", failure_reason_to_string(static_cast<FailureReason>(i)),
+                    static_cast<unsigned>(m.failures[i]));
+  }
+  if (m.decode_time.count() > 0) {
+    ESP_LOGCONFIG(TAG, "  Decode time: mean %u us, p95 %u us, max %u us", static_cast<unsigned>(m.decode_time.mean_us()),
+                  static_cast<unsigned>(m.decode_time.percentile_us(0.95f)),
+                  static_cast<unsigned>(m.decode_time.max_us()));
+  }
+  if (m.end_to_end.count() > 0) {
+    ESP_LOGCONFIG(TAG, "  Latency (p50/p95/max): %u/%u/%u us from reception to publication",
+                  static_cast<unsigned>(m.end_to_end.percentile_us(0.5f)),
+                  static_cast<unsigned>(m.end_to_end.percentile_us(0.95f)), static_cast<unsigned>(m.end_to_end.max_us()));
+    for (size_t i = 0; i < TRACE_STAGE_COUNT; i++) {
+      const LatencyHistogram &stage = m.stage_time[i];
+      if (stage.count() == 0)
+        continue;
+      ESP_LOGCONFIG(TAG, "    %s: %u/%u/%u us", trace_stage_to_string(static_cast<TraceStage>(i)),
+                    static_cast<unsigned>(stage.percentile_us(0.5f)), static_cast<unsigned>(stage.percentile_us(0.95f)),
+                    static_cast<unsigned>(stage.max_us()));
+    }
+  }
+  if (this->stage_timing_)
+    ESP_LOGCONFIG(TAG, "  Stage timing: enabled, traces of the last %u telegrams",
+                  static_cast<unsigned>(this->traces_.capacity()));
+  if (this->rx_queue_.is_initialized()) {
+    const auto &q = this->queue_stats_;
+    ESP_LOGCONFIG(TAG, "  Receive queue: %u slots, %s", static_cast<unsigned>(this->rx_queue_.capacity()),
+                  this->worker_.is_running() ? "decode task" : "decoded in loop()");
+    ESP_LOGCONFIG(TAG, "    Enqueued %u, max depth %u, overflows %u, result overflows %u",
+                  static_cast<unsigned>(q.enqueued), static_cast<unsigned>(q.max_depth),
+                  static_cast<unsigned>(q.overflows), static_cast<unsigned>(q.result_overflows));
+    if (this->worker_.is_running() && this->worker_.stack_size() > 0)
+      ESP_LOGCONFIG(TAG, "    Decode task stack: %u bytes, at least %u never used so far",
+                    static_cast<unsigned>(this->worker_.stack_size()),
+                    static_cast<unsigned>(this->worker_.stack_free_min()));
+  }
+  if (this->publish_interval_ms_ > 0) {
+    const auto &p = this->publish_stats_;
+    ESP_LOGCONFIG(TAG, "  Publish interval: %u ms, %u meters per batch",
+                  static_cast<unsigned>(this->publish_interval_ms_), static_cast<unsigned>(this->publish_batch_size_));
+    ESP_LOGCONFIG(TAG, "    Staged %u, coalesced %u, flushes %u, batches %u", static_cast<unsigned>(p.staged),
+                  static_cast<unsigned>(p.coalesced), static_cast<unsigned>(p.flushes), static_cast<unsigned>(p.batches));
+  }
+  if (this->meters_.has_history_column() && !this->meters_.history.empty()) {
+    size_t readings = 0, unsent = 0, used = 0;
+    uint32_t lost = 0;
+    for (const auto &history : this->meters_.history) {
+      readings += history.size();
+      unsent += history.unsent();
+      used += history.bytes_used();
+      lost += history.lost();
+    }
+    ESP_LOGCONFIG(TAG, "  History: %u bytes per meter, one reading per %u s, saved every %u s",
+                  static_cast<unsigned>(this->meters_.history.front().capacity()),
+                  static_cast<unsigned>(this->history_interval_ms_ / 1000),
+                  static_cast<unsigned>(this->history_save_interval_ms_ / 1000));
+    ESP_LOGCONFIG(TAG, "    %u readings in %u bytes, %u not replayed, %u lost", static_cast<unsigned>(readings),
+                  static_cast<unsigned>(used), static_cast<unsigned>(unsent), static_cast<unsigned>(lost));
+  }
+  if (this->capture_.is_enabled()) {
+    ESP_LOGCONFIG(TAG, "  Raw capture: %u bytes, %u frames captured, %u dropped%s",
+                  static_cast<unsigned>(this->capture_.capacity()), static_cast<unsigned>(this->capture_.appended()),
+                  static_cast<unsigned>(this->capture_.dropped()), this->capture_sink_ != nullptr ? ", sink attached" : "");
+  }
+  ESP_LOGCONFIG(TAG, "  Arena: %u bytes (high water %u, overflows %u)", static_cast<unsigned>(this->arena_.capacity()),
+                static_cast<unsigned>(this->arena_.high_water()), static_cast<unsigned>(this->arena_.overflows()));
+  if (ALLOC_COUNTING_ENABLED) {
+    const auto &stats = this->allocation_stats_;
+    ESP_LOGCONFIG(TAG, "  Heap allocations (%s): %llu in %u telegrams (max %u per telegram, %u telegrams allocated)",
+                  ALLOC_COUNTING_SEES_MALLOC ? "malloc" : "operator new only",
+                  static_cast<unsigned long long>(stats.allocations), static_cast<unsigned>(stats.telegrams),
+                  static_cast<unsigned>(stats.max_per_telegram), static_cast<unsigned>(stats.telegrams_with_allocations));
+  }
+}
+
+void WMBusParser::on_safe_shutdown() { this->save_history(); }
+
 void WMBusParser::set_raw_log_level(RawLogLevel level) { this->raw_log_level_ = level; }
 
-void WMBusParser::receive_packet(const std::vector<uint8_t> &raw) {
-  if (raw.size() < 10) {
-    ESP_LOGW(TAG, "Packet too short");
+void WMBusParser::receive_packet(const std::vector<uint8_t> &raw) { this->receive_packet(raw.data(), raw.size()); }
+
+void WMBusParser::receive_packet(const std::vector<uint8_t> &raw, float rssi_dbm, float snr_db) {
+  ReceiveInfo info;
+  info.rssi_dbm = rssi_dbm;
+  info.snr_db = snr_db;
+  this->receive_packet(raw.data(), raw.size(), info);
+}
+
+void WMBusParser::receive_packet(const uint8_t *raw, size_t len) { this->receive_packet(raw, len, ReceiveInfo()); }
+
+void WMBusParser::receive_packet(const uint8_t *raw, size_t len, const ReceiveInfo &info) {
+  TelegramTrace trace;
+  trace.start(info);
+  if (this->stage_timing_ && info.received_us == 0)
+    trace.start_now(micros());
+  this->metrics_.received++;
+  if (raw == nullptr || len > (this->t1_mode_ ? FRAME_MAX_T1_SIZE : TELEGRAM_MAX_FRAME_SIZE)) {
+    this->metrics_.count_failure(FailureReason::OVERSIZED);
+    return;
+  }
+
+  // Link-layer pre-stage: only frames with a consistent L-field and valid
+  // block CRCs reach the ID lookup, stripped of the sync prefix and CRCs.
+  uint8_t frame[TELEGRAM_MAX_FRAME_SIZE];
+  const uint8_t *payload = frame;
+  size_t payload_len = 0;
+  bool t1 = false;
+  FrameError error;
+  if (this->t1_mode_) {
+    error = check_c1_or_t1_frame(raw, len, frame, payload_len, t1);
+  } else if (this->check_crc_) {
+    error = check_frame(raw, len, frame, payload_len);
+  } else {
+    const TelegramView view = TelegramView::from_frame(raw, len);
+    payload = view.data();
+    payload_len = view.size();
+    error = payload_len < FRAME_MIN_PAYLOAD ? FrameError::TOO_SHORT : FrameError::NONE;
+  }
+  this->lap_(trace, TraceStage::LINK_CHECK);
+
+  this->handle_frame_(raw, len, payload, payload_len, error, t1, trace);
+}
+
+bool WMBusParser::feed(const uint8_t *data, size_t len, const ReceiveInfo &info) {
+  if (len > 0 && !this->stream_.started()) {
+    this->metrics_.received++;
+    // A streamed frame is received from its first byte on, so its link
+    // check stage includes the air time.
+    this->stream_trace_.start(info);
+    if (this->stage_timing_ && info.received_us == 0)
+      this->stream_trace_.start_now(micros());
+  }
+  while (len > 0 && !this->stream_.finished()) {
+    FrameStream::Event event;
+    const size_t used = this->stream_.feed(data, len, event);
+    data += used;
+    len -= used;
+    switch (event) {
+      case FrameStream::Event::HEADER:
+        this->check_stream_header_();
+        break;
+      case FrameStream::Event::FRAME:
+        this->lap_(this->stream_trace_, TraceStage::LINK_CHECK);
+        this->handle_frame_(this->stream_.raw(), this->stream_.raw_size(), this->stream_.payload().data(),
+                            this->stream_.payload().size(), FrameError::NONE, this->stream_.is_t1(),
+                            this->stream_trace_);
+        break;
+      case FrameStream::Event::ERROR:
+        this->handle_frame_(this->stream_.raw(), this->stream_.raw_size(), nullptr, 0, this->stream_.error(),
+                            this->stream_.is_t1(), this->stream_trace_);
+        break;
+      case FrameStream::Event::NONE:
+        break;
+    }
+  }
+  return !this->stream_.finished();
+}
+
+void WMBusParser::end_frame() {
+  if (this->stream_.started() && !this->stream_.finished())
+    this->handle_frame_(this->stream_.raw(), this->stream_.raw_size(), nullptr, 0, FrameError::TRUNCATED,
+                        this->stream_.is_t1(), this->stream_trace_);
+  this->stream_.reset();
+}
+
+void WMBusParser::check_stream_header_() {
+  const TelegramView header = this->stream_.payload();
+  // The header may not be covered by a CRC yet, so a new wildcard ID is left
+  // for handle_frame_ to add once the frame has passed its checks.
+  if (this->meter_index_.find(header.address()) != MeterIndex::NOT_FOUND ||
+      this->is_auto_manufacturer_(header.manufacturer()))
+    return;
+  // Raw logging or capture of foreign frames needs the whole frame.
+  const uint8_t flags = (this->stream_.has_c1_header() ? CAPTURE_FLAG_C1_HEADER : 0) |
+                        (this->stream_.is_t1() ? CAPTURE_FLAG_T1 : 0);
+  if (raw_level_matches(this->raw_log_level_, flags) ||
+      (this->capture_.is_enabled() && raw_level_matches(this->raw_capture_level_, flags)))
     return;
+  // An unchecked header may be a bit error rather than a foreign meter, so
+  // it is kept out of the unknown ID count and the foreign meter table.
+  if (this->stream_.header_checked()) {
+    this->metrics_.unknown_id++;
+    this->foreign_.record(header, millis());
+  } else {
+    this->metrics_.early_drops++;
   }
-  size_t offset = 0;
-  bool has_c1_header = raw.size() >= 2 && raw[0] == 0x54 && (raw[1] == 0x3D || raw[1] == 0xCD);
+  this->stream_.drop();
+}
 
-  if (this->raw_log_level_ == RAW_LOG_LEVEL_ALL || (this->raw_log_level_ == RAW_LOG_LEVEL_VALID_C1_HEADER && has_c1_header)) {
-    std::string hex = format_raw_hex(raw);
-    const char *suffix = has_c1_header ? " (valid C1 header)" : "";
-    ESP_LOGD(TAG, "Raw telegram%s: %s", suffix, hex.c_str());
+void WMBusParser::handle_frame_(const uint8_t *raw, size_t len, const uint8_t *payload, size_t payload_len,
+                                FrameError error, bool t1, TelegramTrace &trace) {
+  if (this->raw_log_level_ != RAW_LOG_LEVEL_NONE || this->capture_.is_enabled())
+    this->record_raw_(raw, len, error == FrameError::NONE ? payload : nullptr, payload_len, t1);
+  if (error != FrameError::NONE) {
+    this->metrics_.count_failure(failure_reason_from(error));
+    ESP_LOGV(TAG, "Dropping frame (%u bytes): %s", static_cast<unsigned>(len), frame_error_to_string(error));
+    return;
   }
 
-  if (has_c1_header)
-    offset = 2;
+  // Foreign meters are dropped here, before they take a queue slot.
+  const TelegramView telegram(payload, payload_len);
+  const uint16_t slot = this->lookup_meter_(telegram);
+  this->lap_(trace, TraceStage::ID_LOOKUP);
+  if (slot == MeterIndex::NOT_FOUND) {
+    this->metrics_.unknown_id++;
+    this->foreign_.record(telegram, millis());
+    ESP_LOGV(TAG, "No registered meter found for id %08X", static_cast<unsigned>(telegram.address()));
+    return;
+  }
+  if (this->meters_.driver[slot] >= MeterTable::DRIVER_NONE && !this->detect_driver_(slot, telegram)) {
+    MeterStats &stats = this->meters_.stats[slot];
+    stats.received++;
+    stats.failed++;
+    stats.last_seen_ms = millis();
+    this->metrics_.count_failure(FailureReason::NO_DRIVER);
+    return;
+  }
+  // Without stage timing the clock is only read for frames that get decoded.
+  if (trace.info.received_us == 0)
+    trace.start_now(micros());
 
-  if (raw.size() < offset + 8) {
-    ESP_LOGW(TAG, "Packet too short for id extraction");
+  if (this->rx_queue_.is_initialized()) {
+    // The worker drains until the queue is empty, so it only needs waking
+    // when this frame is the only one queued.
+    if (this->enqueue_packet_(slot, payload, payload_len, trace) && this->rx_queue_.size() == 1)
+      this->worker_.notify();
     return;
   }
 
-  const std::vector<uint8_t> data(raw.begin() + offset, raw.end());
-  char id_buf[9];
-  sprintf(id_buf, "%02X%02X%02X%02X", data[7], data[6], data[5], data[4]);
-  std::string meter_id_str(id_buf);
+  const uint64_t allocations_before = thread_alloc_counters().allocations;
+  DecodedTelegram decoded;
+  uint16_t meter = this->decode_frame_(slot, payload, payload_len, decoded, trace);
+  this->metrics_.record_decode(trace);
+  if (meter != MeterIndex::NOT_FOUND)
+    this->publish_(meter, decoded, trace,
+                   static_cast<uint32_t>(thread_alloc_counters().allocations - allocations_before));
+}
+
+uint16_t WMBusParser::lookup_meter_(const TelegramView &header) {
+  const uint16_t slot = this->meter_index_.find(header.address());
+  if (slot != MeterIndex::NOT_FOUND || this->auto_manufacturers_.empty())
+    return slot;
+  return this->add_detected_meter_(header);
+}
 
-  ESP_LOGI(TAG, "Meter id from telegram: %s", meter_id_str.c_str());
+bool WMBusParser::is_auto_manufacturer_(uint16_t manufacturer) const {
+  return std::find(this->auto_manufacturers_.begin(), this->auto_manufacturers_.end(), manufacturer) !=
+         this->auto_manufacturers_.end();
+}
 
-  for (auto *m : this->meters_) {
-    if (m->meter_id_ == meter_id_str) {
-      if (this->raw_log_level_ == RAW_LOG_LEVEL_MATCHING_METER_ID) {
-        std::string hex = format_raw_hex(raw);
-        ESP_LOGD(TAG, "Raw telegram for meter %s: %s", meter_id_str.c_str(), hex.c_str());
-      }
-      ESP_LOGI(TAG, "Packet for meter %s (instance %s)", meter_id_str.c_str(), m->id_.c_str());
-      m->handle_packet(raw);
+uint16_t WMBusParser::add_detected_meter_(const TelegramView &header) {
+  const uint16_t manufacturer = header.manufacturer();
+  if (!this->is_auto_manufacturer_(manufacturer))
+    return MeterIndex::NOT_FOUND;
+  const uint32_t address = header.address();
+  // IDs without a driver are remembered, so detection runs once per meter.
+  if (this->undecodable_.find(address) != MeterIndex::NOT_FOUND)
+    return MeterIndex::NOT_FOUND;
+  char meter_id[9];
+  format_meter_id(address, meter_id);
+  char code[4];
+  manufacturer_code(manufacturer, code);
+  const DriverEntry *entry = detect_driver(header);
+  if (entry == nullptr) {
+    if (this->undecodable_.size() < this->auto_meter_limit_) {
+      this->undecodable_.insert(address, 0);
+      ESP_LOGW(TAG, "No driver for %s meter %s (version 0x%02X, device type 0x%02X)", code, meter_id,
+               header.version(), header.device_type());
+    }
+    return MeterIndex::NOT_FOUND;
+  }
+  if (this->auto_meters_ >= this->auto_meter_limit_) {
+    if (!this->auto_limit_reported_) {
+      ESP_LOGW(TAG, "Auto-detect limit of %u meters reached, ignoring %s meter %s and any further ones",
+               static_cast<unsigned>(this->auto_meter_limit_), code, meter_id);
+      this->auto_limit_reported_ = true;
+    }
+    return MeterIndex::NOT_FOUND;
+  }
+
+  // The columns have room reserved by setup(), so this does not move the
+  // slots the decode task is reading.
+  const uint16_t slot = this->meters_.add(address, static_cast<uint8_t>(entry - &driver_at(0)));
+  this->meters_.flags[slot] |= MeterTable::FLAG_AUTO_DETECTED;
+  this->meter_index_.insert(address, slot);
+  this->handles_.emplace_back(this, slot);
+  if (this->meters_.has_history_column())
+    this->init_history_(slot);
+  this->auto_meters_++;
+  ESP_LOGI(TAG, "Detected %s meter %s (version 0x%02X, device type 0x%02X), driver=%s", code, meter_id,
+           header.version(), header.device_type(), entry->name);
+  return slot;
+}
+
+bool WMBusParser::detect_driver_(uint16_t slot, const TelegramView &header) {
+  uint8_t &driver = this->meters_.driver[slot];
+  if (driver == MeterTable::DRIVER_NONE)
+    return false;
+  const DriverEntry *entry = detect_driver(header);
+  char meter_id[9];
+  format_meter_id(this->meters_.address[slot], meter_id);
+  char code[4];
+  manufacturer_code(header.manufacturer(), code);
+  if (entry == nullptr) {
+    driver = MeterTable::DRIVER_NONE;
+    ESP_LOGW(TAG, "No driver for %s meter %s (version 0x%02X, device type 0x%02X)", code, meter_id,
+             header.version(), header.device_type());
+    return false;
+  }
+  driver = static_cast<uint8_t>(entry - &driver_at(0));
+  ESP_LOGI(TAG, "Meter %s is a %s meter (version 0x%02X, device type 0x%02X), driver=%s", meter_id, code,
+           header.version(), header.device_type(), entry->name);
+  return true;
+}
+
+void WMBusParser::record_raw_(const uint8_t *raw, size_t len, const uint8_t *payload, size_t payload_len, bool t1) {
+  uint8_t flags = t1 ? CAPTURE_FLAG_T1 : 0;
+  if (has_c1_header(raw, len))
+    flags |= CAPTURE_FLAG_C1_HEADER;
+  uint16_t slot = MeterIndex::NOT_FOUND;
+  if (payload != nullptr) {
+    flags |= CAPTURE_FLAG_FRAME_OK;
+    slot = this->meter_index_.find(TelegramView(payload, payload_len).address());
+  } else if (!t1) {
+    // Rejected frames are matched on their unverified address; a rejected T1
+    // frame has no readable address.
+    const TelegramView telegram = TelegramView::from_frame(raw, len);
+    if (telegram.size() >= TELEGRAM_ID_FIELD + 4)
+      slot = this->meter_index_.find(telegram.address());
+  }
+  if (slot != MeterIndex::NOT_FOUND)
+    flags |= CAPTURE_FLAG_METER_MATCH;
+
+  if (raw_level_matches(this->raw_log_level_, flags)) {
+    char hex[2 * FRAME_MAX_T1_SIZE + 1];
+    hex_encode(raw, len, hex);
+    char meter_id[9] = "";
+    if (slot != MeterIndex::NOT_FOUND)
+      format_meter_id(this->meters_.address[slot], meter_id);
+    ESP_LOGD(TAG, "Raw telegram%s%s%s%s: %s",
+             (flags & CAPTURE_FLAG_C1_HEADER) ? " (valid C1 header)" : (t1 ? " (T1)" : ""),
+             slot != MeterIndex::NOT_FOUND ? " for meter " : "", meter_id, payload == nullptr ? " (rejected)" : "",
+             hex);
+  }
+  if (this->capture_.is_enabled() && raw_level_matches(this->raw_capture_level_, flags))
+    this->capture_.append(raw, len, millis(), flags);
+}
+
+void WMBusParser::drain_capture_() {
+  uint8_t chunk[CAPTURE_DRAIN_CHUNK];
+  size_t len;
+  while ((len = this->capture_.read(chunk, sizeof(chunk))) > 0) {
+    if (!this->capture_sink_->write(chunk, len)) {
+      ESP_LOGW(TAG, "Raw capture sink write failed, detaching");
+      this->capture_sink_ = nullptr;
       return;
     }
   }
+}
+
+bool WMBusParser::enqueue_packet_(uint16_t meter, const uint8_t *raw, size_t len, const TelegramTrace &trace) {
+  FrameSlot *slot = this->rx_queue_.acquire();
+  if (slot == nullptr) {
+    this->queue_stats_.overflows++;
+    return false;
+  }
+  slot->meter = meter;
+  memcpy(slot->data, raw, len);
+  slot->length = static_cast<uint16_t>(len);
+  slot->trace = trace;
+  this->rx_queue_.publish();
 
-  ESP_LOGW(TAG, "No registered meter found for id %s", meter_id_str.c_str());
+  this->queue_stats_.enqueued++;
+  auto depth = static_cast<uint32_t>(this->rx_queue_.size());
+  if (depth > this->queue_stats_.max_depth)
+    this->queue_stats_.max_depth = depth;
+  return true;
+}
+
+void WMBusParser::drain_queue_entry_(void *arg) { static_cast<WMBusParser *>(arg)->drain_queue_(); }
+
+void WMBusParser::drain_queue_() {
+  while (FrameSlot *frame = this->rx_queue_.front()) {
+    ResultSlot *result = this->results_.acquire();
+    if (result == nullptr) {
+      this->queue_stats_.result_overflows++;
+    } else {
+      result->trace = frame->trace;
+      this->lap_unrecorded_(result->trace, TraceStage::QUEUE);
+      const uint64_t allocations_before = thread_alloc_counters().allocations;
+      result->meter = this->decode_frame_(frame->meter, frame->data, frame->length, result->telegram, result->trace);
+      result->allocations = static_cast<uint32_t>(thread_alloc_counters().allocations - allocations_before);
+      this->results_.publish();
+    }
+    this->rx_queue_.pop();
+  }
+}
+
+uint16_t WMBusParser::decode_frame_(uint16_t slot, const uint8_t *raw, size_t len, DecodedTelegram &decoded,
+                                    TelegramTrace &trace) {
+  // The receive pre-stage already removed the sync prefix and the CRCs and
+  // looked up the meter; the index is not read here, as meters detected on
+  // receive are inserted into it concurrently.
+  const TelegramView telegram(raw, len);
+  const uint32_t address = telegram.address();
+  ESP_LOGV(TAG, "Meter id from telegram: %08X", static_cast<unsigned>(address));
+
+  MeterStats &stats = this->meters_.stats[slot];
+  const uint32_t now = millis();
+  stats.received++;
+  stats.last_seen_ms = now;
+  if (this->duplicate_window_ms_ > 0 &&
+      this->meters_.duplicates[slot].check_and_insert(telegram_payload_hash(telegram), now,
+                                                      this->duplicate_window_ms_)) {
+    stats.duplicates++;
+    this->metrics_.duplicates++;
+    this->lap_unrecorded_(trace, TraceStage::DEDUPE);
+    ESP_LOGV(TAG, "Dropping duplicate telegram for meter %08X", static_cast<unsigned>(address));
+    return MeterIndex::NOT_FOUND;
+  }
+  ESP_LOGV(TAG, "Packet for meter %08X", static_cast<unsigned>(address));
+  const uint32_t start = micros();
+  // The dedupe stage ends here and so includes the log line above.
+  if (this->stage_timing_)
+    trace.lap_unrecorded(TraceStage::DEDUPE, start);
+  FailureReason failure = FailureReason::DRIVER;
+  const bool ok = this->decode_meter_(slot, telegram, decoded, failure);
+  const uint32_t decoded_us = micros();
+  trace.set_decode_time(decoded_us - start);
+  if (this->stage_timing_)
+    trace.lap_unrecorded(TraceStage::DECODE, decoded_us);
+  if (!ok) {
+    this->metrics_.count_failure(failure);
+    return MeterIndex::NOT_FOUND;
+  }
+  // Stamped with the reception rather than with the moment the decode got to
+  // the frame, which can be a queue wait later.
+  const uint32_t age_s = (decoded_us - trace.info.received_us + 500000) / 1000000;
+  decoded.timestamp = std::time(nullptr) - static_cast<std::time_t>(age_s);
+  decoded.mark(FIELD_TIMESTAMP);
+  decoded.receive = trace.info;
+  if (trace.info.has_rssi())
+    decoded.mark(FIELD_RSSI);
+  trace.address = address;
+  this->metrics_.decoded++;
+  return slot;
+}
+
+void WMBusParser::publish_(uint16_t meter, const DecodedTelegram &decoded, TelegramTrace &trace,
+                           uint32_t allocations) {
+  const uint64_t allocations_before = thread_alloc_counters().allocations;
+  if (this->publish_interval_ms_ > 0) {
+    // Keep only the newest reading per meter until the next flush.
+    this->publish_stats_.staged++;
+    uint8_t &flags = this->meters_.flags[meter];
+    this->meters_.pending[meter] = decoded;
+    if (flags & MeterTable::FLAG_HAS_PENDING) {
+      this->publish_stats_.coalesced++;
+    } else {
+      flags |= MeterTable::FLAG_HAS_PENDING;
+      this->pending_slots_.push_back(meter);
+    }
+  } else {
+    this->publish_meter_(meter, decoded);
+    this->arena_.reset();
+    if (!this->batch_triggers_.empty()) {
+      const BatchEntry entry{this->meters_.address[meter], &decoded};
+      this->fire_on_batch_(&entry, 1);
+    }
+  }
+  if (this->stage_timing_) {
+    this->lap_(trace, TraceStage::PUBLISH);
+    this->metrics_.end_to_end.record(trace.total_us());
+    this->traces_.add(trace);
+  }
+
+  if (ALLOC_COUNTING_ENABLED) {
+    allocations += static_cast<uint32_t>(thread_alloc_counters().allocations - allocations_before);
+    auto &stats = this->allocation_stats_;
+    stats.telegrams++;
+    stats.allocations += allocations;
+    if (allocations > stats.max_per_telegram)
+      stats.max_per_telegram = allocations;
+    if (allocations > 0) {
+      stats.telegrams_with_allocations++;
+      ESP_LOGD(TAG, "Telegram caused %u heap allocations", static_cast<unsigned>(allocations));
+    }
+  }
+}
+
+void WMBusParser::flush_pending_() {
+  if (this->flush_remaining_ == 0) {
+    const uint32_t now = millis();
+    if (this->pending_slots_.empty() || now - this->last_flush_ms_ < this->publish_interval_ms_)
+      return;
+    // Meters staged while this flush is spread over several loop() calls wait
+    // for the next interval.
+    this->last_flush_ms_ = now;
+    this->flush_remaining_ = this->pending_slots_.size();
+    this->publish_stats_.flushes++;
+  }
+
+  const size_t count = std::min(this->flush_remaining_, this->publish_batch_size_);
+  this->batch_.clear();
+  for (size_t i = 0; i < count; i++) {
+    const uint16_t slot = this->pending_slots_[i];
+    this->meters_.flags[slot] &= ~MeterTable::FLAG_HAS_PENDING;
+    this->publish_meter_(slot, this->meters_.pending[slot]);
+    this->arena_.reset();
+    // Points at the last column, which keeps the reading until the next flush.
+    this->batch_.push_back(BatchEntry{this->meters_.address[slot], &this->meters_.last[slot]});
+  }
+  this->pending_slots_.erase(this->pending_slots_.begin(), this->pending_slots_.begin() + count);
+  this->flush_remaining_ -= count;
+  this->fire_on_batch_(this->batch_.data(), this->batch_.size());
+}
+
+void WMBusParser::fire_on_batch_(const BatchEntry *entries, size_t count) {
+  if (this->batch_triggers_.empty())
+    return;
+  this->publish_stats_.batches++;
+  const MeterBatch batch(entries, count, &this->arena_);
+  for (auto *trigger : this->batch_triggers_) {
+    trigger->trigger(batch);
+  }
+  this->arena_.reset();
+}
+
+void WMBusParser::publish_metrics_() {
+  const uint32_t now = millis();
+  this->last_metrics_ms_ = now;
+  const ParserMetrics m = this->metrics();
+  if (this->received_sensor_ != nullptr)
+    this->received_sensor_->publish_state(m.received);
+  if (this->decoded_sensor_ != nullptr)
+    this->decoded_sensor_->publish_state(m.decoded);
+  if (this->failed_sensor_ != nullptr)
+    this->failed_sensor_->publish_state(m.failed());
+  if (this->duplicates_sensor_ != nullptr)
+    this->duplicates_sensor_->publish_state(m.duplicates);
+  if (this->unknown_id_sensor_ != nullptr)
+    this->unknown_id_sensor_->publish_state(m.unknown_id);
+  if (this->decode_time_sensor_ != nullptr) {
+    const LatencyHistogram window = m.decode_time.since(this->metrics_window_);
+    this->decode_time_sensor_->publish_state(window.count() > 0 ? window.percentile_us(0.95f) : NAN);
+  }
+  this->metrics_window_ = m.decode_time;
+  if (this->latency_sensor_ != nullptr) {
+    const LatencyHistogram window = m.end_to_end.since(this->latency_window_);
+    this->latency_sensor_->publish_state(window.count() > 0 ? window.percentile_us(0.95f) : NAN);
+  }
+  this->latency_window_ = m.end_to_end;
+
+  for (size_t slot = 0; slot < this->meters_.size(); slot++) {
+    sensor::Sensor *sensor = this->meters_.last_seen_sensor[slot];
+    if (sensor == nullptr)
+      continue;
+    const MeterStats &stats = this->meters_.stats[slot];
+    sensor->publish_state(stats.received > 0 ? stats.last_seen_age_ms(now) / 1000.0f : NAN);
+  }
+}
+
+void WMBusParser::report_foreign_meters_() {
+  const uint32_t now = millis();
+  const uint32_t elapsed_s = (now - this->last_foreign_report_ms_) / 1000;
+  this->last_foreign_report_ms_ = now;
+  const uint32_t frames = this->foreign_.frames() - this->foreign_reported_frames_;
+  this->foreign_reported_frames_ = this->foreign_.frames();
+  if (frames == 0)
+    return;
+
+  static constexpr size_t TOP = 3;
+  ForeignMeter top[TOP];
+  const size_t count = this->foreign_.top(top, TOP);
+  char line[TOP * 32];
+  size_t pos = 0;
+  for (size_t i = 0; i < count; i++) {
+    char manufacturer[4];
+    manufacturer_code(top[i].manufacturer, manufacturer);
+    pos += snprintf(line + pos, sizeof(line) - pos, "%s%s %08X (%u)", i > 0 ? ", " : "", manufacturer,
+                    static_cast<unsigned>(top[i].address), static_cast<unsigned>(top[i].hits));
+  }
+  ESP_LOGI(TAG, "%u frames from unknown meters in %u s, %u IDs tracked; most heard: %s", static_cast<unsigned>(frames),
+           static_cast<unsigned>(elapsed_s), static_cast<unsigned>(this->foreign_.size()), line);
+}
+
+void WMBusParser::dump_foreign_meters() const {
+  const uint32_t now = millis();
+  ESP_LOGI(TAG, "Unknown meters: %u of %u slots, %u frames, %u evicted", static_cast<unsigned>(this->foreign_.size()),
+           static_cast<unsigned>(this->foreign_.capacity()), static_cast<unsigned>(this->foreign_.frames()),
+           static_cast<unsigned>(this->foreign_.evictions()));
+  for (const ForeignMeter &entry : this->foreign_) {
+    char manufacturer[4];
+    manufacturer_code(entry.manufacturer, manufacturer);
+    ESP_LOGI(TAG, "  %s %08X version %02X type %02X: %u frames (%u inherited), last %u s ago", manufacturer,
+             static_cast<unsigned>(entry.address), entry.version, entry.device_type, static_cast<unsigned>(entry.hits),
+             static_cast<unsigned>(entry.error), static_cast<unsigned>((now - entry.last_seen_ms) / 1000));
+  }
+}
+
+void WMBusParser::dump_traces() const {
+  ESP_LOGI(TAG, "Last %u telegrams, us per stage (link_check id_lookup queue dedupe decode publish):",
+           static_cast<unsigned>(this->traces_.size()));
+  for (size_t i = 0; i < this->traces_.size(); i++) {
+    const TelegramTrace &trace = this->traces_.at(i);
+    char meter_id[9];
+    format_meter_id(trace.address, meter_id);
+    const uint32_t *us = trace.stage_us;
+    ESP_LOGI(TAG, "  %s from %u, RSSI %.1f dBm: %u %u %u %u %u %u, total %u", meter_id,
+             static_cast<unsigned>(trace.info.source), trace.info.rssi_dbm, static_cast<unsigned>(us[0]),
+             static_cast<unsigned>(us[1]), static_cast<unsigned>(us[2]), static_cast<unsigned>(us[3]),
+             static_cast<unsigned>(us[4]), static_cast<unsigned>(us[5]), static_cast<unsigned>(trace.total_us()));
+  }
 }
 
 void WMBusParser::add_on_decode_trigger(WMBusParserDecodeTrigger *trigger) { this->decode_triggers_.push_back(trigger); }
 
-void WMBusParser::fire_on_decode(const std::string &meter_id, float value, const AttributeList &attrs) {
+void WMBusParser::fire_on_decode(const std::string &meter_id, const DecodedTelegram &telegram) {
+  if (this->decode_triggers_.empty())
+    return;
+  // Attribute strings are only built if an automation iterates them.
+  const AttributeList attrs(telegram, &this->arena_);
   for (auto *trigger : this->decode_triggers_) {
-    trigger->trigger(value, attrs, meter_id);
+    trigger->trigger(telegram.total_m3, attrs, meter_id);
+  }
+}
+
+void WMBusParser::add_on_decode_json_trigger(WMBusParserJsonTrigger *trigger) {
+  this->json_triggers_.push_back(trigger);
+}
+
+void WMBusParser::fire_on_decode_json(const std::string &meter_id, const DecodedTelegram &telegram) {
+  if (this->json_buffer_ == nullptr)
+    return;
+  const size_t length =
+      format_telegram_json(this->json_buffer_.get(), TELEGRAM_JSON_MAX_SIZE, meter_id.c_str(), telegram);
+  for (auto *trigger : this->json_triggers_) {
+    trigger->trigger(this->json_buffer_.get(), length, meter_id);
+  }
+}
+
+void WMBusParser::add_on_change_trigger(WMBusParserChangeTrigger *trigger) { this->change_triggers_.push_back(trigger); }
+
+void WMBusParser::add_on_batch_trigger(WMBusParserBatchTrigger *trigger) { this->batch_triggers_.push_back(trigger); }
+
+void WMBusParser::add_on_backfill_trigger(WMBusParserBackfillTrigger *trigger) {
+  this->backfill_triggers_.push_back(trigger);
+}
+
+void WMBusParser::replay_history() {
+  if (!this->meters_.has_history_column() || this->backfill_triggers_.empty())
+    return;
+  // A replay already running starts over; meters it handled have nothing left.
+  this->history_replaying_ = true;
+  this->history_replay_slot_ = 0;
+}
+
+void WMBusParser::replay_history_step_() {
+  size_t replayed = 0;
+  while (this->history_replay_slot_ < this->meters_.size() && replayed < this->publish_batch_size_) {
+    const uint16_t slot = this->history_replay_slot_++;
+    ReadingHistory &history = this->meters_.history[slot];
+    if (history.unsent() == 0)
+      continue;
+    char meter_id_text[9];
+    format_meter_id(this->meters_.address[slot], meter_id_text);
+    const std::string meter_id(meter_id_text);
+    const HistoryReadings readings(&history, history.size() - history.unsent());
+    for (auto *trigger : this->backfill_triggers_) {
+      trigger->trigger(meter_id, readings);
+    }
+    history.mark_sent();
+    replayed++;
+  }
+  if (this->history_replay_slot_ >= this->meters_.size())
+    this->history_replaying_ = false;
+}
+
+void WMBusParser::mark_history_sent() {
+  for (auto &history : this->meters_.history)
+    history.mark_sent();
+}
+
+void WMBusParser::save_history() {
+  for (auto &history : this->meters_.history)
+    history.save();
+}
+
+void WMBusParser::fire_on_change(const std::string &meter_id, const DecodedTelegram &changes) {
+  const AttributeList attrs(changes, &this->arena_);
+  for (auto *trigger : this->change_triggers_) {
+    trigger->trigger(changes.total_m3, attrs, meter_id);
   }
 }
 
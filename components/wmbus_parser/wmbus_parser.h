@@ -1,7 +1,27 @@
 #pragma once
 #include "esphome.h"
-#include "driver_registry.h"
+#include "alloc_counter.h"
+#include "arena.h"
+#include "decode_worker.h"
+#include "decoded_telegram.h"
+#include "driver_table.h"
+#include "duplicate_cache.h"
+#include "foreign_meters.h"
+#include "frame_check.h"
+#include "frame_stream.h"
+#include "meter_batch.h"
+#include "meter_index.h"
+#include "meter_table.h"
+#include "metrics.h"
+#include "raw_capture.h"
+#include "reading_history.h"
+#include "receive_info.h"
+#include "spsc_queue.h"
+#include "telegram_crypto.h"
+#include "telegram.h"
+#include "telegram_json.h"
 #include "esphome/core/automation.h"
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
@@ -24,58 +44,345 @@ inline constexpr RawLogLevel RAW_LOG_LEVEL_ALL = RawLogLevel::RAW_LOG_LEVEL_ALL;
 inline constexpr RawLogLevel RAW_LOG_LEVEL_VALID_C1_HEADER = RawLogLevel::RAW_LOG_LEVEL_VALID_C1_HEADER;
 inline constexpr RawLogLevel RAW_LOG_LEVEL_MATCHING_METER_ID = RawLogLevel::RAW_LOG_LEVEL_MATCHING_METER_ID;
 
-using AttributeList = std::vector<std::string>;
-
 class WMBusParser;
 class WMBusParserDecodeTrigger;
+class WMBusParserJsonTrigger;
+class WMBusParserChangeTrigger;
+class WMBusParserBatchTrigger;
+class WMBusParserBackfillTrigger;
 
-class WMBusMeter : public Component {
+/// Handle of a meter registered with WMBusParser::add_meter. The meter's
+/// state lives in the parser's MeterTable; the handle only names the slot.
+class WMBusMeter {
  public:
-  WMBusMeter(const std::string &meter_id, const std::string &driver);
-  WMBusMeter(const std::string &id, const std::string &meter_id, const std::string &driver);
-  void setup() override {}
-  void loop() override {}
+  WMBusMeter(WMBusParser *parent, uint16_t slot) : parent_(parent), slot_(slot) {}
 
-  void set_parent(WMBusParser *parent);
+  // False if add_meter rejected the meter; setters are then ignored.
+  bool is_valid() const { return this->slot_ != MeterIndex::NOT_FOUND; }
+  uint16_t slot() const { return this->slot_; }
+  uint32_t address() const;
+  std::string meter_id() const;
+  // Driver name; "auto" until the first telegram picked one
+  const char *driver() const;
+  // Added at runtime for a wildcard manufacturer rather than from the configuration
+  bool is_auto_detected() const;
 
   // Bind sensor (called from Python codegen)
   void set_total_m3(sensor::Sensor *sensor);
+  // Publish the total_m3 sensor at most once per interval and only when the
+  // value moved by at least threshold since the last published state (0 disables)
+  void set_min_publish_interval(uint32_t interval_ms);
+  void set_total_m3_threshold(float threshold);
+  // Seconds since the last frame, published with the parser metrics
+  void set_last_seen(sensor::Sensor *sensor);
+  // AES-128 key (32 hex digits) for encrypted telegrams; the key schedule is
+  // expanded here and the text is not kept
+  bool set_key(const std::string &key);
+  bool has_key() const;
+
+  const MeterStats &stats() const;
+  uint32_t get_duplicate_count() const { return this->stats().duplicates; }
+  // Telegrams that changed nothing and therefore skipped on_change
+  uint32_t get_unchanged_count() const { return this->stats().unchanged; }
+  // Sensor updates suppressed by min_publish_interval or total_m3_threshold
+  uint32_t get_throttled_count() const { return this->stats().throttled; }
+  // Last telegram published for this meter, nullptr before the first one or
+  // if neither on_change nor publish_interval is configured
+  const DecodedTelegram *last_state() const;
+  // Recorded total_m3 readings, nullptr without history_size
+  const ReadingHistory *history() const;
+
+ protected:
+  WMBusParser *parent_;
+  uint16_t slot_;
+};
 
-  // Called by parser when a raw packet for this meter is available
-  void handle_packet(const std::vector<uint8_t> &raw);
+struct QueueStats {
+  RelaxedAtomic<uint32_t> enqueued{0};
+  RelaxedAtomic<uint32_t> overflows{0};         // frames dropped because the receive queue was full
+  RelaxedAtomic<uint32_t> result_overflows{0};  // frames dropped because loop() fell behind on results
+  RelaxedAtomic<uint32_t> max_depth{0};
+};
 
-  // Public members
-  std::string id_;
-  std::string meter_id_;
-  std::string driver_;
-  sensor::Sensor *total_m3_sensor_{nullptr};
+// Publish scheduler, only used with a publish interval.
+struct PublishStats {
+  uint32_t staged{0};     // decoded telegrams handed to the scheduler
+  uint32_t coalesced{0};  // readings replaced by a newer one before the flush
+  uint32_t flushes{0};
+  uint32_t batches{0};    // on_batch payloads, at most publish_batch_size meters each
+};
 
- private:
-  // decode via driver
-  bool decode_packet(const std::vector<uint8_t> &raw, std::map<std::string, std::string> &attrs, float &value);
-  WMBusParser *parent_{nullptr};
+struct AllocationStats {
+  uint32_t telegrams{0};
+  uint64_t allocations{0};
+  uint32_t max_per_telegram{0};
+  uint32_t telegrams_with_allocations{0};
 };
 
 class WMBusParser : public Component {
  public:
   WMBusParser() {}
-  void setup() override {}
-  void loop() override {}
+  void setup() override;
+  void loop() override;
+  void dump_config() override;
+  void on_safe_shutdown() override;
 
-  // Register meter created from Python to_code()
-  void add_meter(WMBusMeter *meter);
+  // Register a meter (called from Python to_code()). The returned handle stays
+  // valid for the lifetime of the parser. Driver "auto" picks the driver from
+  // the link header of the meter's first telegram.
+  WMBusMeter *add_meter(const std::string &meter_id, const std::string &driver);
+  // Decode every meter of this manufacturer ("MAD"), added with an
+  // auto-detected driver when it is first heard
+  bool add_auto_manufacturer(const std::string &code);
+  // Most meters added for wildcard manufacturers; room for them is reserved in setup()
+  void set_auto_meter_limit(size_t limit) { this->auto_meter_limit_ = limit; }
+  // Size the meter table up front; optional
+  void reserve_meters(size_t count);
+  size_t meter_count() const { return this->meters_.size(); }
+  WMBusMeter *get_meter(uint16_t slot) { return &this->handles_[slot]; }
 
   // Expose method that can be called from lambda: id(wmbus_parser)->receive_packet(x)
   void receive_packet(const std::vector<uint8_t> &raw);
+  // With the radio's signal report, e.g. receive_packet(x, rssi, snr) from on_packet
+  void receive_packet(const std::vector<uint8_t> &raw, float rssi_dbm, float snr_db = NAN);
+  // Zero-copy entry point for frames held elsewhere (radio FIFO, capture file, ...)
+  void receive_packet(const uint8_t *raw, size_t len);
+  // Same, with what the radio knows about the frame. A received_us of 0 means now;
+  // set it in the radio interrupt to have the trace start there.
+  void receive_packet(const uint8_t *raw, size_t len, const ReceiveInfo &info);
+  // Streaming entry point: pass bytes as the radio FIFO delivers them. The
+  // frame is checked block by block and dropped after its header if the meter
+  // is unknown; wildcard meters are only added once the whole frame is checked. Returns false once the frame is handled, so the radio can stop
+  // reading it; call end_frame() at the end of every received packet. ``info``
+  // is taken from the call with the first bytes of a frame.
+  bool feed(const uint8_t *data, size_t len, const ReceiveInfo &info = ReceiveInfo());
+  void end_frame();
 
   void set_raw_log_level(RawLogLevel level);
+  void set_arena_size(size_t size) { this->arena_size_ = size; }
+  // Keep received frames in a binary capture ring; levels filter like raw_log_level
+  void set_raw_capture_level(RawLogLevel level) { this->raw_capture_level_ = level; }
+  void set_raw_capture_size(size_t size) { this->capture_size_ = size; }
+  // Drain the capture ring into this sink from loop() (nullptr detaches)
+  void set_capture_sink(CaptureSink *sink) { this->capture_sink_ = sink; }
+  // Drop identical telegrams from the same meter received within this window (0 disables)
+  void set_duplicate_window(uint32_t window_ms) { this->duplicate_window_ms_ = window_ms; }
+  // Verify and strip the link-layer block CRCs (disable for radios that already do)
+  void set_check_crc(bool enabled) { this->check_crc_ = enabled; }
+  // Also accept 3-of-6 encoded T1 frames (always CRC checked)
+  void set_t1_mode(bool enabled) {
+    this->t1_mode_ = enabled;
+    this->stream_.set_t1(enabled);
+  }
+  // Queue frames in receive_packet and decode them on a background worker
+  void set_decode_worker(bool enabled) { this->decode_worker_ = enabled; }
+  void set_queue_size(size_t size) { this->queue_size_ = size; }
+  // Coalesce readings per meter and publish them every interval_ms, at most
+  // batch_size meters per loop() (0 publishes every telegram as it arrives)
+  void set_publish_interval(uint32_t interval_ms) { this->publish_interval_ms_ = interval_ms; }
+  void set_publish_batch_size(size_t size) { this->publish_batch_size_ = size > 0 ? size : 1; }
   void add_on_decode_trigger(WMBusParserDecodeTrigger *trigger);
-  void fire_on_decode(const std::string &meter_id, float value, const AttributeList &attrs);
+  void fire_on_decode(const std::string &meter_id, const DecodedTelegram &telegram);
+  // The telegram as one JSON object, written to a buffer the parser owns
+  void add_on_decode_json_trigger(WMBusParserJsonTrigger *trigger);
+  void fire_on_decode_json(const std::string &meter_id, const DecodedTelegram &telegram);
+  void add_on_change_trigger(WMBusParserChangeTrigger *trigger);
+  bool has_change_triggers() const { return !this->change_triggers_.empty(); }
+  // ``changes`` holds only the fields that differ from the meter's previous telegram
+  void fire_on_change(const std::string &meter_id, const DecodedTelegram &changes);
+  void add_on_batch_trigger(WMBusParserBatchTrigger *trigger);
+  // Record at most one total_m3 reading per interval and meter in a ring of
+  // this many bytes, kept in flash preferences (0 disables)
+  void set_history_size(size_t size) { this->history_size_ = size; }
+  void set_history_interval(uint32_t interval_ms) { this->history_interval_ms_ = interval_ms; }
+  // Write changed history pages to preferences at this interval
+  void set_history_save_interval(uint32_t interval_ms) { this->history_save_interval_ms_ = interval_ms; }
+  void add_on_backfill_trigger(WMBusParserBackfillTrigger *trigger);
+  // Hand each meter's readings recorded since the last replay to on_backfill,
+  // publish_batch_size meters per loop(), e.g. once MQTT is connected again
+  void replay_history();
+  // Count every recorded reading as replayed, e.g. when the connection drops
+  void mark_history_sent();
+  void save_history();
+  // Slots of the table of unknown meters heard on air (0 disables it)
+  void set_foreign_table_size(size_t size) { this->foreign_table_size_ = size; }
+  // Log a summary of foreign frames at this interval (0 disables)
+  void set_foreign_report_interval(uint32_t interval_ms) { this->foreign_report_interval_ms_ = interval_ms; }
+
+  // Optional metric sensors, published every metrics interval
+  void set_metrics_interval(uint32_t interval_ms) { this->metrics_interval_ms_ = interval_ms; }
+  void set_received_sensor(sensor::Sensor *sensor) { this->received_sensor_ = sensor; }
+  void set_decoded_sensor(sensor::Sensor *sensor) { this->decoded_sensor_ = sensor; }
+  void set_failed_sensor(sensor::Sensor *sensor) { this->failed_sensor_ = sensor; }
+  void set_duplicates_sensor(sensor::Sensor *sensor) { this->duplicates_sensor_ = sensor; }
+  void set_unknown_id_sensor(sensor::Sensor *sensor) { this->unknown_id_sensor_ = sensor; }
+  // 95th percentile decode time in µs over the last interval
+  void set_decode_time_sensor(sensor::Sensor *sensor) { this->decode_time_sensor_ = sensor; }
+  // 95th percentile time from reception to publication in µs over the last
+  // interval; turns on stage timing
+  void set_latency_sensor(sensor::Sensor *sensor) { this->latency_sensor_ = sensor; }
+  // Time every stage from reception to publication, see ParserMetrics::stage_time
+  void set_stage_timing(bool enabled) { this->stage_timing_ = enabled; }
+  // With stage timing, keep the traces of the last ``size`` published telegrams
+  void set_trace_size(size_t size) { this->trace_size_ = size; }
+
+  const TelegramArena &arena() const { return this->arena_; }
+  const MeterTable &meters() const { return this->meters_; }
+  // Captured records can also be pulled directly with raw_capture().read().
+  RawCaptureBuffer &raw_capture() { return this->capture_; }
+  // Snapshot of the parser counters; per-meter counters are in WMBusMeter::stats()
+  ParserMetrics metrics() const { return this->metrics_; }
+  const QueueStats &queue_stats() const { return this->queue_stats_; }
+  const ForeignMeterTable &foreign_meters() const { return this->foreign_; }
+  // Log every entry of the foreign meter table, e.g. from a button to discover meter IDs
+  void dump_foreign_meters() const;
+  const TraceRing &traces() const { return this->traces_; }
+  // Log the kept traces, oldest first
+  void dump_traces() const;
+  const PublishStats &publish_stats() const { return this->publish_stats_; }
+  // Meters holding a reading for the next flush
+  size_t pending_publishes() const { return this->pending_slots_.size(); }
+  size_t queue_depth() const { return this->rx_queue_.size(); }
+  size_t queue_capacity() const { return this->rx_queue_.capacity(); }
+  // True while frames are queued or decoded telegrams wait for loop()
+  bool has_pending() const { return this->rx_queue_.size() > 0 || this->results_.size() > 0; }
+  // Only populated when built with WMBUS_PARSER_COUNT_ALLOCATIONS.
+  const AllocationStats &allocation_stats() const { return this->allocation_stats_; }
 
  protected:
-  std::vector<WMBusMeter*> meters_;
+  struct FrameSlot {
+    uint16_t meter{0};
+    uint16_t length{0};
+    uint8_t data[TELEGRAM_MAX_FRAME_SIZE];
+    TelegramTrace trace;
+  };
+  // Every decoded frame comes back, even without a telegram to publish, so
+  // that loop() records its timings.
+  struct ResultSlot {
+    uint16_t meter{0};  // MeterIndex::NOT_FOUND if nothing is published
+    uint32_t allocations{0};  // by the decode, on the worker
+    DecodedTelegram telegram;
+    TelegramTrace trace;
+  };
+
+  friend class WMBusMeter;
+
+  void publish_metrics_();
+  void report_foreign_meters_();
+  // Raw logging and capture; ``payload`` is the checked frame or nullptr if rejected.
+  // Everything after the link-layer checks, shared by receive_packet and feed
+  void handle_frame_(const uint8_t *raw, size_t len, const uint8_t *payload, size_t payload_len, FrameError error,
+                     bool t1, TelegramTrace &trace);
+  // Drop a streamed frame early if its header rules out every meter
+  void check_stream_header_();
+  // Slot of the meter that sent ``header`` (link header up to the device
+  // type), adding it for a wildcard manufacturer; MeterIndex::NOT_FOUND if none
+  uint16_t lookup_meter_(const TelegramView &header);
+  uint16_t add_detected_meter_(const TelegramView &header);
+  bool is_auto_manufacturer_(uint16_t manufacturer) const;
+  // Resolve driver "auto" from the meter's first telegram; false if no driver reads it
+  bool detect_driver_(uint16_t slot, const TelegramView &header);
+  void record_raw_(const uint8_t *raw, size_t len, const uint8_t *payload, size_t payload_len, bool t1);
+  void drain_capture_();
+  bool enqueue_packet_(uint16_t meter, const uint8_t *raw, size_t len, const TelegramTrace &trace);
+  static void drain_queue_entry_(void *arg);
+  void drain_queue_();
+  // Duplicate filter and driver on a checked frame for the meter in ``slot``, as
+  // looked up on receive. Returns ``slot`` if the telegram decoded, or
+  // MeterIndex::NOT_FOUND. Timings are left in ``trace`` for record_decode().
+  uint16_t decode_frame_(uint16_t slot, const uint8_t *raw, size_t len, DecodedTelegram &decoded,
+                         TelegramTrace &trace);
+  // Decryption and driver for the meter in ``slot``; may run on the decode worker,
+  // whose stack is small, so per-telegram logs there stay at DEBUG and below.
+  bool decode_meter_(uint16_t slot, const TelegramView &telegram, DecodedTelegram &result, FailureReason &failure);
+  // ``allocations`` were caused by decoding the telegram, maybe on another thread.
+  void publish_(uint16_t meter, const DecodedTelegram &decoded, TelegramTrace &trace, uint32_t allocations);
+  // Sensor and per-meter triggers on the main loop
+  void publish_meter_(uint16_t slot, const DecodedTelegram &decoded);
+  void publish_sensor_(uint16_t slot, float total_m3);
+  void publish_changes_(uint16_t slot, const DecodedTelegram &decoded);
+  void flush_pending_();
+  void fire_on_batch_(const BatchEntry *entries, size_t count);
+  void replay_history_step_();
+  void init_history_(uint16_t slot);
+  void lap_(TelegramTrace &trace, TraceStage stage) {
+    if (this->stage_timing_)
+      this->metrics_.record_stage(stage, trace.lap(stage, micros()));
+  }
+  // For the stages on the decode task, which must not write the histograms.
+  void lap_unrecorded_(TelegramTrace &trace, TraceStage stage) {
+    if (this->stage_timing_)
+      trace.lap_unrecorded(stage, micros());
+  }
+
+  MeterTable meters_;
+  std::deque<WMBusMeter> handles_;  // deque: handles must not move as meters are added
+  MeterIndex meter_index_;
+  std::vector<uint16_t> auto_manufacturers_;  // M-fields decoded without listing the IDs
+  size_t auto_meter_limit_{32};
+  size_t auto_meters_{0};
+  bool auto_limit_reported_{false};
+  MeterIndex undecodable_;  // wildcard IDs no driver reads, as a set
   RawLogLevel raw_log_level_{RawLogLevel::RAW_LOG_LEVEL_NONE};
+  RawLogLevel raw_capture_level_{RawLogLevel::RAW_LOG_LEVEL_NONE};
+  size_t capture_size_{4096};
+  RawCaptureBuffer capture_;
+  CaptureSink *capture_sink_{nullptr};
   std::vector<WMBusParserDecodeTrigger *> decode_triggers_;
+  std::vector<WMBusParserJsonTrigger *> json_triggers_;
+  std::unique_ptr<char[]> json_buffer_;  // TELEGRAM_JSON_MAX_SIZE, allocated in setup() for json_triggers_
+  std::vector<WMBusParserChangeTrigger *> change_triggers_;
+  std::vector<WMBusParserBatchTrigger *> batch_triggers_;
+  std::vector<WMBusParserBackfillTrigger *> backfill_triggers_;
+  uint32_t duplicate_window_ms_{0};
+  bool check_crc_{true};
+  bool t1_mode_{false};
+  FrameStream stream_;  // state of the frame being fed, see feed()
+  TelegramTrace stream_trace_;
+  ParserMetrics metrics_;
+  size_t foreign_table_size_{32};
+  uint32_t foreign_report_interval_ms_{300000};
+  uint32_t last_foreign_report_ms_{0};
+  uint32_t foreign_reported_frames_{0};  // foreign_.frames() at the last report
+  ForeignMeterTable foreign_;
+  uint32_t metrics_interval_ms_{60000};
+  uint32_t last_metrics_ms_{0};
+  LatencyHistogram metrics_window_;  // decode_time at the last metrics publish
+  LatencyHistogram latency_window_;  // end_to_end at the last metrics publish
+  bool stage_timing_{false};
+  size_t trace_size_{8};
+  TraceRing traces_;
+  bool has_metric_sensors_{false};
+  sensor::Sensor *received_sensor_{nullptr};
+  sensor::Sensor *decoded_sensor_{nullptr};
+  sensor::Sensor *failed_sensor_{nullptr};
+  sensor::Sensor *duplicates_sensor_{nullptr};
+  sensor::Sensor *unknown_id_sensor_{nullptr};
+  sensor::Sensor *decode_time_sensor_{nullptr};
+  sensor::Sensor *latency_sensor_{nullptr};
+  size_t arena_size_{TelegramArena::DEFAULT_CAPACITY};
+  TelegramArena arena_;
+  AllocationStats allocation_stats_;
+  bool decode_worker_{false};
+  size_t queue_size_{8};
+  SpscQueue<FrameSlot> rx_queue_;
+  SpscQueue<ResultSlot> results_;
+  QueueStats queue_stats_;
+  uint32_t publish_interval_ms_{0};
+  size_t publish_batch_size_{8};
+  uint32_t last_flush_ms_{0};
+  size_t flush_remaining_{0};     // meters of the current flush not yet published
+  std::vector<uint16_t> pending_slots_;  // meter slots in staging order, each at most once
+  std::vector<BatchEntry> batch_;
+  PublishStats publish_stats_;
+  size_t history_size_{0};
+  uint32_t history_interval_ms_{900000};
+  uint32_t history_save_interval_ms_{300000};
+  uint32_t last_history_save_ms_{0};
+  bool history_replaying_{false};
+  uint16_t history_replay_slot_{0};  // next meter of the running replay
+  // Declared last so the worker stops before the queues are destroyed.
+  DecodeWorker worker_;
 };
 
 class WMBusParserDecodeTrigger : public Trigger<float, AttributeList, std::string> {
@@ -83,5 +390,26 @@ class WMBusParserDecodeTrigger : public Trigger<float, AttributeList, std::strin
   explicit WMBusParserDecodeTrigger(WMBusParser *parent) { parent->add_on_decode_trigger(this); }
 };
 
+// The JSON text is only valid while the automation runs; copy it to keep it.
+class WMBusParserJsonTrigger : public Trigger<const char *, size_t, std::string> {
+ public:
+  explicit WMBusParserJsonTrigger(WMBusParser *parent) { parent->add_on_decode_json_trigger(this); }
+};
+
+class WMBusParserChangeTrigger : public Trigger<float, AttributeList, std::string> {
+ public:
+  explicit WMBusParserChangeTrigger(WMBusParser *parent) { parent->add_on_change_trigger(this); }
+};
+
+class WMBusParserBatchTrigger : public Trigger<MeterBatch> {
+ public:
+  explicit WMBusParserBatchTrigger(WMBusParser *parent) { parent->add_on_batch_trigger(this); }
+};
+
+class WMBusParserBackfillTrigger : public Trigger<std::string, HistoryReadings> {
+ public:
+  explicit WMBusParserBackfillTrigger(WMBusParser *parent) { parent->add_on_backfill_trigger(this); }
+};
+
 }  // namespace wmbus_parser
 }  // namespace esphome
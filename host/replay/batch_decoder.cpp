@@ -0,0 +1,365 @@
+#include "batch_decoder.h"
+#include "work_stealing_pool.h"
+
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "frame_check.h"
+#include "raw_capture.h"
+#include "telegram_corpus.h"
+#include "telegram_crypto.h"
+#include "telegram_json.h"
+
+namespace wmbus_host {
+
+using esphome::wmbus_parser::MeterIndex;
+using esphome::wmbus_parser::TelegramView;
+
+namespace {
+
+// CSV columns in the order DecodedTelegram::for_each_attribute emits them.
+const std::vector<std::string> &csv_columns() {
+  static const std::vector<std::string> columns = [] {
+    std::vector<std::string> c = {
+        "total_m3",
+        "timestamp",
+        "device_date_time",
+        "fabrication_no",
+        "current_status",
+        "consumption_at_set_date_m3",
+        "set_date",
+        "consumption_at_set_date_2_m3",
+        "set_date_2",
+        "max_flow_since_datetime_m3h",
+        "max_flow_datetime",
+        "history_reference_date",
+        "volume_flow_m3h",
+        "total_energy_kwh",
+        "power_kw",
+        "flow_temperature_c",
+        "return_temperature_c",
+    };
+    char key[esphome::wmbus_parser::ATTRIBUTE_KEY_SIZE];
+    for (size_t i = 0; i < DecodedTelegram::MAX_HISTORY; i++) {
+      DecodedTelegram::history_key(key, sizeof(key), i);
+      c.emplace_back(key);
+    }
+    c.emplace_back("history_interval_months");
+    return c;
+  }();
+  return columns;
+}
+
+void append_address(std::string &out, uint32_t address) {
+  char buf[9];
+  esphome::wmbus_parser::format_meter_id(address, buf);
+  out += buf;
+}
+
+}  // namespace
+
+BatchDecoder::BatchDecoder(const BatchOptions &options) : options_(options) {
+  const auto *driver = esphome::wmbus_parser::find_driver(options.driver);
+  this->decode_fn_ = driver != nullptr ? driver->decode : nullptr;
+  this->detect_driver_ = options.driver == "auto";
+  for (size_t i = 0; i < options.meters.size(); i++)
+    this->filter_.insert(options.meters[i], static_cast<uint16_t>(i));
+}
+
+bool BatchDecoder::init(std::string &error) {
+  for (const auto &entry : this->options_.keys) {
+    uint8_t key[esphome::wmbus_parser::Aes128::KEY_SIZE];
+    if (!esphome::wmbus_parser::parse_aes_key(entry.second, key)) {
+      error = "invalid key '" + entry.second + "' (expected 32 hex digits)";
+      return false;
+    }
+    auto cipher = std::make_unique<esphome::wmbus_parser::Aes128>();
+    cipher->set_key(key);
+    this->key_index_.insert(entry.first, static_cast<uint16_t>(this->ciphers_.size()));
+    this->ciphers_.push_back(std::move(cipher));
+  }
+  return true;
+}
+
+std::vector<BatchDecoder::Chunk> BatchDecoder::split_(const uint8_t *data, size_t size) const {
+  std::vector<Chunk> chunks;
+  const uint8_t *end = data + size;
+  const uint8_t *begin = data;
+  size_t chunk_bytes = this->options_.chunk_bytes == 0 ? size : this->options_.chunk_bytes;
+  while (begin < end) {
+    size_t remaining = static_cast<size_t>(end - begin);
+    const uint8_t *split = begin + (chunk_bytes < remaining ? chunk_bytes : remaining);
+    // Extend the chunk to the end of the line it cuts into.
+    while (split < end && split[-1] != '\n')
+      ++split;
+    Chunk chunk;
+    chunk.begin = begin;
+    chunk.end = split;
+    chunks.push_back(std::move(chunk));
+    begin = split;
+  }
+  return chunks;
+}
+
+std::vector<BatchDecoder::Chunk> BatchDecoder::split_capture_(const uint8_t *data, size_t size,
+                                                              std::string &error) const {
+  using namespace esphome::wmbus_parser;
+  std::vector<Chunk> chunks;
+  size_t chunk_bytes = this->options_.chunk_bytes == 0 ? size : this->options_.chunk_bytes;
+  size_t pos = CAPTURE_FILE_HEADER_SIZE;
+  size_t chunk_start = pos;
+  CaptureRecord record;
+  // Records carry their own length, so the boundaries are found by hopping
+  // from header to header without touching the frame bytes.
+  while (parse_capture_record(data, size, pos, record)) {
+    if (pos - chunk_start >= chunk_bytes || pos == size) {
+      Chunk chunk;
+      chunk.binary = true;
+      chunk.begin = data + chunk_start;
+      chunk.end = data + pos;
+      chunks.push_back(std::move(chunk));
+      chunk_start = pos;
+    }
+  }
+  if (pos != size)
+    error = "truncated capture record at offset " + std::to_string(pos);
+  return chunks;
+}
+
+void BatchDecoder::append_record_(Chunk &chunk, uint32_t address, const char *status,
+                                  const DecodedTelegram *decoded) const {
+  std::string &out = chunk.text;
+  if (this->options_.format == OutputFormat::CSV) {
+    append_address(out, address);
+    out += ',';
+    out += status;
+    const auto &columns = csv_columns();
+    size_t column = 0;
+    if (decoded != nullptr) {
+      decoded->for_each_attribute([&](const char *key, const char *value) {
+        while (column < columns.size() && columns[column] != key) {
+          out += ',';
+          ++column;
+        }
+        if (column < columns.size()) {
+          out += ',';
+          out += value;
+          ++column;
+        }
+      });
+    }
+    for (; column < columns.size(); column++)
+      out += ',';
+    out += '\n';
+  } else {
+    // The status, then the members of the object on_decode_json gets on the
+    // device, so both sides can be compared byte for byte.
+    out += "\"status\":\"";
+    out += status;
+    out += "\",";
+    if (decoded != nullptr) {
+      char meter_id[9];
+      esphome::wmbus_parser::format_meter_id(address, meter_id);
+      char json[esphome::wmbus_parser::TELEGRAM_JSON_MAX_SIZE];
+      const size_t length = esphome::wmbus_parser::format_telegram_json(json, sizeof(json), meter_id, *decoded);
+      out.append(json + 1, length - 1);
+    } else {
+      out += "\"meter_id\":\"";
+      append_address(out, address);
+      out += "\"}";
+    }
+    out += '\n';
+  }
+  chunk.record_ends.push_back(static_cast<uint32_t>(out.size()));
+}
+
+void BatchDecoder::decode_chunk_(Chunk &chunk) const {
+  DecodedTelegram decoded;
+  if (chunk.binary) {
+    esphome::wmbus_parser::CaptureRecord record;
+    size_t pos = 0;
+    const size_t size = chunk.end - chunk.begin;
+    while (esphome::wmbus_parser::parse_capture_record(chunk.begin, size, pos, record))
+      this->decode_frame_(chunk, record.data, record.length,
+                          this->options_.t1 || (record.flags & esphome::wmbus_parser::CAPTURE_FLAG_T1) != 0, decoded);
+    return;
+  }
+
+  Frame frame;
+  std::string line;
+  const uint8_t *p = chunk.begin;
+  while (p < chunk.end) {
+    const uint8_t *eol = static_cast<const uint8_t *>(memchr(p, '\n', chunk.end - p));
+    if (eol == nullptr)
+      eol = chunk.end;
+    line.assign(reinterpret_cast<const char *>(p), eol - p);
+    p = eol + 1;
+
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+      continue;
+
+    if (!parse_hex_frame(line, frame)) {
+      chunk.stats.frames++;
+      chunk.stats.failed++;
+      this->append_record_(chunk, 0, "invalid_hex", nullptr);
+      continue;
+    }
+    this->decode_frame_(chunk, frame.data(), frame.size(), this->options_.t1, decoded);
+  }
+}
+
+void BatchDecoder::decode_frame_(Chunk &chunk, const uint8_t *frame, size_t len, bool allow_t1,
+                                 DecodedTelegram &decoded) const {
+  using esphome::wmbus_parser::FrameError;
+  chunk.stats.frames++;
+  uint8_t checked[esphome::wmbus_parser::TELEGRAM_MAX_FRAME_SIZE];
+  TelegramView telegram = TelegramView::from_frame(frame, len);
+  FrameError error = telegram.size() < esphome::wmbus_parser::FRAME_MIN_PAYLOAD ? FrameError::TOO_SHORT
+                                                                                 : FrameError::NONE;
+  bool t1 = false;
+  // Same limit as receive_packet, ahead of and independent of the CRC check.
+  const size_t max_len = allow_t1 ? esphome::wmbus_parser::FRAME_MAX_T1_SIZE : sizeof(checked);
+  const char *rejected = nullptr;
+  if (len > max_len) {
+    rejected = "oversized";
+  } else if (allow_t1) {
+    size_t checked_len = 0;
+    error = esphome::wmbus_parser::check_c1_or_t1_frame(frame, len, checked, checked_len, t1);
+    telegram = TelegramView(checked, checked_len);
+  } else if (this->options_.check_crc) {
+    size_t checked_len = 0;
+    error = esphome::wmbus_parser::check_frame(frame, len, checked, checked_len);
+    telegram = TelegramView(checked, checked_len);
+  }
+  if (rejected == nullptr && error != FrameError::NONE)
+    rejected = esphome::wmbus_parser::frame_error_to_string(error);
+  if (rejected != nullptr) {
+    chunk.stats.failed++;
+    // Report the unverified address where there is one, it helps finding the
+    // sender. Encoded T1 frames have none.
+    const TelegramView raw = TelegramView::from_frame(frame, len);
+    uint32_t address = !t1 && raw.size() >= esphome::wmbus_parser::TELEGRAM_ID_FIELD + 4 ? raw.address() : 0;
+    this->append_record_(chunk, address, rejected, nullptr);
+    return;
+  }
+  const uint32_t address = telegram.address();
+  if (this->filter_.size() > 0 && this->filter_.find(address) == MeterIndex::NOT_FOUND) {
+    chunk.stats.skipped++;
+    return;
+  }
+  uint8_t plain[esphome::wmbus_parser::TELEGRAM_MAX_FRAME_SIZE];
+  uint16_t key_slot = this->key_index_.find(address);
+  const esphome::wmbus_parser::Aes128 *cipher =
+      key_slot != MeterIndex::NOT_FOUND ? this->ciphers_[key_slot].get() : nullptr;
+  auto crypt = telegram.size() <= sizeof(plain) ? esphome::wmbus_parser::decrypt_telegram(telegram, cipher, plain)
+                                                : esphome::wmbus_parser::DecryptResult::BAD_LENGTH;
+  if (crypt == esphome::wmbus_parser::DecryptResult::OK) {
+    telegram = TelegramView(plain, telegram.size());
+  } else if (crypt != esphome::wmbus_parser::DecryptResult::NOT_ENCRYPTED) {
+    chunk.stats.failed++;
+    this->append_record_(chunk, address, esphome::wmbus_parser::decrypt_result_to_string(crypt), nullptr);
+    return;
+  }
+  esphome::wmbus_parser::DecodeFn decode = this->decode_fn_;
+  if (this->detect_driver_) {
+    // The link header is never encrypted, so the decrypted copy has the same one.
+    const auto *driver = esphome::wmbus_parser::detect_driver(telegram);
+    if (driver == nullptr) {
+      chunk.stats.failed++;
+      this->append_record_(chunk, address, "no_driver", nullptr);
+      return;
+    }
+    decode = driver->decode;
+  }
+  if (decode == nullptr || !decode(telegram, decoded)) {
+    chunk.stats.failed++;
+    this->append_record_(chunk, address, "decode_failed", nullptr);
+    return;
+  }
+  chunk.stats.decoded++;
+  this->append_record_(chunk, address, "ok", &decoded);
+}
+
+void BatchDecoder::write_header_(FILE *out) const {
+  if (this->options_.format != OutputFormat::CSV)
+    return;
+  std::string header = "index,meter_id,status";
+  for (const auto &column : csv_columns()) {
+    header += ',';
+    header += column;
+  }
+  header += '\n';
+  fwrite(header.data(), 1, header.size(), out);
+}
+
+void BatchDecoder::write_chunk_(FILE *out, const Chunk &chunk, uint64_t &index) const {
+  uint32_t start = 0;
+  for (uint32_t end : chunk.record_ends) {
+    if (this->options_.format == OutputFormat::CSV) {
+      fprintf(out, "%llu,", static_cast<unsigned long long>(index));
+    } else {
+      fprintf(out, "{\"index\":%llu,", static_cast<unsigned long long>(index));
+    }
+    fwrite(chunk.text.data() + start, 1, end - start, out);
+    start = end;
+    index++;
+  }
+}
+
+bool BatchDecoder::run(const uint8_t *data, size_t size, FILE *out, BatchStats &stats, std::string &error) {
+  if (this->decode_fn_ == nullptr && !this->detect_driver_) {
+    error = "unknown driver '" + this->options_.driver + "' (built in:";
+    for (size_t i = 0; i < esphome::wmbus_parser::driver_count(); i++)
+      error += std::string(" ") + esphome::wmbus_parser::driver_at(i).name;
+    error += ")";
+    return false;
+  }
+
+  std::vector<Chunk> chunks;
+  if (esphome::wmbus_parser::is_capture_file(data, size)) {
+    chunks = this->split_capture_(data, size, error);
+    if (!error.empty())
+      return false;
+  } else {
+    chunks = this->split_(data, size);
+  }
+  std::unique_ptr<bool[]> done(new bool[chunks.size()]());
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  size_t threads = this->options_.threads != 0 ? this->options_.threads : std::thread::hardware_concurrency();
+  WorkStealingPool pool(threads);
+  pool.start(chunks.size(), [&](size_t i) {
+    this->decode_chunk_(chunks[i]);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      done[i] = true;
+    }
+    cv.notify_all();
+  });
+
+  // Stream chunks out in input order while the pool keeps decoding.
+  this->write_header_(out);
+  uint64_t index = 0;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return done[i]; });
+    }
+    this->write_chunk_(out, chunks[i], index);
+    stats.frames += chunks[i].stats.frames;
+    stats.decoded += chunks[i].stats.decoded;
+    stats.failed += chunks[i].stats.failed;
+    stats.skipped += chunks[i].stats.skipped;
+    std::string().swap(chunks[i].text);
+    std::vector<uint32_t>().swap(chunks[i].record_ends);
+  }
+  pool.join();
+  return true;
+}
+
+}  // namespace wmbus_host
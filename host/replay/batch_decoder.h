@@ -0,0 +1,91 @@
+/**
+ * Parallel offline decoder for recorded telegram captures.
+ *
+ * The capture is either a hex corpus (one frame per line) or a binary raw
+ * capture (raw_capture.h). It is split into chunks at frame boundaries, the
+ * chunks are
+ * decoded on a work-stealing pool with a driver from the driver table, and the results
+ * are written in input order as CSV or JSON lines while later chunks are
+ * still being decoded.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aes128.h"
+#include "driver_table.h"
+#include "meter_index.h"
+
+namespace wmbus_host {
+
+using esphome::wmbus_parser::DecodedTelegram;
+
+enum class OutputFormat { CSV, JSON };
+
+struct BatchOptions {
+  // Driver name, or "auto" to pick one per frame from the link header.
+  std::string driver{"evo868"};
+  // Only decode these addresses; empty decodes every frame.
+  std::vector<uint32_t> meters;
+  // AES-128 keys (32 hex digits) for encrypted meters.
+  std::vector<std::pair<uint32_t, std::string>> keys;
+  OutputFormat format{OutputFormat::CSV};
+  // Verify and strip the link-layer block CRCs as the component does.
+  bool check_crc{true};
+  // Accept 3-of-6 encoded T1 frames next to C1 frames, as the component's
+  // t1_mode does. Binary captures flag T1 records themselves.
+  bool t1{false};
+  size_t threads{0};  // 0 = all cores
+  size_t chunk_bytes{256 * 1024};
+};
+
+struct BatchStats {
+  uint64_t frames{0};
+  uint64_t decoded{0};
+  uint64_t failed{0};  // includes frames rejected by the link-layer checks
+  uint64_t skipped{0};
+};
+
+class BatchDecoder {
+ public:
+  explicit BatchDecoder(const BatchOptions &options);
+  /// False if a key in the options is malformed; ``error`` names it.
+  bool init(std::string &error);
+
+  /// Decode a hex or binary capture held in memory and write one record per
+  /// frame to ``out``.
+  bool run(const uint8_t *data, size_t size, FILE *out, BatchStats &stats, std::string &error);
+
+ protected:
+  struct Chunk {
+    bool binary{false};
+    const uint8_t *begin{nullptr};
+    const uint8_t *end{nullptr};
+    std::string text;               // records without their index field
+    std::vector<uint32_t> record_ends;
+    BatchStats stats;
+  };
+
+  std::vector<Chunk> split_(const uint8_t *data, size_t size) const;
+  std::vector<Chunk> split_capture_(const uint8_t *data, size_t size, std::string &error) const;
+  void decode_chunk_(Chunk &chunk) const;
+  void decode_frame_(Chunk &chunk, const uint8_t *frame, size_t len, bool allow_t1, DecodedTelegram &decoded) const;
+  void append_record_(Chunk &chunk, uint32_t address, const char *status,
+                      const DecodedTelegram *decoded) const;
+  void write_header_(FILE *out) const;
+  void write_chunk_(FILE *out, const Chunk &chunk, uint64_t &index) const;
+
+  BatchOptions options_;
+  esphome::wmbus_parser::DecodeFn decode_fn_{nullptr};
+  bool detect_driver_{false};
+  esphome::wmbus_parser::MeterIndex filter_;
+  esphome::wmbus_parser::MeterIndex key_index_;
+  std::vector<std::unique_ptr<esphome::wmbus_parser::Aes128>> ciphers_;
+};
+
+}  // namespace wmbus_host
@@ -0,0 +1,49 @@
+#include "mapped_file.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace wmbus_host {
+
+bool MappedFile::open(const std::string &path, std::string &error) {
+  this->close();
+  this->fd_ = ::open(path.c_str(), O_RDONLY);
+  if (this->fd_ < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat st {};
+  if (::fstat(this->fd_, &st) != 0) {
+    error = "cannot stat " + path + ": " + std::strerror(errno);
+    this->close();
+    return false;
+  }
+  this->size_ = static_cast<size_t>(st.st_size);
+  if (this->size_ == 0)
+    return true;
+  void *addr = ::mmap(nullptr, this->size_, PROT_READ, MAP_PRIVATE, this->fd_, 0);
+  if (addr == MAP_FAILED) {
+    error = "cannot map " + path + ": " + std::strerror(errno);
+    this->close();
+    return false;
+  }
+  ::madvise(addr, this->size_, MADV_SEQUENTIAL);
+  this->data_ = static_cast<const uint8_t *>(addr);
+  return true;
+}
+
+void MappedFile::close() {
+  if (this->data_ != nullptr)
+    ::munmap(const_cast<uint8_t *>(this->data_), this->size_);
+  if (this->fd_ >= 0)
+    ::close(this->fd_);
+  this->data_ = nullptr;
+  this->size_ = 0;
+  this->fd_ = -1;
+}
+
+}  // namespace wmbus_host
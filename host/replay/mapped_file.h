@@ -0,0 +1,31 @@
+/**
+ * Read-only memory mapping of a capture file.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace wmbus_host {
+
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { this->close(); }
+
+  bool open(const std::string &path, std::string &error);
+  void close();
+
+  const uint8_t *data() const { return this->data_; }
+  size_t size() const { return this->size_; }
+
+ protected:
+  const uint8_t *data_{nullptr};
+  size_t size_{0};
+  int fd_{-1};
+};
+
+}  // namespace wmbus_host
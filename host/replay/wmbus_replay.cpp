@@ -0,0 +1,185 @@
+/**
+ * Offline re-decoding of recorded telegram captures.
+ *
+ * Usage: wmbus_replay [--driver NAME] [--meter ID ...] [--key ID:KEY ...] [--format csv|json] [--no-crc]
+ *                     [--t1] [--threads N] [--chunk-bytes N] [--output FILE] [--verbose] capture
+ *        wmbus_replay --dump-hex [--output FILE] capture.bin
+ *
+ * The capture (hex corpus or binary raw capture) is memory-mapped and decoded
+ * on all cores; one CSV row or JSON line is written per frame, in input order.
+ * A summary goes to stderr. --driver auto picks the driver of each frame from
+ * its link header, as the component's driver: auto does. --key supplies the AES key of an encrypted meter
+ * and can be repeated. --t1 also accepts 3-of-6 encoded T1 frames, as the
+ * component's t1_mode does; binary captures flag T1 frames themselves.
+ * --dump-hex converts a binary raw capture into a hex corpus instead, with
+ * the receive time and flags as comment lines.
+ */
+#include "batch_decoder.h"
+#include "mapped_file.h"
+
+#include "esphome/core/log.h"
+#include "hex_encode.h"
+#include "meter_index.h"
+#include "raw_capture.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace wmbus_host;
+
+namespace {
+
+void usage(const char *argv0) {
+  std::fprintf(stderr,
+               "usage: %s [--driver NAME] [--meter ID ...] [--key ID:KEY ...] [--format csv|json] [--no-crc]\n"
+               "          [--t1] [--threads N] [--chunk-bytes N] [--output FILE] [--verbose] capture\n"
+               "       %s --dump-hex [--output FILE] capture.bin\n",
+               argv0, argv0);
+}
+
+bool dump_hex(const uint8_t *data, size_t size, FILE *out, std::string &error) {
+  using namespace esphome::wmbus_parser;
+  if (!is_capture_file(data, size)) {
+    error = "not a raw capture file";
+    return false;
+  }
+  std::vector<char> hex(2 * 0xFFFF + 1);
+  size_t pos = CAPTURE_FILE_HEADER_SIZE;
+  CaptureRecord record;
+  while (parse_capture_record(data, size, pos, record)) {
+    hex_encode(record.data, record.length, hex.data());
+    std::fprintf(out, "# t=%u ms flags=%02X\n%s\n", static_cast<unsigned>(record.timestamp_ms), record.flags,
+                 hex.data());
+  }
+  if (pos != size) {
+    error = "truncated capture record at offset " + std::to_string(pos);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  BatchOptions options;
+  std::string input;
+  std::string output;
+  bool verbose = false;
+  bool to_hex = false;
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    bool has_value = i + 1 < argc;
+    if (std::strcmp(arg, "--driver") == 0 && has_value) {
+      options.driver = argv[++i];
+    } else if (std::strcmp(arg, "--meter") == 0 && has_value) {
+      uint32_t address;
+      if (!esphome::wmbus_parser::parse_meter_id(argv[++i], address)) {
+        std::fprintf(stderr, "invalid meter id '%s'\n", argv[i]);
+        return 2;
+      }
+      options.meters.push_back(address);
+    } else if (std::strcmp(arg, "--key") == 0 && has_value) {
+      std::string value = argv[++i];
+      size_t colon = value.find(':');
+      uint32_t address;
+      if (colon == std::string::npos || !esphome::wmbus_parser::parse_meter_id(value.substr(0, colon), address)) {
+        std::fprintf(stderr, "invalid --key '%s' (expected ID:KEY)\n", argv[i]);
+        return 2;
+      }
+      options.keys.emplace_back(address, value.substr(colon + 1));
+    } else if (std::strcmp(arg, "--format") == 0 && has_value) {
+      const char *format = argv[++i];
+      if (std::strcmp(format, "csv") == 0) {
+        options.format = OutputFormat::CSV;
+      } else if (std::strcmp(format, "json") == 0) {
+        options.format = OutputFormat::JSON;
+      } else {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (std::strcmp(arg, "--threads") == 0 && has_value) {
+      options.threads = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strcmp(arg, "--chunk-bytes") == 0 && has_value) {
+      options.chunk_bytes = std::strtoul(argv[++i], nullptr, 10);
+    } else if (std::strcmp(arg, "--output") == 0 && has_value) {
+      output = argv[++i];
+    } else if (std::strcmp(arg, "--no-crc") == 0) {
+      options.check_crc = false;
+    } else if (std::strcmp(arg, "--t1") == 0) {
+      options.t1 = true;
+    } else if (std::strcmp(arg, "--dump-hex") == 0) {
+      to_hex = true;
+    } else if (std::strcmp(arg, "--verbose") == 0) {
+      verbose = true;
+    } else if (arg[0] == '-' || !input.empty()) {
+      usage(argv[0]);
+      return 2;
+    } else {
+      input = arg;
+    }
+  }
+  if (input.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  // Driver warnings for every bad frame would swamp the output.
+  esphome::host::log_level = verbose ? esphome::ESPHOME_LOG_LEVEL_WARN : esphome::ESPHOME_LOG_LEVEL_NONE;
+
+  std::string error;
+  MappedFile capture;
+  if (!capture.open(input, error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (!output.empty()) {
+    out = std::fopen(output.c_str(), "w");
+    if (out == nullptr) {
+      std::fprintf(stderr, "cannot write %s\n", output.c_str());
+      return 1;
+    }
+  }
+
+  if (to_hex) {
+    bool ok = dump_hex(capture.data(), capture.size(), out, error);
+    if (out != stdout)
+      std::fclose(out);
+    if (!ok) {
+      std::fprintf(stderr, "%s\n", error.c_str());
+      return 1;
+    }
+    return 0;
+  }
+
+  BatchDecoder decoder(options);
+  if (!decoder.init(error)) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 2;
+  }
+  BatchStats stats;
+  auto start = std::chrono::steady_clock::now();
+  bool ok = decoder.run(capture.data(), capture.size(), out, stats, error);
+  auto end = std::chrono::steady_clock::now();
+  if (out != stdout)
+    std::fclose(out);
+  else
+    std::fflush(out);
+  if (!ok) {
+    std::fprintf(stderr, "%s\n", error.c_str());
+    return 1;
+  }
+
+  double seconds = std::chrono::duration<double>(end - start).count();
+  std::fprintf(stderr, "%llu frames: %llu decoded, %llu failed, %llu skipped in %.3f s (%.0f frames/s)\n",
+               static_cast<unsigned long long>(stats.frames), static_cast<unsigned long long>(stats.decoded),
+               static_cast<unsigned long long>(stats.failed), static_cast<unsigned long long>(stats.skipped), seconds,
+               seconds > 0 ? static_cast<double>(stats.frames) / seconds : 0.0);
+  return 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * Minimal work-stealing scheduler for batch decoding.
+ *
+ * Task indices are dealt to per-thread deques in contiguous blocks. A thread
+ * takes work from the front of its own deque (lowest index first, which keeps
+ * in-order output flowing) and steals from the back of the others when it runs
+ * dry.
+ */
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wmbus_host {
+
+class WorkStealingPool {
+ public:
+  explicit WorkStealingPool(size_t threads) : queues_(threads == 0 ? 1 : threads) {}
+
+  size_t thread_count() const { return this->queues_.size(); }
+
+  /// Start running ``fn(task)`` for every task in [0, count) on the pool
+  /// threads. Returns immediately; call join() to wait for completion.
+  void start(size_t count, std::function<void(size_t)> fn) {
+    this->fn_ = std::move(fn);
+    size_t threads = this->queues_.size();
+    size_t per_thread = (count + threads - 1) / threads;
+    for (size_t t = 0; t < threads; t++) {
+      size_t begin = t * per_thread;
+      size_t end = begin + per_thread < count ? begin + per_thread : count;
+      for (size_t i = begin; i < end; i++)
+        this->queues_[t].tasks.push_back(i);
+    }
+    for (size_t t = 0; t < threads; t++)
+      this->threads_.emplace_back(&WorkStealingPool::worker_, this, t);
+  }
+
+  void join() {
+    for (auto &thread : this->threads_)
+      thread.join();
+    this->threads_.clear();
+  }
+
+  ~WorkStealingPool() { this->join(); }
+
+ protected:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+  };
+
+  bool pop_own_(size_t self, size_t &task) {
+    Queue &q = this->queues_[self];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+      return false;
+    task = q.tasks.front();
+    q.tasks.pop_front();
+    return true;
+  }
+
+  bool steal_(size_t self, size_t &task) {
+    size_t threads = this->queues_.size();
+    for (size_t offset = 1; offset < threads; offset++) {
+      Queue &q = this->queues_[(self + offset) % threads];
+      std::lock_guard<std::mutex> lock(q.mutex);
+      if (q.tasks.empty())
+        continue;
+      task = q.tasks.back();
+      q.tasks.pop_back();
+      return true;
+    }
+    return false;
+  }
+
+  void worker_(size_t self) {
+    size_t task;
+    while (this->pop_own_(self, task) || this->steal_(self, task))
+      this->fn_(task);
+  }
+
+  std::vector<Queue> queues_;
+  std::vector<std::thread> threads_;
+  std::function<void(size_t)> fn_;
+};
+
+}  // namespace wmbus_host
@@ -0,0 +1,19 @@
+/**
+ * Host-side stand-in for the ESPHome umbrella header.
+ *
+ * Only the pieces used by the wmbus_parser component are provided so the
+ * parser and drivers can be compiled and benchmarked on Linux.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "esphome/core/automation.h"
+#include "esphome/core/component.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+#include "esphome/components/sensor/sensor.h"
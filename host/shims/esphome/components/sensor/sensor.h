@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace esphome {
+namespace sensor {
+
+class Sensor {
+ public:
+  Sensor() = default;
+  explicit Sensor(const std::string &name) : name_(name) {}
+
+  void publish_state(float state) {
+    this->state = state;
+    this->has_state_ = true;
+    for (auto &cb : this->callbacks_)
+      cb(state);
+  }
+
+  void add_on_state_callback(std::function<void(float)> &&cb) { this->callbacks_.push_back(std::move(cb)); }
+
+  bool has_state() const { return this->has_state_; }
+  const std::string &get_name() const { return this->name_; }
+
+  float state{NAN};
+
+ protected:
+  std::string name_;
+  bool has_state_{false};
+  std::vector<std::function<void(float)>> callbacks_;
+};
+
+}  // namespace sensor
+}  // namespace esphome
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+namespace esphome {
+
+/// Minimal Trigger: automations are plain callbacks attached from host code.
+template<typename... Ts> class Trigger {
+ public:
+  void trigger(Ts... x) {
+    for (auto &cb : this->callbacks_)
+      cb(x...);
+  }
+
+  void add_callback(std::function<void(Ts...)> &&cb) { this->callbacks_.push_back(std::move(cb)); }
+
+ protected:
+  std::vector<std::function<void(Ts...)>> callbacks_;
+};
+
+}  // namespace esphome
@@ -0,0 +1,18 @@
+#pragma once
+
+// Platform define for the host build; selects std::thread based workers.
+#ifndef USE_HOST
+#define USE_HOST
+#endif
+
+// The host tools decode with every driver; firmware builds only get the
+// drivers named in YAML (see __init__.py).
+#ifndef USE_WMBUS_DRIVER_EVO868
+#define USE_WMBUS_DRIVER_EVO868
+#endif
+#ifndef USE_WMBUS_DRIVER_OMS_HEAT
+#define USE_WMBUS_DRIVER_OMS_HEAT
+#endif
+#ifndef USE_WMBUS_DRIVER_OMS_WATER
+#define USE_WMBUS_DRIVER_OMS_WATER
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace esphome {
+
+inline uint32_t micros() {
+  using namespace std::chrono;
+  static const auto start = steady_clock::now();
+  return static_cast<uint32_t>(duration_cast<microseconds>(steady_clock::now() - start).count());
+}
+
+inline uint32_t millis() { return micros() / 1000; }
+
+}  // namespace esphome
@@ -0,0 +1,23 @@
+#include "esphome/core/log.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+namespace esphome {
+namespace host {
+
+int log_level = ESPHOME_LOG_LEVEL_DEBUG;
+
+void log_printf(int level, const char *tag, int line, const char *format, ...) {
+  static const char LETTERS[] = "?EWICDVV";
+  char letter = (level >= 0 && level < 8) ? LETTERS[level] : '?';
+  std::fprintf(stderr, "[%c][%s:%d]: ", letter, tag, line);
+  va_list args;
+  va_start(args, format);
+  std::vfprintf(stderr, format, args);
+  va_end(args);
+  std::fputc('\n', stderr);
+}
+
+}  // namespace host
+}  // namespace esphome
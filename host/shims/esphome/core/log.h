@@ -0,0 +1,44 @@
+/**
+ * Host-side ESP_LOG* macros.
+ *
+ * Messages are written to stderr when their level is at or below the
+ * runtime level, so benchmarks can silence logging without recompiling.
+ */
+#pragma once
+
+namespace esphome {
+
+enum HostLogLevel {
+  ESPHOME_LOG_LEVEL_NONE = 0,
+  ESPHOME_LOG_LEVEL_ERROR = 1,
+  ESPHOME_LOG_LEVEL_WARN = 2,
+  ESPHOME_LOG_LEVEL_INFO = 3,
+  ESPHOME_LOG_LEVEL_CONFIG = 4,
+  ESPHOME_LOG_LEVEL_DEBUG = 5,
+  ESPHOME_LOG_LEVEL_VERBOSE = 6,
+  ESPHOME_LOG_LEVEL_VERY_VERBOSE = 7,
+};
+
+namespace host {
+
+extern int log_level;
+
+void log_printf(int level, const char *tag, int line, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+
+}  // namespace host
+}  // namespace esphome
+
+#define ESPHOME_HOST_LOG_(level, tag, ...) \
+  do { \
+    if ((level) <= ::esphome::host::log_level) \
+      ::esphome::host::log_printf((level), (tag), __LINE__, __VA_ARGS__); \
+  } while (0)
+
+#define ESP_LOGE(tag, ...) ESPHOME_HOST_LOG_(::esphome::ESPHOME_LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ESPHOME_HOST_LOG_(::esphome::ESPHOME_LOG_LEVEL_WARN, tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ESPHOME_HOST_LOG_(::esphome::ESPHOME_LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) ESPHOME_HOST_LOG_(::esphome::ESPHOME_LOG_LEVEL_CONFIG, tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ESPHOME_HOST_LOG_(::esphome::ESPHOME_LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ESPHOME_HOST_LOG_(::esphome::ESPHOME_LOG_LEVEL_VERBOSE, tag, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) ESPHOME_HOST_LOG_(::esphome::ESPHOME_LOG_LEVEL_VERY_VERBOSE, tag, __VA_ARGS__)
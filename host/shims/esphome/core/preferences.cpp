@@ -0,0 +1,109 @@
+#include "esphome/core/preferences.h"
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace esphome {
+
+namespace {
+
+// File layout: per record the type and length as little-endian uint32, then
+// the data.
+class HostPreferences : public ESPPreferences {
+ public:
+  ESPPreferenceObject make_preference(size_t length, uint32_t type, bool in_flash) override {
+    (void) in_flash;
+    auto &backend = this->backends_[type];
+    if (backend == nullptr)
+      backend.reset(new Backend(this, type, length));
+    return ESPPreferenceObject(backend.get());
+  }
+  ESPPreferenceObject make_preference(size_t length, uint32_t type) override {
+    return this->make_preference(length, type, false);
+  }
+
+  bool sync() override {
+    if (this->path_.empty())
+      return true;
+    FILE *file = std::fopen(this->path_.c_str(), "wb");
+    if (file == nullptr)
+      return false;
+    bool ok = true;
+    for (const auto &record : this->records_) {
+      const uint32_t header[2] = {record.first, static_cast<uint32_t>(record.second.size())};
+      ok &= std::fwrite(header, sizeof(header), 1, file) == 1;
+      ok &= std::fwrite(record.second.data(), 1, record.second.size(), file) == record.second.size();
+    }
+    ok &= std::fclose(file) == 0;
+    return ok;
+  }
+  bool reset() override {
+    this->records_.clear();
+    return this->sync();
+  }
+
+  bool open(const std::string &path) {
+    this->path_ = path;
+    this->records_.clear();
+    if (path.empty())
+      return true;
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr)
+      return true;  // nothing saved yet
+    uint32_t header[2];
+    bool ok = true;
+    while (std::fread(header, sizeof(header), 1, file) == 1) {
+      std::vector<uint8_t> data(header[1]);
+      if (std::fread(data.data(), 1, data.size(), file) != data.size()) {
+        ok = false;
+        break;
+      }
+      this->records_[header[0]] = std::move(data);
+    }
+    std::fclose(file);
+    return ok;
+  }
+
+ protected:
+  class Backend : public ESPPreferenceBackend {
+   public:
+    Backend(HostPreferences *parent, uint32_t type, size_t length) : parent_(parent), type_(type), length_(length) {}
+
+    bool save(const uint8_t *data, size_t len) override {
+      if (len != this->length_)
+        return false;
+      this->parent_->records_[this->type_].assign(data, data + len);
+      return true;
+    }
+    bool load(uint8_t *data, size_t len) override {
+      auto it = this->parent_->records_.find(this->type_);
+      if (it == this->parent_->records_.end() || it->second.size() != len || len != this->length_)
+        return false;
+      std::memcpy(data, it->second.data(), len);
+      return true;
+    }
+
+   protected:
+    HostPreferences *parent_;
+    uint32_t type_;
+    size_t length_;
+  };
+
+  std::string path_;
+  std::map<uint32_t, std::vector<uint8_t>> records_;
+  std::map<uint32_t, std::unique_ptr<Backend>> backends_;
+};
+
+HostPreferences host_preferences;
+
+}  // namespace
+
+ESPPreferences *global_preferences = &host_preferences;  // NOLINT
+
+namespace host {
+
+bool set_preferences_file(const std::string &path) { return host_preferences.open(path); }
+
+}  // namespace host
+}  // namespace esphome
@@ -0,0 +1,74 @@
+/**
+ * Host-side ESPHome preferences.
+ *
+ * Same interface as esphome/core/preferences.h. Saved records are kept in
+ * memory and written to a file on sync(), so a host tool can stop and pick up
+ * where it left off as a device does after a reboot.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace esphome {
+
+class ESPPreferenceBackend {
+ public:
+  virtual ~ESPPreferenceBackend() = default;
+  virtual bool save(const uint8_t *data, size_t len) = 0;
+  virtual bool load(uint8_t *data, size_t len) = 0;
+};
+
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  explicit ESPPreferenceObject(ESPPreferenceBackend *backend) : backend_(backend) {}
+
+  template<typename T> bool save(const T *src) {
+    if (this->backend_ == nullptr)
+      return false;
+    return this->backend_->save(reinterpret_cast<const uint8_t *>(src), sizeof(T));
+  }
+  template<typename T> bool load(T *dest) {
+    if (this->backend_ == nullptr)
+      return false;
+    return this->backend_->load(reinterpret_cast<uint8_t *>(dest), sizeof(T));
+  }
+
+ protected:
+  ESPPreferenceBackend *backend_{nullptr};
+};
+
+class ESPPreferences {
+ public:
+  virtual ~ESPPreferences() = default;
+  virtual ESPPreferenceObject make_preference(size_t length, uint32_t type, bool in_flash) = 0;
+  virtual ESPPreferenceObject make_preference(size_t length, uint32_t type) = 0;
+  virtual bool sync() = 0;
+  virtual bool reset() = 0;
+
+  template<typename T, typename std::enable_if<std::is_trivially_copyable<T>::value, bool>::type = true>
+  ESPPreferenceObject make_preference(uint32_t type, bool in_flash) {
+    return this->make_preference(sizeof(T), type, in_flash);
+  }
+  template<typename T, typename std::enable_if<std::is_trivially_copyable<T>::value, bool>::type = true>
+  ESPPreferenceObject make_preference(uint32_t type) {
+    return this->make_preference(sizeof(T), type);
+  }
+};
+
+extern ESPPreferences *global_preferences;  // NOLINT
+
+namespace host {
+
+/// Back global_preferences with ``path``: records saved there are loaded now
+/// and the file is rewritten on every sync(). An empty path keeps them in
+/// memory only (the default).
+bool set_preferences_file(const std::string &path);
+
+}  // namespace host
+}  // namespace esphome
@@ -0,0 +1,103 @@
+#include "telegram_corpus.h"
+
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+#include "raw_capture.h"
+
+namespace wmbus_host {
+
+namespace {
+
+int hex_value(char c) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+}  // namespace
+
+bool parse_hex_frame(const std::string &line, Frame &out) {
+  out.clear();
+  int high = -1;
+  for (char c : line) {
+    if (std::isspace(static_cast<unsigned char>(c)))
+      continue;
+    int v = hex_value(c);
+    if (v < 0)
+      return false;
+    if (high < 0) {
+      high = v;
+    } else {
+      out.push_back(static_cast<uint8_t>((high << 4) | v));
+      high = -1;
+    }
+  }
+  return high < 0 && !out.empty();
+}
+
+bool load_hex_corpus(const std::string &path, std::vector<Frame> &frames, std::string &error) {
+  std::ifstream in(path);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+  std::string line;
+  size_t line_no = 0;
+  Frame frame;
+  while (std::getline(in, line)) {
+    ++line_no;
+    size_t first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#')
+      continue;
+    if (!parse_hex_frame(line, frame)) {
+      error = path + ":" + std::to_string(line_no) + ": invalid hex frame";
+      return false;
+    }
+    frames.push_back(frame);
+  }
+  return true;
+}
+
+bool load_capture_file(const std::string &path, std::vector<Frame> &frames, std::string &error) {
+  using namespace esphome::wmbus_parser;
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+  const std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if (!is_capture_file(data.data(), data.size())) {
+    error = path + ": not a raw capture file";
+    return false;
+  }
+  size_t pos = CAPTURE_FILE_HEADER_SIZE;
+  CaptureRecord record;
+  while (parse_capture_record(data.data(), data.size(), pos, record))
+    frames.emplace_back(record.data, record.data + record.length);
+  if (pos != data.size()) {
+    error = path + ": truncated record at offset " + std::to_string(pos);
+    return false;
+  }
+  return true;
+}
+
+bool load_corpus(const std::string &path, std::vector<Frame> &frames, std::string &error) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    error = "cannot open " + path;
+    return false;
+  }
+  uint8_t header[esphome::wmbus_parser::CAPTURE_FILE_HEADER_SIZE] = {};
+  in.read(reinterpret_cast<char *>(header), sizeof(header));
+  if (esphome::wmbus_parser::is_capture_file(header, static_cast<size_t>(in.gcount())))
+    return load_capture_file(path, frames, error);
+  return load_hex_corpus(path, frames, error);
+}
+
+}  // namespace wmbus_host
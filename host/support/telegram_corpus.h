@@ -0,0 +1,24 @@
+/**
+ * Loader for recorded telegram corpora used by the host tools.
+ *
+ * A corpus is a text file with one hex-encoded frame per line. Blank lines
+ * and lines starting with '#' are ignored. Binary raw captures written by the
+ * component's capture sink (see raw_capture.h) are accepted as well.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wmbus_host {
+
+using Frame = std::vector<uint8_t>;
+
+bool parse_hex_frame(const std::string &line, Frame &out);
+bool load_hex_corpus(const std::string &path, std::vector<Frame> &frames, std::string &error);
+bool load_capture_file(const std::string &path, std::vector<Frame> &frames, std::string &error);
+/// Load a binary capture or a hex corpus, depending on the file header.
+bool load_corpus(const std::string &path, std::vector<Frame> &frames, std::string &error);
+
+}  // namespace wmbus_host
@@ -0,0 +1,102 @@
+// AES-128 and mode 5 decryption against known answers. The host build runs
+// the software AES, so these pin it to what mbedtls computes on the device.
+#include "test_harness.h"
+
+#include <cstring>
+
+#include "aes128.h"
+#include "frame_check.h"
+#include "telegram_corpus.h"
+#include "telegram_crypto.h"
+
+using namespace esphome::wmbus_parser;
+
+namespace {
+
+wmbus_host::Frame hex(const char *text) {
+  wmbus_host::Frame out;
+  CHECK(wmbus_host::parse_hex_frame(text, out));
+  return out;
+}
+
+void set_key(Aes128 &cipher, const char *key_hex) {
+  uint8_t key[Aes128::KEY_SIZE];
+  CHECK(parse_aes_key(key_hex, key));
+  cipher.set_key(key);
+}
+
+// Link-layer checked payload of corpus frame ``index``.
+std::vector<uint8_t> checked_frame(size_t index) {
+  std::vector<wmbus_host::Frame> frames;
+  std::string error;
+  CHECK(wmbus_host::load_corpus(wmbus_test::corpus_path("evo868.hex"), frames, error));
+  std::vector<uint8_t> out(TELEGRAM_MAX_FRAME_SIZE);
+  size_t len = 0;
+  if (index < frames.size())
+    CHECK(check_frame(frames[index].data(), frames[index].size(), out.data(), len) == FrameError::NONE);
+  out.resize(len);
+  return out;
+}
+
+}  // namespace
+
+// FIPS-197 appendix B and C.1.
+TEST(crypto, aes128_fips197_blocks) {
+  const struct {
+    const char *key, *plain, *cipher;
+  } vectors[] = {
+      {"2B7E151628AED2A6ABF7158809CF4F3C", "3243F6A8885A308D313198A2E0370734", "3925841D02DC09FBDC118597196A0B32"},
+      {"000102030405060708090A0B0C0D0E0F", "00112233445566778899AABBCCDDEEFF", "69C4E0D86A7B0430D8CDB78070B4C55A"},
+  };
+  for (const auto &v : vectors) {
+    Aes128 cipher;
+    set_key(cipher, v.key);
+    const auto in = hex(v.cipher);
+    uint8_t out[Aes128::BLOCK_SIZE];
+    cipher.decrypt_block(in.data(), out);
+    CHECK(hex(v.plain) == wmbus_host::Frame(out, out + sizeof(out)));
+  }
+}
+
+// NIST SP 800-38A F.2.2, CBC-AES128.Decrypt.
+TEST(crypto, aes128_cbc_sp800_38a) {
+  Aes128 cipher;
+  set_key(cipher, "2B7E151628AED2A6ABF7158809CF4F3C");
+  const auto iv = hex("000102030405060708090A0B0C0D0E0F");
+  auto data = hex("7649ABAC8119B246CEE98E9B12E9197D5086CB9B507219EE95DB113A917678B2"
+                  "73BED6B8E3C1743B7116E69E222295163FF1CAA1681FAC09120ECA307586E1A7");
+  cipher.decrypt_cbc(iv.data(), data.data(), data.size());
+  CHECK(data == hex("6BC1BEE22E409F96E93D7E117393172AAE2D8A571E03AC9C9EB76FAC45AF8E51"
+                    "30C81C46A35CE411E5FBC1191A0A52EFF69F2445DF4F9B17AD2B417BE66C3710"));
+}
+
+// Corpus frame 4 is the README frame as meter 23123047, encrypted with mode 5:
+// decrypted it has to be the README frame again, but for the address and
+// the configuration word.
+TEST(crypto, mode5_frame_decrypts_to_readme_frame) {
+  const auto plain = checked_frame(0);
+  const auto encrypted = checked_frame(4);
+  CHECK_EQ(encrypted.size(), plain.size());
+  Aes128 cipher;
+  set_key(cipher, "0F1E2D3C4B5A69788796A5B4C3D2E1F0");
+  std::vector<uint8_t> decrypted(encrypted.size());
+  CHECK(decrypt_telegram(TelegramView(encrypted.data(), encrypted.size()), &cipher, decrypted.data()) ==
+        DecryptResult::OK);
+  CHECK(TelegramView(decrypted.data(), decrypted.size()).address() == 0x23123047u);
+  for (size_t i = 0; i < plain.size() && i < decrypted.size(); i++) {
+    const bool address = i >= TELEGRAM_ID_FIELD && i < TELEGRAM_ID_FIELD + 4;
+    const bool config_word = i == TELEGRAM_CI_FIELD + 3 || i == TELEGRAM_CI_FIELD + 4;
+    if (!address && !config_word && decrypted[i] != plain[i]) {
+      wmbus_test::fail(__FILE__, __LINE__, "decrypted byte " + std::to_string(i) + " differs");
+      break;
+    }
+  }
+
+  // A wrong key fails the 0x2F 0x2F check rather than decoding garbage.
+  Aes128 wrong;
+  set_key(wrong, "00000000000000000000000000000000");
+  CHECK(decrypt_telegram(TelegramView(encrypted.data(), encrypted.size()), &wrong, decrypted.data()) ==
+        DecryptResult::BAD_KEY);
+  CHECK(decrypt_telegram(TelegramView(encrypted.data(), encrypted.size()), nullptr, decrypted.data()) ==
+        DecryptResult::NO_KEY);
+}
@@ -0,0 +1,99 @@
+// Known answers for the OMS drivers, from bench/corpus/oms_water.hex and
+// oms_heat.hex, and driver detection from the link header.
+#include "test_harness.h"
+
+#include <cstring>
+
+#include "driver_table.h"
+#include "frame_check.h"
+#include "oms_engine.h"
+#include "telegram_corpus.h"
+
+using namespace esphome::wmbus_parser;
+
+namespace {
+
+struct Checked {
+  uint8_t data[FRAME_MAX_STRIPPED_SIZE];
+  size_t size{0};
+
+  TelegramView view() const { return TelegramView(this->data, this->size); }
+};
+
+// The first frame of a corpus file, through the link-layer checks.
+Checked load_first(const char *name) {
+  std::vector<wmbus_host::Frame> frames;
+  std::string error;
+  Checked checked;
+  CHECK(wmbus_host::load_corpus(wmbus_test::corpus_path(name), frames, error));
+  CHECK(!frames.empty());
+  if (!frames.empty())
+    CHECK(check_frame(frames[0].data(), frames[0].size(), checked.data, checked.size) == FrameError::NONE);
+  return checked;
+}
+
+bool decode_with(const char *driver, const Checked &frame, DecodedTelegram &result) {
+  const DriverEntry *entry = find_driver(driver);
+  CHECK(entry != nullptr);
+  return entry != nullptr && entry->decode(frame.view(), result);
+}
+
+// The backflow volume of the water frame, named by its VIFE.
+constexpr oms::FieldRule BACKFLOW_RULES[] = {
+    oms::number(oms::VIF_VOLUME_M3, &DecodedTelegram::total_m3, FIELD_TOTAL_M3).with_vife(0x3C),
+};
+constexpr oms::Descriptor BACKFLOW{"test", FIELD_TOTAL_M3, TELEGRAM_LINK_HEADER_SIZE + 3};
+
+}  // namespace
+
+TEST(drivers, oms_water_frame) {
+  const Checked frame = load_first("oms_water.hex");
+  CHECK_EQ(frame.view().address(), 0x12345678u);
+  const DriverEntry *detected = detect_driver(frame.view());
+  CHECK(detected != nullptr && std::strcmp(detected->name, "oms_water") == 0);
+
+  DecodedTelegram result;
+  CHECK(decode_with("oms_water", frame, result));
+  // The backflow record comes first and must not be taken for the total.
+  CHECK_NEAR(result.total_m3, 123.456f, 1e-4f);
+  CHECK_NEAR(result.consumption_at_set_date_m3, 101.234f, 1e-4f);
+  CHECK(result.set_date == (Date{2024, 12, 31}));
+  CHECK(result.device_datetime == (DateTime{2025, 10, 15, 14, 30}));
+  CHECK_NEAR(result.volume_flow_m3h, 0.120f, 1e-6f);
+  CHECK_NEAR(result.flow_temperature_c, 12.5f, 1e-5f);
+  CHECK_STREQ(result.fabrication_no, "12345678");
+  CHECK(result.has(FIELD_STATUS));
+  CHECK_EQ(result.status_flags, 0u);
+  CHECK_EQ(result.history_interval_months, 1);
+  CHECK(result.has_history(0) && result.has_history(1) && !result.has_history(2));
+  CHECK_NEAR(result.history_m3[0], 98.765f, 1e-4f);
+  CHECK_NEAR(result.history_m3[1], 95.100f, 1e-4f);
+  CHECK(!result.has(FIELD_TOTAL_ENERGY));
+}
+
+TEST(drivers, oms_heat_frame) {
+  const Checked frame = load_first("oms_heat.hex");
+  CHECK_EQ(frame.view().address(), 0x76543210u);
+  const DriverEntry *detected = detect_driver(frame.view());
+  CHECK(detected != nullptr && std::strcmp(detected->name, "oms_heat") == 0);
+
+  DecodedTelegram result;
+  CHECK(decode_with("oms_heat", frame, result));
+  CHECK_NEAR(result.total_energy_kwh, 12345.0f, 1e-2f);
+  CHECK_NEAR(result.total_m3, 567.89f, 1e-3f);
+  CHECK_NEAR(result.power_kw, 12.3f, 1e-4f);
+  CHECK_NEAR(result.volume_flow_m3h, 1.234f, 1e-5f);
+  CHECK_NEAR(result.flow_temperature_c, 65.2f, 1e-4f);
+  CHECK_NEAR(result.return_temperature_c, 42.1f, 1e-4f);
+  CHECK(result.device_datetime == (DateTime{2025, 10, 15, 14, 30}));
+  CHECK(result.set_date == (Date{2024, 12, 31}));
+  CHECK_STREQ(result.fabrication_no, "87654321");
+  CHECK(!result.has(FIELD_CONSUMPTION_AT_SET_DATE));
+}
+
+TEST(drivers, vife_needs_a_rule_that_names_it) {
+  const Checked frame = load_first("oms_water.hex");
+  DecodedTelegram result;
+  CHECK(oms::decode<BACKFLOW_RULES>(BACKFLOW, frame.view(), result));
+  CHECK_NEAR(result.total_m3, 0.012f, 1e-6f);
+}
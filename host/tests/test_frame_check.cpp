@@ -0,0 +1,85 @@
+// Known answers for the T1 link layer: a 3-of-6 frame encoded outside the
+// repo (see the comments in bench/corpus/oms_water_t1.hex) against
+// check_t1_frame(), check_c1_or_t1_frame() and encode_three_of_six().
+#include "test_harness.h"
+
+#include <cstring>
+#include <vector>
+
+#include "frame_check.h"
+#include "telegram.h"
+#include "telegram_corpus.h"
+#include "three_of_six.h"
+
+using namespace esphome::wmbus_parser;
+
+namespace {
+
+enum T1Frame {
+  T1_VALID = 0,
+  T1_BAD_SYMBOL,
+  T1_COUNT,
+};
+
+std::vector<wmbus_host::Frame> load_corpus(const char *name, size_t count) {
+  std::vector<wmbus_host::Frame> frames;
+  std::string error;
+  CHECK(wmbus_host::load_corpus(wmbus_test::corpus_path(name), frames, error));
+  CHECK(frames.size() >= count);
+  frames.resize(count);
+  return frames;
+}
+
+}  // namespace
+
+TEST(frame_check, t1_frame_decodes) {
+  const auto t1 = load_corpus("oms_water_t1.hex", T1_COUNT);
+  const auto c1 = load_corpus("oms_water.hex", 1);
+  CHECK_EQ(t1[T1_VALID].size(), static_cast<size_t>(143));
+
+  uint8_t expected[FRAME_MAX_STRIPPED_SIZE];
+  size_t expected_len = 0;
+  CHECK(check_frame(c1[0].data(), c1[0].size(), expected, expected_len) == FrameError::NONE);
+
+  uint8_t out[FRAME_MAX_STRIPPED_SIZE];
+  size_t out_len = 0;
+  CHECK(check_t1_frame(t1[T1_VALID].data(), t1[T1_VALID].size(), out, out_len) == FrameError::NONE);
+  CHECK_EQ(out_len, static_cast<size_t>(83));
+  CHECK_EQ(out_len, expected_len);
+  CHECK(std::memcmp(out, expected, expected_len) == 0);
+  const TelegramView telegram(out, out_len);
+  CHECK_EQ(telegram.address(), 0x12345678u);
+  CHECK_EQ(static_cast<unsigned>(out[1]), 0x44u);  // C-field: SND_NR
+
+  bool is_t1 = false;
+  out_len = 0;
+  CHECK(check_c1_or_t1_frame(t1[T1_VALID].data(), t1[T1_VALID].size(), out, out_len, is_t1) == FrameError::NONE);
+  CHECK(is_t1);
+  CHECK_EQ(out_len, expected_len);
+  CHECK(std::memcmp(out, expected, expected_len) == 0);
+}
+
+TEST(frame_check, t1_invalid_symbol_is_rejected) {
+  const auto t1 = load_corpus("oms_water_t1.hex", T1_COUNT);
+  uint8_t out[FRAME_MAX_STRIPPED_SIZE];
+  size_t out_len = 0;
+  CHECK(check_t1_frame(t1[T1_BAD_SYMBOL].data(), t1[T1_BAD_SYMBOL].size(), out, out_len) ==
+        FrameError::BAD_SYMBOL);
+
+  // Not valid T1, so it is tried, and rejected, as C1 without its prefix.
+  bool is_t1 = true;
+  const FrameError error =
+      check_c1_or_t1_frame(t1[T1_BAD_SYMBOL].data(), t1[T1_BAD_SYMBOL].size(), out, out_len, is_t1);
+  CHECK(error != FrameError::NONE);
+  CHECK(!is_t1);
+}
+
+TEST(frame_check, three_of_six_encoder_matches) {
+  const auto t1 = load_corpus("oms_water_t1.hex", T1_COUNT);
+  const auto c1 = load_corpus("oms_water.hex", 1);
+  // The link layer after the 0x54 0xCD prefix.
+  const wmbus_host::Frame link(c1[0].begin() + 2, c1[0].end());
+  std::vector<uint8_t> encoded(three_of_six_encoded_size(link.size()));
+  encode_three_of_six(link.data(), link.size(), encoded.data());
+  CHECK(encoded == t1[T1_VALID]);
+}
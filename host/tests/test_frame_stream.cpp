@@ -0,0 +1,162 @@
+// FrameStream against check_frame(): the same bytes, cut into random chunks,
+// have to be accepted or rejected alike and give the same link layer.
+#include "test_harness.h"
+
+#include <random>
+#include <vector>
+
+#include "crc16.h"
+#include "frame_check.h"
+#include "frame_stream.h"
+
+using namespace esphome::wmbus_parser;
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+void append_crc(Bytes &frame, size_t begin) {
+  const uint16_t crc = crc16_en13757(frame.data() + begin, frame.size() - begin);
+  frame.push_back(static_cast<uint8_t>(crc >> 8));
+  frame.push_back(static_cast<uint8_t>(crc));
+}
+
+// Link layer without CRCs, data[0] is the L-field.
+Bytes format_a(const Bytes &data) {
+  Bytes frame;
+  for (size_t pos = 0; pos < data.size();) {
+    const size_t block = pos == 0 ? FRAME_A_FIRST_BLOCK : std::min(FRAME_A_BLOCK, data.size() - pos);
+    const size_t begin = frame.size();
+    frame.insert(frame.end(), data.begin() + pos, data.begin() + pos + block);
+    append_crc(frame, begin);
+    pos += block;
+  }
+  return frame;
+}
+
+Bytes format_b(const Bytes &data) {
+  Bytes frame(data.begin(), data.begin() + std::min(data.size(), FRAME_B_FIRST_BLOCKS));
+  append_crc(frame, 0);
+  if (data.size() > FRAME_B_FIRST_BLOCKS) {
+    const size_t begin = frame.size();
+    frame.insert(frame.end(), data.begin() + FRAME_B_FIRST_BLOCKS, data.end());
+    append_crc(frame, begin);
+  }
+  return frame;
+}
+
+Bytes random_bytes(std::mt19937 &rng, size_t count) {
+  Bytes bytes(count);
+  for (auto &byte : bytes)
+    byte = static_cast<uint8_t>(rng());
+  return bytes;
+}
+
+// A format B frame of ``total`` bytes whose bytes 10 and 11 are the format A
+// CRC of the first ten, so the first block alone does not tell them apart.
+Bytes format_b_passing_a_crc(std::mt19937 &rng, size_t total) {
+  Bytes data = random_bytes(rng, total <= FRAME_B_FIRST_BLOCKS + 2 ? total - 2 : total - 4);
+  data[0] = static_cast<uint8_t>(total - 1);
+  const uint16_t crc = crc16_en13757(data.data(), FRAME_A_FIRST_BLOCK);
+  data[10] = static_cast<uint8_t>(crc >> 8);
+  data[11] = static_cast<uint8_t>(crc);
+  return format_b(data);
+}
+
+// Feeds ``bytes`` in chunks of 1 to 40 bytes. True with the payload on FRAME.
+bool stream_frame(const Bytes &bytes, std::mt19937 &rng, Bytes &payload) {
+  FrameStream stream;
+  size_t pos = 0;
+  while (pos < bytes.size() && !stream.finished()) {
+    size_t chunk = std::min<size_t>(1 + rng() % 40, bytes.size() - pos);
+    while (chunk > 0 && !stream.finished()) {
+      FrameStream::Event event;
+      const size_t used = stream.feed(bytes.data() + pos, chunk, event);
+      pos += used;
+      chunk -= used;
+      if (event == FrameStream::Event::FRAME) {
+        payload.assign(stream.payload().data(), stream.payload().data() + stream.payload().size());
+        return true;
+      }
+      if (event == FrameStream::Event::ERROR)
+        return false;
+    }
+  }
+  return false;
+}
+
+bool check(const Bytes &bytes, Bytes &payload) {
+  uint8_t out[FRAME_MAX_STRIPPED_SIZE];
+  size_t out_len = 0;
+  if (check_frame(bytes.data(), bytes.size(), out, out_len) != FrameError::NONE)
+    return false;
+  payload.assign(out, out + out_len);
+  return true;
+}
+
+}  // namespace
+
+TEST(frame_stream, matches_check_frame) {
+  std::mt19937 rng(21);
+  size_t accepted = 0;
+  for (int i = 0; i < 20000; i++) {
+    const uint8_t l_field = static_cast<uint8_t>(rng());
+    Bytes data = random_bytes(rng, 1 + l_field);
+    data[0] = l_field;
+    Bytes frame;
+    const uint32_t kind = rng() % 5;
+    if (kind == 0 && format_a_size(l_field) != 0) {
+      frame = format_a(data);
+    } else if (kind == 1 && format_b_size(l_field) != 0) {
+      frame = format_b(Bytes(data.begin(), data.end() - (size_t{l_field} + 1 > FRAME_B_FIRST_BLOCKS + 2 ? 4 : 2)));
+    } else if (kind == 2 && format_b_size(l_field) != 0) {
+      frame = format_b_passing_a_crc(rng, format_b_size(l_field));
+    } else {
+      frame = data;
+    }
+    if (rng() % 4 == 0)
+      frame[rng() % frame.size()] ^= static_cast<uint8_t>(1 + rng() % 255);
+    if (rng() % 4 == 0) {
+      const bool a = kind == 0 || rng() % 2 == 0;
+      frame.insert(frame.begin(), {0x54, static_cast<uint8_t>(a ? 0xCD : 0x3D)});
+    }
+    if (rng() % 2 == 0) {
+      const Bytes padding = random_bytes(rng, rng() % 24);
+      frame.insert(frame.end(), padding.begin(), padding.end());
+    }
+
+    Bytes expected;
+    Bytes streamed;
+    const bool ok = check(frame, expected);
+    if (stream_frame(frame, rng, streamed) != ok || (ok && streamed != expected)) {
+      wmbus_test::fail(__FILE__, __LINE__, "case " + std::to_string(i) + " (L=" + std::to_string(l_field) +
+                                               ", kind " + std::to_string(kind) + "): check_frame " +
+                                               (ok ? "accepts" : "rejects") + " it, the stream does not agree");
+      return;
+    }
+    accepted += ok;
+  }
+  // Most of the generated frames are valid ones.
+  CHECK(accepted > 5000);
+}
+
+TEST(frame_stream, format_b_with_matching_first_block) {
+  std::mt19937 rng(0xAF);
+  for (const size_t total : {size_t{0xAF} + 1, size_t{40}, size_t{128}, size_t{256}}) {
+    const Bytes frame = format_b_passing_a_crc(rng, total);
+    CHECK_EQ(frame.size(), total);
+    Bytes expected;
+    Bytes streamed;
+    CHECK(check(frame, expected));
+    CHECK(stream_frame(frame, rng, streamed));
+    CHECK(streamed == expected);
+    // Byte by byte the frame ends exactly with its last byte.
+    FrameStream stream;
+    FrameStream::Event event = FrameStream::Event::NONE;
+    size_t fed = 0;
+    while (fed < frame.size() && event != FrameStream::Event::FRAME && event != FrameStream::Event::ERROR)
+      fed += stream.feed(frame.data() + fed, 1, event);
+    CHECK(event == FrameStream::Event::FRAME);
+    CHECK_EQ(fed, frame.size());
+  }
+}
@@ -0,0 +1,73 @@
+/**
+ * Minimal known-answer test harness for the host build.
+ *
+ * TEST(suite, name) registers a function; CHECK* record a failure with its
+ * location and carry on, so one run reports every broken expectation.
+ * wmbus_tests runs the suites named on the command line (all without
+ * arguments), and CMake registers one ctest per suite.
+ */
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace wmbus_test {
+
+struct TestCase {
+  const char *suite;
+  const char *name;
+  void (*fn)();
+};
+
+std::vector<TestCase> &registry();
+void fail(const char *file, int line, const std::string &message);
+
+struct Registrar {
+  Registrar(const char *suite, const char *name, void (*fn)()) { registry().push_back({suite, name, fn}); }
+};
+
+/// Corpus file shipped with the benchmark.
+std::string corpus_path(const char *name);
+/// Scratch file in the build directory.
+std::string temp_path(const char *name);
+
+}  // namespace wmbus_test
+
+#define TEST(suite, name) \
+  static void suite##_##name(); \
+  static const ::wmbus_test::Registrar suite##_##name##_registrar(#suite, #name, &suite##_##name); \
+  static void suite##_##name()
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) \
+      ::wmbus_test::fail(__FILE__, __LINE__, "CHECK(" #cond ")"); \
+  } while (0)
+
+#define CHECK_EQ(a, b) \
+  do { \
+    const auto check_a_ = (a); \
+    const auto check_b_ = (b); \
+    if (!(check_a_ == check_b_)) \
+      ::wmbus_test::fail(__FILE__, __LINE__, \
+                         "CHECK_EQ(" #a ", " #b "): " + std::to_string(check_a_) + " != " + std::to_string(check_b_)); \
+  } while (0)
+
+#define CHECK_STREQ(a, b) \
+  do { \
+    const std::string check_a_ = (a); \
+    const std::string check_b_ = (b); \
+    if (check_a_ != check_b_) \
+      ::wmbus_test::fail(__FILE__, __LINE__, "CHECK_STREQ(" #a ", " #b "): \"" + check_a_ + "\" != \"" + check_b_ + "\""); \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+  do { \
+    const double check_a_ = (a); \
+    const double check_b_ = (b); \
+    if (!(std::fabs(check_a_ - check_b_) <= (tolerance))) \
+      ::wmbus_test::fail(__FILE__, __LINE__, \
+                         "CHECK_NEAR(" #a ", " #b "): " + std::to_string(check_a_) + " != " + std::to_string(check_b_)); \
+  } while (0)
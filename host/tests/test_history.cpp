@@ -0,0 +1,224 @@
+// ReadingHistory against a plain list of readings, and its records through
+// the file-backed preferences stand-in as across a reboot.
+#include "test_harness.h"
+
+#include <cmath>
+#include <cstdio>
+#include <deque>
+#include <random>
+
+#include "esphome/core/preferences.h"
+#include "reading_history.h"
+
+using namespace esphome::wmbus_parser;
+
+namespace {
+
+constexpr uint32_t KEY = 0x23123046;
+constexpr std::time_t START = 1760000000;  // October 2025
+
+struct Reading {
+  std::time_t timestamp;
+  long litres;
+};
+
+long litres_of(float total_m3) { return std::lround(static_cast<double>(total_m3) * 1000.0); }
+
+std::vector<Reading> contents(const ReadingHistory &history) {
+  std::vector<Reading> out;
+  for (const HistoryReading reading : history)
+    out.push_back({reading.timestamp, litres_of(reading.total_m3)});
+  return out;
+}
+
+bool same(const std::vector<Reading> &a, const std::vector<Reading> &b) {
+  if (a.size() != b.size())
+    return false;
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].timestamp != b[i].timestamp || a[i].litres != b[i].litres)
+      return false;
+  }
+  return true;
+}
+
+// Appends ``count`` readings with irregular spacing, the odd meter swap
+// (total going down) and clock step back, to both the history and ``expected``.
+void append_readings(ReadingHistory &history, std::deque<Reading> &expected, std::mt19937 &rng, size_t count) {
+  std::time_t time = expected.empty() ? START : expected.back().timestamp;
+  long litres = expected.empty() ? 16590 : expected.back().litres;
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t r = rng();
+    time += (r % 16 == 0) ? -static_cast<std::time_t>(r % 600) : static_cast<std::time_t>(60 + r % 5000);
+    litres += (r % 32 == 0) ? -static_cast<long>(r % 100000) : static_cast<long>(r % 40);
+    CHECK(history.append(time, static_cast<float>(litres) / 1000.0f));
+    expected.push_back({time, litres});
+  }
+  // The ring keeps the newest readings.
+  while (expected.size() > history.size())
+    expected.pop_front();
+}
+
+struct Record {
+  uint32_t type;
+  std::vector<uint8_t> data;
+};
+
+std::vector<Record> read_records(const std::string &path) {
+  std::vector<Record> records;
+  FILE *file = std::fopen(path.c_str(), "rb");
+  CHECK(file != nullptr);
+  uint32_t header[2];
+  while (file != nullptr && std::fread(header, sizeof(header), 1, file) == 1) {
+    Record record{header[0], std::vector<uint8_t>(header[1])};
+    CHECK(std::fread(record.data.data(), 1, record.data.size(), file) == record.data.size());
+    records.push_back(std::move(record));
+  }
+  if (file != nullptr)
+    std::fclose(file);
+  return records;
+}
+
+void write_records(const std::string &path, const std::vector<Record> &records) {
+  FILE *file = std::fopen(path.c_str(), "wb");
+  CHECK(file != nullptr);
+  for (const auto &record : records) {
+    const uint32_t header[2] = {record.type, static_cast<uint32_t>(record.data.size())};
+    std::fwrite(header, sizeof(header), 1, file);
+    std::fwrite(record.data.data(), 1, record.data.size(), file);
+  }
+  std::fclose(file);
+}
+
+bool is_page(const Record &record) { return record.data.size() == ReadingHistory::PAGE_SIZE; }
+
+// Saves ``history`` to a fresh preferences file at ``path``.
+void save_to(const std::string &path, ReadingHistory &history) {
+  std::remove(path.c_str());
+  CHECK(esphome::host::set_preferences_file(path));
+  history.load(KEY);  // binds the preference records; nothing is saved yet
+}
+
+}  // namespace
+
+TEST(history, matches_reference_across_wrap_around) {
+  std::mt19937 rng(1);
+  ReadingHistory history;
+  history.init(256);
+  CHECK_EQ(history.capacity(), static_cast<size_t>(256));
+  std::deque<Reading> expected;
+  for (int round = 0; round < 200; round++) {
+    append_readings(history, expected, rng, 1 + rng() % 20);
+    CHECK(history.bytes_used() <= history.capacity());
+    if (!same(contents(history), std::vector<Reading>(expected.begin(), expected.end()))) {
+      wmbus_test::fail(__FILE__, __LINE__, "history differs in round " + std::to_string(round));
+      break;
+    }
+  }
+  // 200 rounds of up to 20 readings cannot fit in 256 bytes: the ring wrapped.
+  CHECK(history.lost() > 0);
+  CHECK(history.size() < 2000);
+}
+
+TEST(history, rejects_unset_clock_and_close_readings) {
+  ReadingHistory history;
+  history.init(64);
+  CHECK(!history.append(ReadingHistory::MIN_TIMESTAMP - 1, 1.0f));
+  CHECK(!history.append(START, NAN));
+  CHECK(history.append(START, 1.0f));
+  CHECK(!history.append(START + 100, 1.1f, 900));
+  CHECK(history.append(START + 900, 1.2f, 900));
+  CHECK_EQ(history.size(), static_cast<size_t>(2));
+  CHECK_EQ(history.unsent(), static_cast<size_t>(2));
+  history.mark_sent();
+  CHECK_EQ(history.unsent(), static_cast<size_t>(0));
+}
+
+TEST(history, save_and_reload_round_trip) {
+  const std::string path = wmbus_test::temp_path("history_round_trip.prefs");
+  std::mt19937 rng(2);
+  std::deque<Reading> expected;
+  std::vector<Reading> saved;
+  {
+    ReadingHistory history;
+    history.init(512);
+    save_to(path, history);
+    append_readings(history, expected, rng, 400);
+    history.mark_sent();
+    append_readings(history, expected, rng, 5);
+    CHECK(history.save() > 0);
+    CHECK_EQ(history.save(), static_cast<size_t>(0));  // nothing changed since
+    CHECK(esphome::global_preferences->sync());
+    saved = contents(history);
+    CHECK_EQ(saved.size(), history.size());
+  }
+  // Reboot: the records are read back from the file.
+  CHECK(esphome::host::set_preferences_file(path));
+  ReadingHistory restored;
+  restored.init(512);
+  CHECK(restored.load(KEY));
+  CHECK(same(contents(restored), saved));
+  CHECK(same(saved, std::vector<Reading>(expected.begin(), expected.end())));
+  CHECK_EQ(restored.unsent(), static_cast<size_t>(5));
+
+  // Another meter, or a different size, does not pick the record up.
+  ReadingHistory other;
+  other.init(512);
+  CHECK(!other.load(KEY + 1));
+  CHECK(other.empty());
+  ReadingHistory resized;
+  resized.init(1024);
+  CHECK(!resized.load(KEY));
+  CHECK(resized.empty());
+
+  esphome::host::set_preferences_file("");
+  std::remove(path.c_str());
+}
+
+// A reboot between writing a page and writing the header leaves the file with
+// pages newer than the header. If the newer pages overwrote bytes the old
+// header still points at, the record is inconsistent and is dropped rather
+// than replayed as garbage; with a header and no newer page the same.
+TEST(history, half_saved_record_is_dropped) {
+  const std::string old_path = wmbus_test::temp_path("history_old.prefs");
+  const std::string new_path = wmbus_test::temp_path("history_new.prefs");
+  const std::string mixed_path = wmbus_test::temp_path("history_mixed.prefs");
+  std::mt19937 rng(3);
+  std::deque<Reading> expected;
+  ReadingHistory history;
+  history.init(128);
+  save_to(old_path, history);
+  append_readings(history, expected, rng, 60);
+  history.save();
+  CHECK(esphome::global_preferences->sync());
+  // Enough readings to wrap the ring over every old byte.
+  CHECK(esphome::host::set_preferences_file(new_path));
+  append_readings(history, expected, rng, 80);
+  history.save();
+  CHECK(esphome::global_preferences->sync());
+
+  const auto old_records = read_records(old_path);
+  const auto new_records = read_records(new_path);
+  CHECK_EQ(old_records.size(), new_records.size());
+  for (bool pages_newer : {true, false}) {
+    std::vector<Record> mixed;
+    for (size_t i = 0; i < new_records.size() && i < old_records.size(); i++)
+      mixed.push_back(is_page(new_records[i]) == pages_newer ? new_records[i] : old_records[i]);
+    write_records(mixed_path, mixed);
+    CHECK(esphome::host::set_preferences_file(mixed_path));
+    ReadingHistory restored;
+    restored.init(128);
+    CHECK(!restored.load(KEY));
+    CHECK(restored.empty());
+    // The next save writes a complete record again.
+    CHECK(restored.append(START, 1.0f));
+    restored.save();
+    ReadingHistory again;
+    again.init(128);
+    CHECK(again.load(KEY));
+    CHECK_EQ(again.size(), static_cast<size_t>(1));
+  }
+
+  esphome::host::set_preferences_file("");
+  for (const auto &path : {old_path, new_path, mixed_path})
+    std::remove(path.c_str());
+}
@@ -0,0 +1,57 @@
+#include "test_harness.h"
+
+#include <cstring>
+
+#include "esphome/core/log.h"
+
+#ifndef WMBUS_TEST_CORPUS_DIR
+#define WMBUS_TEST_CORPUS_DIR "corpus"
+#endif
+#ifndef WMBUS_TEST_TEMP_DIR
+#define WMBUS_TEST_TEMP_DIR "."
+#endif
+
+namespace wmbus_test {
+
+namespace {
+int failures = 0;
+}  // namespace
+
+std::vector<TestCase> &registry() {
+  static std::vector<TestCase> tests;
+  return tests;
+}
+
+void fail(const char *file, int line, const std::string &message) {
+  std::fprintf(stderr, "%s:%d: %s\n", file, line, message.c_str());
+  failures++;
+}
+
+std::string corpus_path(const char *name) { return std::string(WMBUS_TEST_CORPUS_DIR "/") + name; }
+
+std::string temp_path(const char *name) { return std::string(WMBUS_TEST_TEMP_DIR "/") + name; }
+
+}  // namespace wmbus_test
+
+// Usage: wmbus_tests [suite ...]
+int main(int argc, char **argv) {
+  esphome::host::log_level = esphome::ESPHOME_LOG_LEVEL_NONE;
+  size_t run = 0;
+  for (const auto &test : wmbus_test::registry()) {
+    bool selected = argc < 2;
+    for (int i = 1; i < argc; i++)
+      selected |= std::strcmp(argv[i], test.suite) == 0;
+    if (!selected)
+      continue;
+    const int before = wmbus_test::failures;
+    test.fn();
+    std::printf("%-6s %s.%s\n", wmbus_test::failures == before ? "ok" : "FAILED", test.suite, test.name);
+    run++;
+  }
+  if (run == 0) {
+    std::fprintf(stderr, "no tests selected\n");
+    return 1;
+  }
+  std::printf("%zu tests, %d failed checks\n", run, wmbus_test::failures);
+  return wmbus_test::failures == 0 ? 0 : 1;
+}
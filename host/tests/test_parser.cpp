@@ -0,0 +1,328 @@
+// Known answers for the receive path, from the recorded corpus (see the
+// comments in bench/corpus/evo868.hex for what each frame is).
+#include "test_harness.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+
+#include "telegram_corpus.h"
+#include "wmbus_parser.h"
+
+using namespace esphome::wmbus_parser;
+
+namespace {
+
+enum CorpusFrame {
+  FRAME_README = 0,
+  FRAME_C1_PREFIX,
+  FRAME_FOREIGN,
+  FRAME_BAD_CRC,
+  FRAME_ENCRYPTED,
+  FRAME_COUNT,
+};
+
+std::vector<wmbus_host::Frame> load_evo868() {
+  std::vector<wmbus_host::Frame> frames;
+  std::string error;
+  CHECK(wmbus_host::load_corpus(wmbus_test::corpus_path("evo868.hex"), frames, error));
+  CHECK_EQ(frames.size(), static_cast<size_t>(FRAME_COUNT));
+  frames.resize(FRAME_COUNT);
+  return frames;
+}
+
+// The foreign frame with one ID byte changed and its CRCs left alone.
+wmbus_host::Frame corrupt_foreign_id(const std::vector<wmbus_host::Frame> &frames) {
+  wmbus_host::Frame frame = frames[FRAME_FOREIGN];
+  frame[4] = 0x67;  // meter 99887767
+  return frame;
+}
+
+// First frame of an OMS corpus: C1 format A with the 0x54 0xCD prefix.
+wmbus_host::Frame load_oms_water() {
+  std::vector<wmbus_host::Frame> frames;
+  std::string error;
+  CHECK(wmbus_host::load_corpus(wmbus_test::corpus_path("oms_water.hex"), frames, error));
+  CHECK(!frames.empty());
+  return frames.empty() ? wmbus_host::Frame() : frames[0];
+}
+
+// Hand ``frame`` to WMBusParser::feed() in radio-FIFO sized chunks.
+void feed_frame(WMBusParser &parser, const wmbus_host::Frame &frame, size_t chunk = 16) {
+  for (size_t pos = 0; pos < frame.size(); pos += chunk) {
+    if (!parser.feed(frame.data() + pos, std::min(chunk, frame.size() - pos)))
+      break;
+  }
+  parser.end_frame();
+}
+
+struct Decoded {
+  int count{0};
+  float total_m3{NAN};
+  std::string meter_id;
+};
+
+}  // namespace
+
+TEST(parser, readme_frame_decodes) {
+  const auto frames = load_evo868();
+  WMBusParser parser;
+  parser.add_meter("23123046", "evo868");
+  WMBusParserDecodeTrigger trigger(&parser);
+  Decoded decoded;
+  trigger.add_callback([&](float total, AttributeList, std::string meter_id) {
+    decoded.count++;
+    decoded.total_m3 = total;
+    decoded.meter_id = meter_id;
+  });
+  parser.setup();
+
+  parser.receive_packet(frames[FRAME_README]);
+  CHECK_EQ(decoded.count, 1);
+  CHECK_NEAR(decoded.total_m3, 16.59, 1e-4);
+  CHECK_STREQ(decoded.meter_id, "23123046");
+
+  // The same telegram with the C1 sync bytes in front is the same reading,
+  // and a copy within the duplicate window.
+  parser.set_duplicate_window(0);
+  parser.receive_packet(frames[FRAME_C1_PREFIX]);
+  CHECK_EQ(decoded.count, 2);
+  CHECK_NEAR(decoded.total_m3, 16.59, 1e-4);
+  CHECK_EQ(parser.metrics().decoded, 2u);
+}
+
+TEST(parser, bad_crc_is_rejected) {
+  const auto frames = load_evo868();
+  WMBusParser parser;
+  parser.add_meter("23123046", "evo868");
+  parser.setup();
+  parser.receive_packet(frames[FRAME_BAD_CRC]);
+  const ParserMetrics m = parser.metrics();
+  CHECK_EQ(m.decoded, 0u);
+  CHECK_EQ(m.failures_for(FailureReason::BAD_CRC), 1u);
+  CHECK_EQ(parser.get_meter(0)->stats().received, 0u);
+}
+
+TEST(parser, foreign_meter_is_dropped) {
+  const auto frames = load_evo868();
+  WMBusParser parser;
+  parser.add_meter("23123046", "evo868");
+  parser.setup();
+  parser.receive_packet(frames[FRAME_FOREIGN]);
+  const ParserMetrics m = parser.metrics();
+  CHECK_EQ(m.decoded, 0u);
+  CHECK_EQ(m.unknown_id, 1u);
+  CHECK_EQ(m.failed(), 0u);
+  CHECK_EQ(parser.foreign_meters().size(), static_cast<size_t>(1));
+  CHECK_EQ(parser.foreign_meters().begin()->address, 0x99887766u);
+}
+
+TEST(parser, auto_detect_adds_wildcard_meter) {
+  const auto frames = load_evo868();
+  for (const bool streamed : {false, true}) {
+    WMBusParser parser;
+    parser.add_meter("23123046", "evo868");
+    CHECK(parser.add_auto_manufacturer("MAD"));
+    parser.setup();
+    if (streamed) {
+      feed_frame(parser, frames[FRAME_FOREIGN]);
+    } else {
+      parser.receive_packet(frames[FRAME_FOREIGN]);
+    }
+    CHECK_EQ(parser.meters().size(), static_cast<size_t>(2));
+    CHECK_EQ(parser.meters().address[1], 0x99887766u);
+    CHECK_EQ(parser.metrics().decoded, 1u);
+    CHECK_EQ(parser.metrics().unknown_id, 0u);
+  }
+}
+
+// A streamed header is not covered by a CRC yet; a bit error in its ID must
+// not add a wildcard meter before the frame fails its checks.
+TEST(parser, feed_does_not_detect_meter_from_bad_header) {
+  const auto frames = load_evo868();
+  const wmbus_host::Frame corrupt = corrupt_foreign_id(frames);
+  for (const bool streamed : {false, true}) {
+    WMBusParser parser;
+    parser.add_meter("23123046", "evo868");
+    CHECK(parser.add_auto_manufacturer("MAD"));
+    parser.setup();
+    if (streamed) {
+      feed_frame(parser, corrupt);
+    } else {
+      parser.receive_packet(corrupt);
+    }
+    CHECK_EQ(parser.meters().size(), static_cast<size_t>(1));
+    CHECK_EQ(parser.metrics().failures_for(FailureReason::BAD_CRC), 1u);
+    CHECK_EQ(parser.metrics().decoded, 0u);
+  }
+}
+
+// In format A the streamed header is checked by the first block CRC, so a
+// foreign meter is dropped early but counted as with receive_packet().
+TEST(parser, feed_drops_checked_foreign_header_early) {
+  const wmbus_host::Frame frame = load_oms_water();
+  for (const bool streamed : {false, true}) {
+    WMBusParser parser;
+    parser.add_meter("23123046", "evo868");
+    parser.setup();
+    if (streamed) {
+      // Prefix and first block (with its CRC) are in the first chunk.
+      CHECK(!parser.feed(frame.data(), 16));
+      parser.end_frame();
+    } else {
+      parser.receive_packet(frame);
+    }
+    const ParserMetrics m = parser.metrics();
+    CHECK_EQ(m.unknown_id, 1u);
+    CHECK_EQ(m.early_drops, 0u);
+    CHECK_EQ(m.failed(), 0u);
+    CHECK_EQ(parser.foreign_meters().size(), static_cast<size_t>(1));
+    CHECK_EQ(parser.foreign_meters().begin()->address, 0x12345678u);
+  }
+}
+
+// A bit error in a streamed header must not show up as a foreign meter.
+TEST(parser, feed_keeps_bad_headers_out_of_foreign_meters) {
+  const auto frames = load_evo868();
+  wmbus_host::Frame format_a = load_oms_water();
+  format_a[6] ^= 0x01;  // ID byte after the C1 prefix, CRC left alone
+  // Format A: the first block CRC fails before the header is reported.
+  for (const bool streamed : {false, true}) {
+    WMBusParser parser;
+    parser.add_meter("23123046", "evo868");
+    parser.setup();
+    if (streamed) {
+      feed_frame(parser, format_a);
+    } else {
+      parser.receive_packet(format_a);
+    }
+    const ParserMetrics m = parser.metrics();
+    CHECK_EQ(m.failures_for(FailureReason::BAD_CRC), 1u);
+    CHECK_EQ(m.unknown_id, 0u);
+    CHECK_EQ(parser.foreign_meters().size(), static_cast<size_t>(0));
+  }
+  // Format B: dropped on the unchecked header, under its own count.
+  const wmbus_host::Frame format_b = corrupt_foreign_id(frames);
+  for (const bool streamed : {false, true}) {
+    WMBusParser parser;
+    parser.add_meter("23123046", "evo868");
+    parser.setup();
+    if (streamed) {
+      feed_frame(parser, format_b);
+    } else {
+      parser.receive_packet(format_b);
+    }
+    const ParserMetrics m = parser.metrics();
+    CHECK_EQ(m.failures_for(FailureReason::BAD_CRC), streamed ? 0u : 1u);
+    CHECK_EQ(m.early_drops, streamed ? 1u : 0u);
+    CHECK_EQ(m.unknown_id, 0u);
+    CHECK_EQ(parser.foreign_meters().size(), static_cast<size_t>(0));
+  }
+}
+
+// Allocations are counted per telegram on the threads that handle it: the
+// decode task's share travels with the result, and what other threads
+// allocate meanwhile is not charged to the telegram.
+TEST(parser, worker_counts_the_same_allocations) {
+  const auto frames = load_evo868();
+  constexpr int TELEGRAMS = 20;
+  std::atomic<bool> stop{false};
+  std::thread noise([&] {
+    std::vector<std::string> garbage;
+    while (!stop.load(std::memory_order_relaxed)) {
+      garbage.emplace_back(64, 'x');
+      if (garbage.size() == 64)
+        garbage.clear();
+    }
+  });
+  for (const bool worker : {false, true}) {
+    WMBusParser parser;
+    parser.add_meter("23123046", "evo868");
+    parser.set_decode_worker(worker);
+    parser.set_duplicate_window(0);
+    WMBusParserDecodeTrigger trigger(&parser);
+    std::vector<std::string> kept;
+    kept.reserve(TELEGRAMS);
+    // One allocation per telegram, made while it is published.
+    trigger.add_callback([&](float, AttributeList, std::string) { kept.emplace_back(64, 'x'); });
+    parser.setup();
+    for (int i = 0; i < TELEGRAMS; i++) {
+      parser.receive_packet(frames[FRAME_README]);
+      for (int spin = 0; spin < 10000 && kept.size() <= static_cast<size_t>(i); spin++) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        parser.loop();
+      }
+    }
+    CHECK_EQ(kept.size(), static_cast<size_t>(TELEGRAMS));
+    CHECK_EQ(parser.allocation_stats().telegrams, static_cast<uint32_t>(TELEGRAMS));
+    CHECK_EQ(parser.allocation_stats().allocations, static_cast<uint64_t>(TELEGRAMS));
+  }
+  stop = true;
+  noise.join();
+}
+
+TEST(parser, thread_alloc_counters_ignore_other_threads) {
+  uint64_t other = 0;
+  std::thread thread([&] {
+    const uint64_t before = thread_alloc_counters().allocations;
+    std::vector<std::string> strings(8, std::string(64, 'x'));
+    other = thread_alloc_counters().allocations - before;
+  });
+  // Starting the thread allocates here; waiting for it does not.
+  const uint64_t before = thread_alloc_counters().allocations;
+  thread.join();
+  const uint64_t after_join = thread_alloc_counters().allocations;
+  auto kept = std::make_unique<std::string>(64, 'x');
+  const uint64_t after_own = thread_alloc_counters().allocations;
+  CHECK_EQ(other, static_cast<uint64_t>(10));  // the temporary, the vector and 8 copies
+  CHECK_EQ(after_join, before);
+  CHECK_EQ(after_own, before + 2);
+}
+
+// The decode task leaves its timings in the trace and loop() records them,
+// also for frames that publish nothing.
+TEST(parser, worker_timings_are_recorded_by_loop) {
+  const auto frames = load_evo868();
+  for (const bool worker : {false, true}) {
+    WMBusParser parser;
+    parser.add_meter("23123046", "evo868");
+    parser.set_decode_worker(worker);
+    parser.set_stage_timing(true);
+    parser.set_duplicate_window(60000);
+    parser.setup();
+    parser.receive_packet(frames[FRAME_README]);
+    parser.receive_packet(frames[FRAME_README]);  // a duplicate
+    for (int spin = 0; spin < 10000 && parser.metrics().stage(TraceStage::DEDUPE).count() < 2; spin++) {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+      parser.loop();
+    }
+    const ParserMetrics m = parser.metrics();
+    CHECK_EQ(m.decoded, 1u);
+    CHECK_EQ(m.duplicates, 1u);
+    CHECK_EQ(m.decode_time.count(), 1u);
+    CHECK_EQ(m.stage(TraceStage::DEDUPE).count(), 2u);
+    CHECK_EQ(m.stage(TraceStage::DECODE).count(), 1u);
+    CHECK_EQ(m.stage(TraceStage::QUEUE).count(), worker ? 2u : 0u);
+    CHECK_EQ(m.end_to_end.count(), 1u);
+    CHECK_EQ(parser.get_meter(0)->stats().received, 2u);
+  }
+}
+
+// C library allocations count too, not only operator new.
+TEST(parser, malloc_calls_are_counted) {
+  if (!ALLOC_COUNTING_SEES_MALLOC)
+    return;
+  const AllocCounters before = thread_alloc_counters();
+  void *volatile block = std::malloc(32);
+  void *volatile zeroed = std::calloc(4, 8);
+  block = std::realloc(block, 64);
+  std::free(block);
+  std::free(zeroed);
+  const AllocCounters after = thread_alloc_counters();
+  CHECK_EQ(after.allocations - before.allocations, static_cast<uint64_t>(3));
+  CHECK_EQ(after.deallocations - before.deallocations, static_cast<uint64_t>(3));
+  CHECK_EQ(after.bytes - before.bytes, static_cast<uint64_t>(32 + 32 + 64));
+}